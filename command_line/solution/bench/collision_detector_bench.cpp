@@ -0,0 +1,78 @@
+// Замер FindGatherEvents на 10000 собак и 100000 предметов.
+// Запуск: collision_detector_bench [собак] [предметов] [повторов]
+#include "collision_detector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace collision_detector;
+
+namespace {
+
+struct VectorProvider : ItemGathererProvider {
+    size_t ItemsCount() const override {
+        return items.size();
+    }
+    Item GetItem(size_t idx) const override {
+        return items[idx];
+    }
+    size_t GatherersCount() const override {
+        return gatherers.size();
+    }
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers[idx];
+    }
+
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+};
+
+constexpr double MAP_SIZE = 1000.;
+constexpr double DOG_WIDTH = 0.6;
+constexpr double MAX_STEP = 10.;
+
+// Дороги - горизонтали с целыми y, предметы лежат на дорогах, собаки за тик проходят до MAX_STEP
+VectorProvider MakeInput(size_t dogs, size_t items) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> along(0., MAP_SIZE);
+    std::uniform_int_distribution<int> road(0, static_cast<int>(MAP_SIZE));
+    std::uniform_real_distribution<double> across(-0.4, 0.4);
+    std::uniform_real_distribution<double> step(-MAX_STEP, MAX_STEP);
+
+    VectorProvider provider;
+    provider.items.reserve(items);
+    for (size_t i = 0; i < items; ++i) {
+        provider.items.push_back({{along(random), road(random) + across(random)}, 0.});
+    }
+    provider.gatherers.reserve(dogs);
+    for (size_t i = 0; i < dogs; ++i) {
+        const model::ParamPairDouble start{along(random), static_cast<double>(road(random))};
+        const model::ParamPairDouble end = i % 2 ? model::ParamPairDouble{start.x_ + step(random), start.y_}
+                                                 : model::ParamPairDouble{start.x_, start.y_ + step(random)};
+        provider.gatherers.push_back({start, end, DOG_WIDTH});
+    }
+    return provider;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t dogs = argc > 1 ? std::stoul(argv[1]) : 10'000;
+    const size_t items = argc > 2 ? std::stoul(argv[2]) : 100'000;
+    const int runs = std::max(1, argc > 3 ? std::stoi(argv[3]) : 10);
+
+    const VectorProvider provider = MakeInput(dogs, items);
+    std::vector<double> ms;
+    size_t events = 0;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        events = FindGatherEvents(provider).size();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    std::cout << "dogs " << dogs << ", items " << items << ", events " << events
+              << ", median " << ms[ms.size() / 2] << " ms, min " << ms.front() << " ms" << std::endl;
+}
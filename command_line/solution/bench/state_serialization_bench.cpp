@@ -0,0 +1,122 @@
+// /state одной сессии: потоковый WriteState против прежнего пути через дерево boost::json и
+// json::serialize. Перед замером проверяет, что оба пути дают один и тот же JSON.
+// Для сравнения форматов печатает размер и время того же /state в CBOR.
+// Запуск: state_serialization_bench [собак] [повторов]
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "model_game.h"
+#include "serialization.h"
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace json = boost::json;
+using namespace std::literals;
+
+namespace {
+
+model::Map MakeMap() {
+    model::Map map(model::Map::Id{"map1"s}, "Map 1"s);
+    for (int i = 0; i <= 10; ++i) {
+        map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, i * 10}, 100));
+        map.AddRoad(model::Road(model::Road::VERTICAL, {i * 10, 0}, 100));
+    }
+    map.SetMapDogSpeed(3.);
+    return map;
+}
+
+// Так /state строился до потоковой сериализации
+std::string SerializeWithTree(const model::PlayerList& players, const model::GameSession& session) {
+    json::object resp;
+    players.ForEachPlayer([&resp, &session](const std::shared_ptr<model::Player>& player) {
+        if (player->GetPlayersSession().get() != &session) {
+            return;
+        }
+        const auto& dog = *player->GetDog();
+        resp[std::to_string(player->GetId())] = {
+            {"dir", dog.GetDogDirection()},
+            {"pos", {dog.GetDogPosition().x_, dog.GetDogPosition().y_}},
+            {"speed", {dog.GetDogSpeed().x_, dog.GetDogSpeed().y_}}
+        };
+    });
+    json::object message{{"players", resp}};
+    return json::serialize(message);
+}
+
+std::string SerializeWithWriter(const std::vector<const model::Dog*>& dogs) {
+    std::string body;
+    body.reserve(serialization::EstimateStateSize(dogs.size()));
+    serialization::JsonWriter writer(body);
+    serialization::WriteState(writer, dogs);
+    return body;
+}
+
+std::string SerializeCbor(const std::vector<const model::Dog*>& dogs) {
+    std::string body;
+    body.reserve(serialization::EstimateStateSize(dogs.size()));
+    serialization::CborWriter writer(body);
+    serialization::WriteState(writer, dogs);
+    return body;
+}
+
+template <typename Fn>
+double MedianMicroseconds(int runs, Fn&& fn) {
+    std::vector<double> us;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    return us[us.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t dogs_count = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const int runs = std::max(1, argc > 2 ? std::stoi(argv[2]) : 200);
+
+    model::Game game;
+    game.AddMap(MakeMap());
+    auto session = game.GetGameSession(model::Map::Id{"map1"s});
+    model::PlayerList players;
+    auxillary::FastRandom random(34);
+    const std::string dirs[] = {"U"s, "R"s, "D"s, "L"s, ""s};
+    for (size_t i = 0; i < dogs_count; ++i) {
+        auto player = players.MakePlayer("player"s + std::to_string(i), session);
+        session->AddDog(player->GetDog(), true, random);
+        player->GetDog()->SetDogDirection(dirs[random.NextIndex(5)]);
+        players.PublishPlayer(player);
+    }
+    game.UpdateGame(0.37);
+
+    std::vector<const model::Dog*> dogs;
+    for (const auto& dog : session->GetDogs()) {
+        dogs.push_back(dog.get());
+    }
+
+    const std::string tree = SerializeWithTree(players, *session);
+    const std::string streamed = SerializeWithWriter(dogs);
+    if (json::parse(tree) != json::parse(streamed)) {
+        std::cerr << "WriteState output differs from json::serialize" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Тело сохраняется снаружи, чтобы компилятор не выбросил сериализацию
+    std::string body;
+    const double tree_us = MedianMicroseconds(runs, [&] { body = SerializeWithTree(players, *session); });
+    const double streamed_us = MedianMicroseconds(runs, [&] { body = SerializeWithWriter(dogs); });
+    const std::string cbor = SerializeCbor(dogs);
+    const double cbor_us = MedianMicroseconds(runs, [&] { body = SerializeCbor(dogs); });
+    std::cout << "dogs " << dogs.size() << ", body " << streamed.size() << " bytes (json::serialize " << tree.size()
+              << "), json::serialize " << tree_us << " us, WriteState " << streamed_us << " us, speedup "
+              << tree_us / streamed_us << "x" << std::endl;
+    std::cout << "cbor body " << cbor.size() << " bytes (" << 100. * cbor.size() / streamed.size() << "% of json), "
+              << "WriteState " << cbor_us << " us" << std::endl;
+}
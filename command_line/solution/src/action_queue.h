@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "model_app.h"
+
+namespace model {
+
+struct DogAction {
+    std::shared_ptr<Dog> dog;
+    std::string dir;
+};
+
+// Очередь действий игровой сессии без блокировок: много производителей (обработчики запросов),
+// один потребитель (тик или чтение состояния на strand игры).
+// Производитель добавляет узел CAS-ом в голову стека, потребитель забирает весь стек одним exchange
+class ActionQueue {
+    ActionQueue(const ActionQueue&) = delete;
+    ActionQueue& operator=(const ActionQueue&) = delete;
+
+public:
+    ActionQueue() = default;
+
+    ~ActionQueue() {
+        Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            delete std::exchange(node, node->next);
+        }
+    }
+
+    void Push(DogAction action) {
+        Node* node = new Node{std::move(action), head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_relaxed) == nullptr;
+    }
+
+    // Вызывает fn для всех накопленных действий в порядке поступления
+    template <typename Fn>
+    void Drain(Fn&& fn) {
+        Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+        // В стеке последние действия сверху - разворачиваем список
+        Node* ordered = nullptr;
+        while (node) {
+            Node* next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+        while (ordered) {
+            std::unique_ptr<Node> current(std::exchange(ordered, ordered->next));
+            fn(current->action);
+        }
+    }
+
+private:
+    struct Node {
+        DogAction action;
+        Node* next;
+    };
+
+    std::atomic<Node*> head_{nullptr};
+};
+
+}  // namespace model
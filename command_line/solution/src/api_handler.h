@@ -2,11 +2,18 @@
 
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <array>
 #include <optional>
+#include <sstream>
+#include <variant>
 
 #include "aux.h"
+#include "cbor_writer.h"
 #include "game_server.h"
+#include "json_writer.h"
+#include "rate_limiter.h"
 #include "response_maker.h"
+#include "serialization.h"
 #include "tagged.h"
 
 namespace json = boost::json;
@@ -16,19 +23,82 @@ namespace http = beast::http;
 
 namespace http_handler {
 
-boost::json::value PrepareRoadsForResponse(const model::Map& map);
-boost::json::value PrepareBuildingsForResponce(const model::Map& map);
-boost::json::value PrepareOfficesForResponce(const model::Map& map);
+// Ошибки и пустые ответы отдаются готовыми блоками, остальное - обычными ответами beast
+using ApiResponse = std::variant<http::response<http::string_body>, http_server::PrebuiltResponse>;
+
+// Тело запроса разбирается в монотонный ресурс поверх буфера потока: узлы JSON не ходят в malloc
+// и освобождаются разом вместе с объектом. Разобранное значение не должно пережить объект,
+// на одном потоке одновременно живёт не больше одного RequestJson
+class RequestJson {
+public:
+    RequestJson() :
+        resource_(Buffer().data(), Buffer().size()) {}
+
+    json::value Parse(std::string_view body) {
+        return json::parse(body, &resource_);
+    }
+
+private:
+    // Больше любого обычного тела запроса; длинная пачка действий продолжится в куче
+    constexpr static size_t BUFFER_SIZE = 16 * 1024;
+
+    static std::array<unsigned char, BUFFER_SIZE>& Buffer() {
+        thread_local std::array<unsigned char, BUFFER_SIZE> buffer;
+        return buffer;
+    }
+
+    json::monotonic_resource resource_;
+};
 
 template <typename Body, typename Allocator, typename Send>
 class ApiHandler {
 public:
-    ApiHandler(const http::request<Body, http::basic_fields<Allocator>>& req, GameServer& gs, RequestData& rd) :
+    // token_limiter - ограничитель частоты по токену, которым пачка действий платит за каждое действие
+    ApiHandler(const http::request<Body, http::basic_fields<Allocator>>& req, GameServer& gs, RequestData rd, RateLimiter* token_limiter = nullptr) :
         req_(req),
         gs_(gs),
-        r_data_(rd) {}
+        r_data_(std::move(rd)),
+        token_limiter_(token_limiter) {}
+
+    // Проверка токена до постановки в strand игры: индекс игроков читается из любого потока.
+    // Возвращает готовый отказ, если запрос можно отклонить сразу; найденный игрок запоминается
+    std::optional<ApiResponse> PreAuthorize() {
+        if (!RequiresAuthorization()) {
+            return std::nullopt;
+        }
+        return ResolvePlayer();
+    }
 
-    http::response<http::string_body> HandleRequest() {
+    // Игрок, чей токен проверен в PreAuthorize. nullptr - запрос без авторизации
+    const model::Player* AuthorizedPlayer() const {
+        return player_.get();
+    }
+
+    // Запрос карты, тело которой ещё строит другой поток: fn вызовется на нём, когда тело будет готово,
+    // и HandleRequest тогда не будет ждать. false - ждать нечего, ответ можно строить сразу
+    bool DeferUntilMapReady(std::function<void()> fn) {
+        if (r_data_.type != RequestType::API || req_.method() != http::verb::get || r_data_.r_target.empty()) {
+            return false;
+        }
+        const bool cbor = AcceptsCbor();
+        if (r_data_.r_target == "maps") {
+            return gs_.WhenMapsListBodyReady(cbor, std::move(fn));
+        }
+        const model::Map* map = gs_.FindMap(model::Map::Id{r_data_.r_target});
+        return map && gs_.WhenMapBodyReady(*map, cbor, std::move(fn));
+    }
+
+    // Запросы карт читают только неизменяемые данные и готовые тела, strand игры им не нужен
+    bool RequiresGameStrand() const {
+        return r_data_.type != RequestType::API;
+    }
+
+    // Ответ на вход отдаётся только после записи входа в WAL: выданный токен переживёт сбой
+    bool RequiresDurability() const {
+        return r_data_.type == RequestType::PLAYER && r_data_.r_target == "join";
+    }
+
+    ApiResponse HandleRequest() {
         try {
             if (r_data_.type == RequestType::API) {
                 return HandleMapRequest();
@@ -42,91 +112,71 @@ public:
                     return HandleStateRequest();
                 } else if (r_data_.r_target == "action") {
                     return HandleActionRequest();
+                } else if (r_data_.r_target == "actions") {
+                    return HandleActionsBatchRequest();
                 } else if (r_data_.r_target == "tick" && !gs_.IsAutoTicker()) {
                     return HandleTickRequest();
+                } else if (r_data_.r_target == "records") {
+                    return HandleRecordsRequest();
                 } else {
-                    return MakeResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
+                    return MakeStaticResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
                 }
-            } 
+            }
+            if (r_data_.type == RequestType::ADMIN) {
+                return HandleAdminRequest();
+            }
         } catch (...) {
-            return MakeResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
+            return MakeStaticResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
         }
-        return MakeResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
+        return MakeStaticResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON);
     }
 
 // Methods, no authorization required ->
 
-    http::response<http::string_body> HandleMapRequest() {
-        json::value message;
+    ApiResponse HandleMapRequest() {
         if (req_.method() != http::verb::get) {
-            return MakeResponse(http::status::method_not_allowed, Errors::GET_INVALID, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET"sv);
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::GET_INVALID, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET"sv);
         }
         
         if (r_data_.r_target.empty()) {
-            return MakeResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            return MakeStaticResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }
+        const bool cbor = AcceptsCbor();
         if (r_data_.r_target == "maps") {
-            json::array array;
-            for (auto& map : gs_.GetMaps()) {
-                json::value val = {{"id",*map.GetId()}, {"name", map.GetName()}};
-                array.push_back(val);
-            }
-            message = array;
-            return MakeResponse(http::status::ok, json::serialize(message), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv); 
-        } else {
-            json::object resp_message;
-            model::Map::Id id_{r_data_.r_target};
-            const model::Map* map = gs_.FindMap(id_);
-            if (map != nullptr) {
-                std::vector<std::string> keys_in_map = map->GetKeys();
-                for (const auto& key : keys_in_map) {
-                    if (key == "id") {
-                        resp_message["id"] = *map->GetId();
-                    //} else if (key == "dogSpeed") {
-                    //    resp_message["dogSpeed"] = map->GetMapDogSpeed();
-                    } else if (key == "name") {
-                        resp_message["name"] = map->GetName();
-                    } else if (key == "roads") {
-                        boost::json::array roads = PrepareRoadsForResponse(*map).as_array();
-                        resp_message["roads"] = roads;
-                    } else if(key == "buildings") {
-                        boost::json::array buildings = PrepareBuildingsForResponce(*map).as_array();
-                        resp_message["buildings"] = buildings;
-                    } else if (key == "offices") {
-                        boost::json::array offices = PrepareOfficesForResponce(*map).as_array();
-                        resp_message["offices"] = offices;            
-                    }
-                }
-                message = resp_message;
-                return MakeResponse(http::status::ok, json::serialize(message), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
-                
-            } else {
-                return MakeResponse(http::status::not_found, Errors::MAP_NOT_FOUND, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
-                
-            }
+            return MakeRenderedResponse(gs_.GetMapsListBody(cbor), cbor);
         }
+        const model::Map* map = gs_.FindMap(model::Map::Id{r_data_.r_target});
+        if (map == nullptr) {
+            return MakeStaticResponse(http::status::not_found, Errors::MAP_NOT_FOUND, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        return MakeRenderedResponse(gs_.GetMapBody(*map, cbor), cbor);
     }
 
-    http::response<http::string_body> HandlePlayerJoinRequest() {
+    ApiResponse HandlePlayerJoinRequest() {
         if (req_.method() != http::verb::post) {
-            return MakeResponse(http::status::method_not_allowed, Errors::POST_INVALID, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::POST_INVALID, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);
         }
         std::string user_name;
         std::string map_id;
         try {
-            boost::json::value parsed_req = boost::json::parse(req_.body());
+            RequestJson body;
+            boost::json::value parsed_req = body.Parse(req_.body());
             if (parsed_req.as_object().find("userName") == parsed_req.as_object().end() || parsed_req.as_object().at("userName").as_string().empty()) {
-                return MakeResponse(http::status::bad_request, Errors::USERNAME_EMPTY, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+                return MakeStaticResponse(http::status::bad_request, Errors::USERNAME_EMPTY, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
             }
             user_name = parsed_req.as_object().at("userName").as_string();
             map_id = parsed_req.as_object().at("mapId").as_string();
         } catch (...) {
-            return MakeResponse(http::status::bad_request, Errors::PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            return MakeStaticResponse(http::status::bad_request, Errors::PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }
         model::Map::Id mapId(map_id);
         auto map = gs_.FindMap(mapId);
         if (map == nullptr) {
-            return MakeResponse(http::status::not_found, Errors::MAP_NOT_FOUND, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            return MakeStaticResponse(http::status::not_found, Errors::MAP_NOT_FOUND, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        // Вход на чужую карту - ошибка маршрутизации: игра на ней идёт в другом процессе
+        if (!gs_.OwnsMap(mapId)) {
+            return MakeStaticResponse(http::status::misdirected_request, Errors::WRONG_SHARD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }
         boost::json::object resp;
         try {
@@ -139,85 +189,288 @@ public:
         return MakeResponse(http::status::ok, boost::json::serialize(resp), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
     }
 
-    http::response<http::string_body> HandleTickRequest() {
+    ApiResponse HandleTickRequest() {
         if (req_.method() != http::verb::post) {
-            return MakeResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);            
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);            
         }
         double delta_t;
         try {
-            json::value parsed_req = json::parse(req_.body());
+            RequestJson body;
+            json::value parsed_req = body.Parse(req_.body());
             if (parsed_req.as_object().find("timeDelta") == parsed_req.as_object().end()) {
-                return MakeResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+                return MakeStaticResponse(http::status::bad_request, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
             }
             delta_t = parsed_req.as_object().at("timeDelta").as_int64() / 1000.;
         } catch (...) {
-            return MakeResponse(http::status::bad_request, Errors::PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            return MakeStaticResponse(http::status::bad_request, Errors::PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }
-        json::object resp;
+        gs_.SetGameServerTick(delta_t);
+        return MakeStaticResponse(http::status::ok, EMPTY_OBJECT, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+    }
+
+    ApiResponse HandleRecordsRequest() {
+        if (req_.method() != http::verb::get && req_.method() != http::verb::head) {
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);
+        }
+        size_t start = 0;
+        size_t max_items = MAX_RECORDS_PAGE;
         try {
-            gs_.SetGameServerTick(delta_t);
-        } catch (const std::exception& ex) {
-            throw;
+            auto params = auxillary::ParseQuery(r_data_.query);
+            if (auto it = params.find("start"); it != params.end()) {
+                start = std::stoul(it->second);
+            }
+            if (auto it = params.find("maxItems"); it != params.end()) {
+                max_items = std::stoul(it->second);
+            }
+        } catch (...) {
+            return MakeStaticResponse(http::status::bad_request, Errors::RECORDS_PARAMS, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }
-        return MakeResponse(http::status::ok, boost::json::serialize(resp), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        if (max_items > MAX_RECORDS_PAGE) {
+            return MakeStaticResponse(http::status::bad_request, Errors::RECORDS_PARAMS, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        json::array resp;
+        for (const auto& record : gs_.GetRecords(start, max_items)) {
+            resp.push_back(json::object{{"name", record.name},
+                                        {"score", record.score},
+                                        {"playTime", record.play_time}});
+        }
+        std::string body = json::serialize(resp);
+        if (req_.method() == http::verb::head) {
+            return MakeHeadResponse(body.size(), ContentType::JSON);
+        }
+        return MakeResponse(http::status::ok, std::move(body), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+    }
+
+// Methods, admin token required ->
+
+    // Без --admin-token служебных запросов нет вовсе
+    ApiResponse HandleAdminRequest() {
+        if (!gs_.AdminEnabled() || r_data_.r_target != "memory") {
+            return MakeStaticResponse(http::status::not_found, Errors::BAD_REQ, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        if (req_.method() != http::verb::get && req_.method() != http::verb::head) {
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);
+        }
+        auto it = req_.find(http::field::authorization);
+        if (it == req_.end() || !it->value().starts_with("Bearer "sv) || !gs_.IsAdminToken(it->value().substr(7))) {
+            return MakeStaticResponse(http::status::unauthorized, Errors::ADMIN_TOKEN, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        return MakeResponse(http::status::ok, json::serialize(memory::ToJson(gs_.GetMemoryReport())), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
     }
 
 // Methods, authorization required ->
 
-    http::response<http::string_body> HandlePlayersListRequest() {
+    ApiResponse HandlePlayersListRequest() {
         if (req_.method() != http::verb::get && req_.method() != http::verb::head) {
-            return MakeResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);            
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);            
         } 
-        return ExecuteAuthorized([this](/*const model::Player&*/std::shared_ptr<const model::Player> player) {
+        return ExecuteAuthorized([this]([[maybe_unused]] std::shared_ptr<const model::Player> player) -> ApiResponse {
+            const std::string etag = MakeEtag("p"sv, gs_.GetPlayersVersion());
+            if (IsNotModified(etag)) {
+                return MakeNotModifiedResponse(etag);
+            }
+            if (auto size = gs_.GetCachedPlayersListSize(); size && req_.method() == http::verb::head) {
+                return MakeHeadResponse(*size, ContentType::JSON, etag);
+            }
             boost::json::object resp;
-            for (auto pl : gs_.GetPlayers()) {
-                resp[std::to_string(pl.second->GetId())] = boost::json::object{{"name", pl.second->GetName()}};
+            gs_.GetPlayers().ForEachPlayer([&resp](const std::shared_ptr<model::Player>& pl) {
+                resp[std::to_string(pl->GetId())] = boost::json::object{{"name", pl->GetName()}};
+            });
+            std::string body = boost::json::serialize(resp);
+            gs_.CachePlayersListSize(body.size());
+            if (req_.method() == http::verb::head) {
+                return MakeHeadResponse(body.size(), ContentType::JSON, etag);
             }
-            return MakeResponse(http::status::ok, boost::json::serialize(resp), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            auto response = MakeResponse(http::status::ok, std::move(body), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            response.set(http::field::etag, etag);
+            return response;
         });
     }
 
-    http::response<http::string_body> HandleStateRequest() {
+    ApiResponse HandleStateRequest() {
         if (req_.method() != http::verb::get && req_.method() != http::verb::head) {
-            return MakeResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "GET, HEAD"sv);
         }
-        return ExecuteAuthorized([this](/*const model::Player&*/std::shared_ptr<const model::Player> player) {
-            boost::json::object resp;
-            for (auto pl : gs_.GetPlayers()) {
-                if (pl.second->GetPlayersSession() == player->GetPlayersSession()) {
-                    resp[std::to_string(pl.second->GetId())] = {
-                        {"dir", pl.second->GetDog()->GetDogDirection()},
-                        {"pos", {(double)pl.second->GetDog()->GetDogPosition().x_, (double)pl.second->GetDog()->GetDogPosition().y_}},
-                        {"speed", {(double)pl.second->GetDog()->GetDogSpeed().x_, (double)pl.second->GetDog()->GetDogSpeed().y_}}
-                    };
-                }
+        return ExecuteAuthorized([this](/*const model::Player&*/std::shared_ptr<const model::Player> player) -> ApiResponse {
+            gs_.ApplyPendingActions(*player);
+            // Состав выборки определяется состоянием сессии, поэтому версии сессии и собаки игрока
+            // хватает, чтобы узнать неизменный ответ до обхода сетки и сериализации
+            const bool cbor = AcceptsCbor();
+            const std::string etag = MakeEtag(cbor ? "sc"sv : "s"sv, gs_.GetStateVersion(*player), player->GetDog()->GetId());
+            if (IsNotModified(etag)) {
+                auto response = MakeNotModifiedResponse(etag);
+                response.set(http::field::vary, "Accept"sv);
+                return response;
+            }
+            const std::string_view content_type = cbor ? ContentType::CBOR : ContentType::JSON;
+            if (auto size = gs_.GetCachedStateSize(*player, cbor); size && req_.method() == http::verb::head) {
+                auto response = MakeHeadResponse(*size, content_type, etag);
+                response.set(http::field::vary, "Accept"sv);
+                return response;
             }
-            boost::json::object resp_message {{"players", resp}};
-            return MakeResponse(http::status::ok, json::serialize(resp_message), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            std::vector<const model::Dog*> dogs;
+            gs_.CollectVisibleDogs(*player, dogs);
+            auto response = MakeSerializedResponse(serialization::EstimateStateSize(dogs.size()), [&dogs](auto& writer) {
+                serialization::WriteState(writer, dogs);
+            });
+            gs_.CacheStateSize(*player, cbor, response.body().size());
+            response.set(http::field::etag, etag);
+            if (req_.method() == http::verb::head) {
+                const size_t size = response.body().size();
+                response.body().clear();
+                response.content_length(size);
+            }
+            return response;
         }); 
     }
 
-    http::response<http::string_body> HandleActionRequest() {
+    ApiResponse HandleActionRequest() {
         if (req_.method() != http::verb::post) {
-            return MakeResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);
         }
-        return ExecuteAuthorized([this](/*const model::Player&*/std::shared_ptr<const model::Player> player) {
+        return ExecuteAuthorized([this](/*const model::Player&*/std::shared_ptr<const model::Player> player) -> ApiResponse {
             try {
-                json::value parsed_req = json::parse(req_.body());
-                player->GetDog()->SetDogDirection(static_cast<std::string>(parsed_req.as_object().at("move").as_string()));
+                RequestJson body;
+                json::value parsed_req = body.Parse(req_.body());
+                gs_.SetPlayerDirection(*player, static_cast<std::string>(parsed_req.as_object().at("move").as_string()));
             } catch (...) {
-                return MakeResponse(http::status::bad_request, Errors::ACTION_PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+                return MakeStaticResponse(http::status::bad_request, Errors::ACTION_PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
             }
-            json::object resp;
-            return MakeResponse(http::status::ok, json::serialize(resp), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            return MakeStaticResponse(http::status::ok, EMPTY_OBJECT, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
         }); 
     }
 
+    // Пачка действий разных игроков: [{"token": "...", "move": "R"}, ...].
+    // Токены берутся из тела, поэтому заголовок авторизации не нужен. Каждое действие расходует
+    // лимит своего токена так же, как отдельный запрос: сверх лимита действие отклоняется
+    ApiResponse HandleActionsBatchRequest() {
+        if (req_.method() != http::verb::post) {
+            return MakeStaticResponse(http::status::method_not_allowed, Errors::INVALID_METHOD, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv, "POST"sv);
+        }
+        json::array rejected;
+        int64_t accepted = 0;
+        try {
+            RequestJson body;
+            json::value parsed_req = body.Parse(req_.body());
+            const json::array& actions = parsed_req.as_array();
+            for (size_t i = 0; i < actions.size(); ++i) {
+                const json::object& action = actions[i].as_object();
+                std::shared_ptr<const model::Player> player;
+                if (auto token = ParseToken(static_cast<std::string>(action.at("token").as_string()))) {
+                    player = gs_.FindPlayer(*token);
+                }
+                std::string move = static_cast<std::string>(action.at("move").as_string());
+                if (!player || !model::Dog::IsValidDirection(move)
+                    || (token_limiter_ && token_limiter_->Enabled() && !token_limiter_->TryAcquire(*player->GetPlayerToken()))) {
+                    rejected.push_back(i);
+                    continue;
+                }
+                gs_.SetPlayerDirection(*player, std::move(move));
+                ++accepted;
+            }
+        } catch (...) {
+            return MakeStaticResponse(http::status::bad_request, Errors::ACTION_PARSING_ERROR, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+        }
+        json::object resp{{"accepted", accepted}, {"rejected", std::move(rejected)}};
+        return MakeResponse(http::status::ok, json::serialize(resp), req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+    }
 
 private:
+    constexpr static size_t MAX_RECORDS_PAGE = 100;
+    constexpr static std::string_view EMPTY_OBJECT = "{}"sv;
+
     const http::request<Body, http::basic_fields<Allocator>>& req_;
     GameServer& gs_;
-    RequestData& r_data_;
+    RequestData r_data_;
+    RateLimiter* token_limiter_ = nullptr;
+    std::shared_ptr<const model::Player> player_;
+
+    // Метод проверяется раньше токена, поэтому запрос с чужим методом получает 405, а не 401
+    bool RequiresAuthorization() const {
+        if (r_data_.type != RequestType::PLAYER) {
+            return false;
+        }
+        const http::verb method = req_.method();
+        if (r_data_.r_target == "players" || r_data_.r_target == "state") {
+            return method == http::verb::get || method == http::verb::head;
+        }
+        if (r_data_.r_target == "action") {
+            return method == http::verb::post;
+        }
+        return false;
+    }
+
+    // CBOR только по явной просьбе: application/cbor с ненулевым q, не ниже q у JSON.
+    // Для */* и без Accept остаётся JSON
+    bool AcceptsCbor() const {
+        auto it = req_.find(http::field::accept);
+        if (it == req_.end()) {
+            return false;
+        }
+        const double cbor = auxillary::AcceptQuality(it->value(), ContentType::CBOR, false);
+        return cbor > 0. && cbor >= auxillary::AcceptQuality(it->value(), ContentType::JSON);
+    }
+
+    // Ответ пишется сразу в тело, без промежуточного boost::json::object.
+    // Формат выбирается по заголовку Accept, обход модели у обоих форматов общий
+    template <typename Fn>
+    http::response<http::string_body> MakeSerializedResponse(size_t size_estimate, Fn&& write) {
+        std::string body;
+        body.reserve(size_estimate);
+        std::string_view content_type = ContentType::JSON;
+        if (AcceptsCbor()) {
+            serialization::CborWriter writer(body);
+            write(writer);
+            content_type = ContentType::CBOR;
+        } else {
+            serialization::JsonWriter writer(body);
+            write(writer);
+        }
+        auto response = MakeResponse(http::status::ok, std::move(body), req_.version(), req_.keep_alive(), content_type, "no-cache"sv);
+        response.set(http::field::vary, "Accept"sv);
+        return response;
+    }
+
+    // Номер запуска, вид ответа и версии состояния: после перезапуска сервера старые теги не совпадут
+    template <typename... Versions>
+    std::string MakeEtag(std::string_view kind, Versions... versions) const {
+        std::ostringstream tag;
+        tag << '"' << std::hex << gs_.GetInstanceId() << '-' << kind;
+        ((tag << '-' << versions), ...);
+        tag << '"';
+        return tag.str();
+    }
+
+    bool IsNotModified(std::string_view etag) const {
+        auto it = req_.find(http::field::if_none_match);
+        return it != req_.end() && auxillary::MatchesIfNoneMatch(it->value(), etag);
+    }
+
+    http::response<http::string_body> MakeNotModifiedResponse(const std::string& etag) const {
+        http::response<http::string_body> response(http::status::not_modified, req_.version());
+        response.set(http::field::date, http_server::CachedDate());
+        response.set(http::field::etag, etag);
+        response.set(http::field::cache_control, "no-cache"sv);
+        response.keep_alive(req_.keep_alive());
+        return response;
+    }
+
+    // Заголовки как у GET, длина - из размера тела; само тело не отправляется. Пустой etag не пишется
+    http::response<http::string_body> MakeHeadResponse(size_t body_size, std::string_view content_type, std::string_view etag = {}) const {
+        auto response = MakeResponse(http::status::ok, ""sv, req_.version(), req_.keep_alive(), content_type, "no-cache"sv);
+        response.content_length(body_size);
+        if (!etag.empty()) {
+            response.set(http::field::etag, etag);
+        }
+        return response;
+    }
+
+    http::response<http::string_body> MakeRenderedResponse(const std::string& body, bool cbor) const {
+        auto response = MakeResponse(http::status::ok, std::string_view(body), req_.version(), req_.keep_alive(),
+                                     cbor ? ContentType::CBOR : ContentType::JSON, "no-cache"sv);
+        response.set(http::field::vary, "Accept"sv);
+        return response;
+    }
 
     std::optional<model::Token> TryExtractToken() {
         std::string authorization;
@@ -232,29 +485,41 @@ private:
         } else {
             return std::nullopt;
         }
-        std::transform(authorization.begin(), authorization.end(), authorization.begin(), 
+        return ParseToken(std::move(authorization));
+    }
+
+    static std::optional<model::Token> ParseToken(std::string token) {
+        std::transform(token.begin(), token.end(), token.begin(), 
             [](unsigned char c) {
                 return std::tolower(c);
             });
-        if (authorization.size() != 32 || authorization.find_first_not_of("0123456789abcdef") != std::string::npos) {
+        if (token.size() != 32 || token.find_first_not_of("0123456789abcdef") != std::string::npos) {
             return std::nullopt;
         }
-        return model::Token(authorization);
+        return model::Token(std::move(token));
     }
 
-    template <typename Fn>
-    http::response<http::string_body> ExecuteAuthorized(Fn&& action) {
-        bool keep_alive = req_.keep_alive();
-        unsigned version = req_.version(); 
+    std::optional<ApiResponse> ResolvePlayer() {
         if (auto token = this->TryExtractToken()) {
-            std::shared_ptr<const model::Player> pl = gs_.FindPlayer(*token);
-            if (pl == nullptr) {
-                return MakeResponse(http::status::unauthorized, Errors::UNKNOWN_TOKEN, version, keep_alive, ContentType::JSON, "no-cache"sv);
+            player_ = gs_.FindPlayer(*token);
+            if (player_ == nullptr) {
+                return MakeStaticResponse(http::status::unauthorized, Errors::UNKNOWN_TOKEN, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+            }
+            return std::nullopt;
+        }
+        return MakeStaticResponse(http::status::unauthorized, Errors::INVALID_TOKEN, req_.version(), req_.keep_alive(), ContentType::JSON, "no-cache"sv);
+    }
+
+    // Игрок, найденный в PreAuthorize, мог выбыть до входа в strand. Это безопасно:
+    // объект жив, пока на него есть ссылка, а действия выбывших собак сессия отбрасывает
+    template <typename Fn>
+    ApiResponse ExecuteAuthorized(Fn&& action) {
+        if (!player_) {
+            if (auto rejection = ResolvePlayer()) {
+                return std::move(*rejection);
             }
-            return action(pl);
-        } else {
-            return MakeResponse(http::status::unauthorized, Errors::INVALID_TOKEN, version, keep_alive, ContentType::JSON, "no-cache"sv);
         }
+        return action(player_);
     }
 
 };
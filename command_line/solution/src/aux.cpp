@@ -1,5 +1,11 @@
 #include "aux.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <optional>
+
 namespace http_handler {
 
     const std::unordered_map<std::string, std::string_view> ContentType::DICT = {
@@ -11,6 +17,7 @@ namespace http_handler {
     {".js", "text/javascript"},
     {".json", "application/json"},
     {"json", "application/json"},  
+    {".cbor", "application/cbor"},
     {".xml", "application/xml"},
     {".png", "image/png"},
     {".jpg", "image/jpeg"},
@@ -60,4 +67,177 @@ bool IsSubPath(fs::path base, fs::path path) {
     return canonical_path.string().find(base.string()) == 0;
 }
 
-}
\ No newline at end of file
+std::unordered_map<std::string, std::string> ParseQuery(std::string_view query) {
+    std::unordered_map<std::string, std::string> params;
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        size_t eq = pair.find('=');
+        if (eq != std::string_view::npos) {
+            params[std::string(pair.substr(0, eq))] = std::string(pair.substr(eq + 1));
+        } else if (!pair.empty()) {
+            params[std::string(pair)] = "";
+        }
+        if (amp == std::string_view::npos) {
+            break;
+        }
+        query.remove_prefix(amp + 1);
+    }
+    return params;
+}
+
+bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+        const size_t comma = if_none_match.find(',');
+        std::string_view tag = if_none_match.substr(0, comma);
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) {
+            tag.remove_suffix(1);
+        }
+        if (tag.starts_with("W/"sv)) {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*"sv || tag == etag) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+namespace {
+
+std::string_view TrimSpaces(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+bool EqualsIgnoreCase(std::string_view l, std::string_view r) {
+    return std::equal(l.begin(), l.end(), r.begin(), r.end(), [](unsigned char a, unsigned char b) {
+        return std::tolower(a) == std::tolower(b);
+    });
+}
+
+// Следующий элемент списка через separator; список укорачивается
+std::string_view NextListItem(std::string_view& list, char separator) {
+    const size_t pos = list.find(separator);
+    const std::string_view item = TrimSpaces(list.substr(0, pos));
+    list.remove_prefix(pos == std::string_view::npos ? list.size() : pos + 1);
+    return item;
+}
+
+// Значение параметра q. Неразборчивое или вне [0, 1] - 0, как недопустимый вариант
+double ParseQuality(std::string_view params) {
+    while (!params.empty()) {
+        const std::string_view param = NextListItem(params, ';');
+        if (param.size() < 2 || std::tolower(static_cast<unsigned char>(param[0])) != 'q' || param[1] != '=') {
+            continue;
+        }
+        double q = 0.;
+        const auto [end, ec] = std::from_chars(param.data() + 2, param.data() + param.size(), q);
+        if (ec != std::errc{} || end != param.data() + param.size() || q < 0. || q > 1.) {
+            return 0.;
+        }
+        return q;
+    }
+    return 1.;
+}
+
+}  // namespace
+
+double AcceptQuality(std::string_view accept, std::string_view media_type, bool wildcards) {
+    const std::string_view type = media_type.substr(0, media_type.find('/'));
+    int best_specificity = -1;
+    double quality = 0.;
+    while (!accept.empty()) {
+        std::string_view item = NextListItem(accept, ',');
+        const std::string_view range = NextListItem(item, ';');
+        int specificity = -1;
+        if (EqualsIgnoreCase(range, media_type)) {
+            specificity = 2;
+        } else if (wildcards && range.size() == type.size() + 2 && range.ends_with("/*"sv) &&
+                   EqualsIgnoreCase(range.substr(0, type.size()), type)) {
+            specificity = 1;
+        } else if (wildcards && range == "*/*"sv) {
+            specificity = 0;
+        }
+        if (specificity > best_specificity) {
+            best_specificity = specificity;
+            quality = ParseQuality(item);
+        }
+    }
+    return quality;
+}
+
+namespace {
+
+uint64_t SplitMix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+std::optional<uint64_t> random_seed;
+std::atomic<uint64_t> random_thread_counter{0};
+
+}  // namespace
+
+FastRandom::FastRandom(uint64_t seed) {
+    for (uint64_t& s : state_) {
+        s = SplitMix64(seed);
+    }
+}
+
+uint64_t FastRandom::Next() {
+    const uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+    const uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = Rotl(state_[3], 45);
+    return result;
+}
+
+double FastRandom::NextDouble() {
+    return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+}
+
+size_t FastRandom::NextIndex(size_t n) {
+    // Умножение вместо деления по модулю; смещение пренебрежимо мало при n << 2^64
+    return static_cast<size_t>((static_cast<unsigned __int128>(Next()) * n) >> 64);
+}
+
+void SetRandomSeed(uint64_t seed) {
+    random_seed = seed;
+}
+
+FastRandom& ThreadRandom() {
+    // С заданным seed каждый поток получает свою детерминированную последовательность
+    thread_local FastRandom generator = [] {
+        if (random_seed) {
+            return FastRandom(*random_seed + random_thread_counter.fetch_add(1));
+        }
+        std::random_device rd;
+        return FastRandom((static_cast<uint64_t>(rd()) << 32) | rd());
+    }();
+    return generator;
+}
+
+}
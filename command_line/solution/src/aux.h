@@ -1,6 +1,7 @@
 #pragma once
 
 #include <random>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <sstream>
@@ -15,6 +16,7 @@ namespace http_handler {
 struct Errors {
 Errors() = delete;
     constexpr static std::string_view MAP_NOT_FOUND = R"({"code": "mapNotFound", "message": "Map not found"})"sv;
+    constexpr static std::string_view WRONG_SHARD = R"({"code": "wrongShard", "message": "Map is served by another shard"})"sv;
     constexpr static std::string_view BAD_REQ = R"({"code": "badRequest", "message": "Bad request"})"sv;
     constexpr static std::string_view PARSING_ERROR = R"({"code": "invalidArgument", "message": "Join request parsing failed"})"sv;
     constexpr static std::string_view ACTION_PARSING_ERROR = R"({"code": "invalidArgument", "message": "Action request parsing failed"})"sv;
@@ -26,6 +28,12 @@ Errors() = delete;
     constexpr static std::string_view INVALID_HEADER = R"({"code": "invalidToken", "message": "No authorization header is invalid"})"sv;
     constexpr static std::string_view INVALID_TOKEN = R"({"code": "invalidToken", "message": "Player token is invalid"})"sv;
     constexpr static std::string_view UNKNOWN_TOKEN = R"({"code": "unknownToken", "message": "Player token not found"})"sv;
+    constexpr static std::string_view RATE_LIMITED = R"({"code": "tooManyRequests", "message": "Rate limit exceeded"})"sv;
+    constexpr static std::string_view OVERLOADED = R"({"code": "serviceUnavailable", "message": "Server is overloaded"})"sv;
+    constexpr static std::string_view STATE_NOT_SAVED = R"({"code": "serviceUnavailable", "message": "Game state cannot be saved"})"sv;
+    constexpr static std::string_view RECORDS_PARAMS = R"({"code": "invalidArgument", "message": "Invalid start or maxItems"})"sv;
+    constexpr static std::string_view ADMIN_TOKEN = R"({"code": "invalidToken", "message": "Admin token is invalid"})"sv;
+    constexpr static std::string_view BAD_GATEWAY = R"({"code": "badGateway", "message": "Game server is unavailable"})"sv;
 };
 
 struct ContentType {
@@ -33,6 +41,7 @@ ContentType() = delete;
     constexpr static std::string_view HTML = "text/html"sv;
     constexpr static std::string_view PLAIN = "text/plain"sv;
     constexpr static std::string_view JSON = "application/json"sv;
+    constexpr static std::string_view CBOR = "application/cbor"sv;
     constexpr static std::string_view UNKNOWN = "application/octet-stream"sv;
     static const std::unordered_map<std::string, std::string_view> DICT;
 };
@@ -44,5 +53,33 @@ namespace auxillary {
 std::string UrlDecode(const std::string& str);
 bool IsSubPath(fs::path base, fs::path path);
 int GetRandomNumber(int min, int max);
+std::unordered_map<std::string, std::string> ParseQuery(std::string_view query);
+// Совпадает ли etag с одним из тегов заголовка If-None-Match. Сравнение слабое: префикс W/ не учитывается
+bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag);
+// Вес q типа media_type в заголовке Accept по самому точному подходящему диапазону: тип целиком,
+// затем type/* и */*. Без wildcards учитывается только точное упоминание. Не упомянут - 0
+double AcceptQuality(std::string_view accept, std::string_view media_type, bool wildcards = true);
+
+// xoshiro256** - быстрый генератор без системных вызовов при создании
+class FastRandom {
+public:
+    explicit FastRandom(uint64_t seed);
+
+    uint64_t Next();
+    // Равномерно в [0, 1)
+    double NextDouble();
+    // Равномерно в [0, n)
+    size_t NextIndex(size_t n);
+
+private:
+    uint64_t state_[4];
+};
+
+// Задаёт seed генераторов всех потоков. Вызывать до старта рабочих потоков.
+// Без вызова генераторы засеваются из std::random_device
+void SetRandomSeed(uint64_t seed);
+
+// Генератор текущего потока
+FastRandom& ThreadRandom();
 
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Примитивы двоичных форматов (журнал событий, WAL, снимок состояния).
+// Целые и длины - varint, числа с плавающей точкой и фиксированные поля - little-endian
+namespace serialization {
+
+static_assert(std::endian::native == std::endian::little, "Binary formats are little-endian");
+
+inline void PutVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline void PutString(std::string& out, std::string_view str) {
+    PutVarint(out, str.size());
+    out.append(str);
+}
+
+template <typename T>
+void PutFixed(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// Чтение из потока: false, если данные кончились посреди значения
+inline bool GetVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    throw std::runtime_error("Corrupted binary data: varint is too long");
+}
+
+inline bool GetString(std::istream& in, std::string& str) {
+    uint64_t size;
+    if (!GetVarint(in, size)) {
+        return false;
+    }
+    str.resize(size);
+    return static_cast<bool>(in.read(str.data(), size));
+}
+
+template <typename T>
+bool GetFixed(std::istream& in, T& value) {
+    char bytes[sizeof(T)];
+    if (!in.read(bytes, sizeof(T))) {
+        return false;
+    }
+    std::memcpy(&value, bytes, sizeof(T));
+    return true;
+}
+
+}  // namespace serialization
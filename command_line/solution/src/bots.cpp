@@ -0,0 +1,199 @@
+#include "bots.h"
+#include "placement.h"
+
+#include <boost/asio/post.hpp>
+
+#include <array>
+#include <cmath>
+#include <latch>
+#include <thread>
+
+namespace bots {
+
+using namespace std::literals;
+
+namespace {
+
+const std::array<std::string, 4> DIRECTIONS = {"U"s, "R"s, "D"s, "L"s};
+
+// Средняя частота случайной смены направления, раз в секунду
+constexpr double RANDOM_TURN_RATE = 0.5;
+// Дальше полуширины дороги: сдвиг поперёк дороги вне перекрёстка упрётся в её край
+constexpr double PROBE_DISTANCE = 0.5;
+// Офис достигнут, когда до него меньше этого по каждой оси
+constexpr double OFFICE_REACH = 0.5;
+
+model::ParamPairDouble DirectionVector(const std::string& dir) {
+    if (dir == "U") {
+        return {0., -1.};
+    } else if (dir == "R") {
+        return {1., 0.};
+    } else if (dir == "D") {
+        return {0., 1.};
+    }
+    return {-1., 0.};
+}
+
+const std::string& Opposite(const std::string& dir) {
+    if (dir == "U") {
+        return DIRECTIONS[2];
+    } else if (dir == "R") {
+        return DIRECTIONS[3];
+    } else if (dir == "D") {
+        return DIRECTIONS[0];
+    }
+    return DIRECTIONS[1];
+}
+
+// Можно ли пройти по дорогам в направлении dir дальше края текущей дороги
+bool CanGo(const model::Map& map, const model::Dog& dog, const std::string& dir) {
+    return !map.MoveAlongRoads(dog.GetRoadSegment(), dog.GetDogPosition(), DirectionVector(dir) * PROBE_DISTANCE).stopped;
+}
+
+// Случайное доступное направление, разворот - только из тупика
+std::string RandomRoadDirection(const model::Map& map, const model::Dog& dog, auxillary::FastRandom& random) {
+    std::array<const std::string*, 4> options;
+    size_t count = 0;
+    for (const std::string& dir : DIRECTIONS) {
+        if ((dog.GetDogDirection().empty() || dir != Opposite(dog.GetDogDirection())) && CanGo(map, dog, dir)) {
+            options[count++] = &dir;
+        }
+    }
+    if (count == 0) {
+        return dog.GetDogDirection().empty() ? ""s : Opposite(dog.GetDogDirection());
+    }
+    return *options[random.NextIndex(count)];
+}
+
+bool TurnNow(double dt, auxillary::FastRandom& random) {
+    return random.NextDouble() < 1. - std::exp(-RANDOM_TURN_RATE * dt);
+}
+
+}  // namespace
+
+BotController::BotController(unsigned threads) :
+    pool_(threads > 0 ? threads : static_cast<unsigned>(placement::AllowedCpus().size())) {
+}
+
+BotController::~BotController() {
+    pool_.join();
+}
+
+void BotController::AddBots(std::shared_ptr<model::GameSession> session, const model::BotsConfig& config) {
+    bots_.reserve(bots_.size() + config.count);
+    for (size_t i = 0; i < config.count; ++i) {
+        Bot& bot = bots_.emplace_back(Bot{nullptr, session, config.behavior, auxillary::FastRandom(auxillary::ThreadRandom().Next()), 0, {}, false});
+        SpawnDog(bot);
+    }
+}
+
+void BotController::SpawnDog(Bot& bot) {
+    if (bot.dog) {
+        bot_by_dog_.erase(bot.dog.get());
+    }
+    // Токен ботов не похож на токен игрока (32 hex-цифры) и не ищется в списке игроков
+    bot.dog = std::make_shared<model::Dog>(model::Token{"bot"s});
+    bot.session->AddDog(bot.dog, true, bot.random);
+    const auto& offices = bot.session->GetMap().GetOffices();
+    bot.target_office = offices.empty() ? 0 : bot.random.NextIndex(offices.size());
+    bot_by_dog_[bot.dog.get()] = &bot - bots_.data();
+}
+
+bool BotController::Respawn(const model::Dog& dog) {
+    auto it = bot_by_dog_.find(&dog);
+    if (it == bot_by_dog_.end()) {
+        return false;
+    }
+    SpawnDog(bots_[it->second]);
+    return true;
+}
+
+void BotController::Update(double dt) {
+    const size_t batches = (bots_.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+    if (batches > 0) {
+        // Последнюю пачку считает сам вызывающий поток, пока пул занят остальными
+        std::latch done(batches - 1);
+        for (size_t batch = 0; batch + 1 < batches; ++batch) {
+            boost::asio::post(pool_, [this, batch, dt, &done] {
+                for (size_t i = batch * BATCH_SIZE; i < (batch + 1) * BATCH_SIZE; ++i) {
+                    Decide(bots_[i], dt);
+                }
+                done.count_down();
+            });
+        }
+        for (size_t i = (batches - 1) * BATCH_SIZE; i < bots_.size(); ++i) {
+            Decide(bots_[i], dt);
+        }
+        done.wait();
+    }
+
+    for (Bot& bot : bots_) {
+        if (bot.changed) {
+            bot.session->SetDogDirection(*bot.dog, bot.decision);
+            bot.changed = false;
+        }
+    }
+}
+
+void BotController::Decide(Bot& bot, double dt) {
+    const model::Dog& dog = *bot.dog;
+    const model::Map& map = bot.session->GetMap();
+    std::string next = dog.GetDogDirection();
+
+    switch (bot.behavior) {
+        case model::BotBehavior::RANDOM_WALK:
+            if (!dog.IsMoving() || TurnNow(dt, bot.random)) {
+                next = DIRECTIONS[bot.random.NextIndex(DIRECTIONS.size())];
+            }
+            break;
+        case model::BotBehavior::FOLLOW_ROADS:
+            if (!dog.IsMoving() || TurnNow(dt, bot.random)) {
+                next = RandomRoadDirection(map, dog, bot.random);
+            }
+            break;
+        case model::BotBehavior::SEEK_OFFICES: {
+            const auto& offices = map.GetOffices();
+            if (offices.empty()) {
+                if (!dog.IsMoving()) {
+                    next = RandomRoadDirection(map, dog, bot.random);
+                }
+                break;
+            }
+            const model::Point target = offices[bot.target_office].GetPosition();
+            double dx = target.x - dog.GetDogPosition().x_;
+            double dy = target.y - dog.GetDogPosition().y_;
+            if (std::abs(dx) < OFFICE_REACH && std::abs(dy) < OFFICE_REACH) {
+                bot.target_office = bot.random.NextIndex(offices.size());
+                break;
+            }
+            dx = std::abs(dx) < OFFICE_REACH ? 0. : dx;
+            dy = std::abs(dy) < OFFICE_REACH ? 0. : dy;
+            // Сначала ось с большим расстоянием, затем другая; если обе закрыты - любая дорога
+            const std::string& along_x = dx > 0 ? DIRECTIONS[1] : DIRECTIONS[3];
+            const std::string& along_y = dy > 0 ? DIRECTIONS[2] : DIRECTIONS[0];
+            const bool x_first = std::abs(dx) >= std::abs(dy);
+            const std::array<std::pair<const std::string*, double>, 2> preferred = {
+                std::pair{x_first ? &along_x : &along_y, x_first ? dx : dy},
+                std::pair{x_first ? &along_y : &along_x, x_first ? dy : dx}};
+            bool found = false;
+            for (const auto& [dir, delta] : preferred) {
+                if (delta != 0. && CanGo(map, dog, *dir)) {
+                    next = *dir;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found && !dog.IsMoving()) {
+                next = RandomRoadDirection(map, dog, bot.random);
+            }
+            break;
+        }
+    }
+
+    if (next != dog.GetDogDirection() || !dog.IsMoving()) {
+        bot.decision = std::move(next);
+        bot.changed = true;
+    }
+}
+
+}  // namespace bots
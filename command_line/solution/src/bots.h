@@ -0,0 +1,67 @@
+#pragma once
+
+#include "model_game.h"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Боты: собаки без HTTP-клиента для нагрузочной проверки симуляции и "живых" карт.
+// Ботам не выдаются токены игроков, поэтому их нет в списке игроков, снимке состояния и журнале
+namespace bots {
+
+class BotController {
+public:
+    // threads == 0 - по числу ядер
+    explicit BotController(unsigned threads);
+    ~BotController();
+
+    BotController(const BotController&) = delete;
+    BotController& operator=(const BotController&) = delete;
+
+    void AddBots(std::shared_ptr<model::GameSession> session, const model::BotsConfig& config);
+
+    // Решения ботов считаются параллельно пачками, затем применяются на вызывающем потоке
+    // через GameSession::SetDogDirection - как действия игроков. Вызывать на strand игры перед тиком
+    void Update(double dt);
+
+    // Ушедший на покой бот заменяется новым на той же карте. false - собака не бот
+    bool Respawn(const model::Dog& dog);
+
+    bool IsBot(const model::Dog& dog) const {
+        return bot_by_dog_.contains(&dog);
+    }
+
+    size_t Size() const noexcept {
+        return bots_.size();
+    }
+
+private:
+    struct Bot {
+        std::shared_ptr<model::Dog> dog;
+        std::shared_ptr<model::GameSession> session;
+        model::BotBehavior behavior;
+        auxillary::FastRandom random;
+        // Офис, к которому идёт бот SEEK_OFFICES
+        size_t target_office = 0;
+        // Новое направление, посчитанное в параллельной фазе; пустая строка - остановка
+        std::string decision;
+        bool changed = false;
+    };
+
+    // Читает только собаку и неизменяемую карту, пишет только в сам bot
+    static void Decide(Bot& bot, double dt);
+    void SpawnDog(Bot& bot);
+
+    // Столько ботов обрабатывает одна задача пула
+    constexpr static size_t BATCH_SIZE = 512;
+
+    std::vector<Bot> bots_;
+    std::unordered_map<const model::Dog*, size_t> bot_by_dog_;
+    boost::asio::thread_pool pool_;
+};
+
+}  // namespace bots
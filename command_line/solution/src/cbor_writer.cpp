@@ -0,0 +1,132 @@
+#include "cbor_writer.h"
+
+#include <bit>
+#include <cmath>
+#include <optional>
+
+namespace serialization {
+
+namespace {
+
+constexpr uint8_t MAJOR_UNSIGNED = 0;
+constexpr uint8_t MAJOR_NEGATIVE = 1;
+constexpr uint8_t MAJOR_TEXT = 3;
+constexpr uint8_t MAJOR_SIMPLE = 7;
+
+constexpr char INDEFINITE_ARRAY = '\x9f';
+constexpr char INDEFINITE_MAP = '\xbf';
+constexpr char BREAK = '\xff';
+
+constexpr uint8_t HALF_FLOAT = 25;
+constexpr uint8_t SINGLE_FLOAT = 26;
+constexpr uint8_t DOUBLE_FLOAT = 27;
+
+// half-float с тем же значением, если оно представимо точно
+std::optional<uint16_t> ToHalfExact(float f) {
+    const uint32_t bits = std::bit_cast<uint32_t>(f);
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const int exp = static_cast<int>((bits >> 23) & 0xFF) - 127;
+    const uint32_t mant = bits & 0x7FFFFF;
+    if ((bits & 0x7FFFFFFF) == 0) {
+        return sign;
+    }
+    if (exp >= -14 && exp <= 15) {
+        if (mant & 0x1FFF) {
+            return std::nullopt;
+        }
+        return static_cast<uint16_t>(sign | ((exp + 15) << 10) | (mant >> 13));
+    }
+    // Денормализованные half: значение h * 2^-24
+    if (exp >= -24 && exp < -14) {
+        const uint32_t full = 0x800000 | mant;
+        const int shift = -(exp + 1);
+        if (full & ((1u << shift) - 1)) {
+            return std::nullopt;
+        }
+        return static_cast<uint16_t>(sign | (full >> shift));
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+void CborWriter::BeginObject() {
+    out_.push_back(INDEFINITE_MAP);
+}
+
+void CborWriter::EndObject() {
+    out_.push_back(BREAK);
+}
+
+void CborWriter::BeginArray() {
+    out_.push_back(INDEFINITE_ARRAY);
+}
+
+void CborWriter::EndArray() {
+    out_.push_back(BREAK);
+}
+
+void CborWriter::Key(std::string_view key) {
+    String(key);
+}
+
+void CborWriter::Key(int64_t key) {
+    Int(key);
+}
+
+void CborWriter::String(std::string_view value) {
+    Head(MAJOR_TEXT, value.size());
+    out_.append(value);
+}
+
+void CborWriter::Int(int64_t value) {
+    if (value >= 0) {
+        Head(MAJOR_UNSIGNED, static_cast<uint64_t>(value));
+    } else {
+        Head(MAJOR_NEGATIVE, static_cast<uint64_t>(-1 - value));
+    }
+}
+
+void CborWriter::Double(double value) {
+    if (std::isnan(value)) {
+        Head(MAJOR_SIMPLE, HALF_FLOAT, 0x7E00);
+        return;
+    }
+    const float single = static_cast<float>(value);
+    if (static_cast<double>(single) != value) {
+        Head(MAJOR_SIMPLE, DOUBLE_FLOAT, std::bit_cast<uint64_t>(value));
+    } else if (std::isinf(single)) {
+        Head(MAJOR_SIMPLE, HALF_FLOAT, single > 0 ? 0x7C00 : 0xFC00);
+    } else if (auto half = ToHalfExact(single)) {
+        Head(MAJOR_SIMPLE, HALF_FLOAT, *half);
+    } else {
+        Head(MAJOR_SIMPLE, SINGLE_FLOAT, std::bit_cast<uint32_t>(single));
+    }
+}
+
+void CborWriter::Head(uint8_t major, uint64_t value) {
+    if (value < 24) {
+        out_.push_back(static_cast<char>(major << 5 | value));
+    } else if (value <= 0xFF) {
+        Head(major, 24, value);
+    } else if (value <= 0xFFFF) {
+        Head(major, 25, value);
+    } else if (value <= 0xFFFFFFFF) {
+        Head(major, 26, value);
+    } else {
+        Head(major, 27, value);
+    }
+}
+
+void CborWriter::Head(uint8_t major, uint8_t additional, uint64_t argument) {
+    // Аргумент занимает 1, 2, 4 или 8 байт в сетевом порядке, всё пишется одним append
+    const unsigned bytes = 1u << (additional - 24);
+    char buf[9];
+    buf[0] = static_cast<char>(major << 5 | additional);
+    for (unsigned i = 0; i < bytes; ++i) {
+        buf[bytes - i] = static_cast<char>(argument >> (8 * i));
+    }
+    out_.append(buf, bytes + 1);
+}
+
+}  // namespace serialization
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+// Потоковая запись CBOR (RFC 8949) с тем же интерфейсом, что и JsonWriter.
+// Объекты и массивы пишутся с неопределённой длиной, поэтому количество элементов заранее не нужно.
+// Числа с плавающей точкой кодируются без потерь в самом коротком из half/single/double
+class CborWriter {
+public:
+    explicit CborWriter(std::string& out) :
+        out_(out) {}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    void Key(std::string_view key);
+    // Числовые ключи (id игроков) пишутся целыми, а не строками
+    void Key(int64_t key);
+
+    void String(std::string_view value);
+    void Int(int64_t value);
+    void Double(double value);
+
+private:
+    // Заголовок элемента с аргументом в кратчайшей форме
+    void Head(uint8_t major, uint64_t value);
+    // Заголовок с явно заданной длиной аргумента (24..27)
+    void Head(uint8_t major, uint8_t additional, uint64_t argument);
+
+    std::string& out_;
+};
+
+}  // namespace serialization
@@ -0,0 +1,162 @@
+#include "collision_detector.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace collision_detector {
+
+namespace {
+
+constexpr double MIN_CELL_SIZE = 1.;
+
+// Равномерная сетка над предметами. Предметы отсортированы по ячейкам,
+// для каждой непустой ячейки хранится диапазон в отсортированном массиве
+class ItemGrid {
+public:
+    ItemGrid(const ItemGathererProvider& provider, double max_gatherer_width) {
+        const size_t count = provider.ItemsCount();
+        items_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            items_.push_back(provider.GetItem(i));
+            max_item_width_ = std::max(max_item_width_, items_.back().width);
+        }
+        // Ячейка не меньше диаметра сбора: отрезок вдоль оси задевает не больше трёх рядов ячеек
+        cell_size_ = std::max(MIN_CELL_SIZE, 2 * (max_item_width_ + max_gatherer_width));
+
+        std::vector<std::pair<uint64_t, size_t>> keyed;
+        keyed.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            keyed.emplace_back(CellKey(CellCoord(items_[i].position.x_), CellCoord(items_[i].position.y_)), i);
+        }
+        std::sort(keyed.begin(), keyed.end());
+
+        sorted_ids_.reserve(count);
+        for (size_t i = 0; i < keyed.size(); ++i) {
+            if (i == 0 || keyed[i].first != keyed[i - 1].first) {
+                cells_[keyed[i].first] = {i, i};
+            }
+            ++cells_[keyed[i].first].second;
+            sorted_ids_.push_back(keyed[i].second);
+        }
+    }
+
+    const Item& GetItem(size_t id) const {
+        return items_[id];
+    }
+
+    double GetMaxItemWidth() const {
+        return max_item_width_;
+    }
+
+    template <typename Fn>
+    void ForEachInBox(ParamPairDouble min_c, ParamPairDouble max_c, Fn&& fn) const {
+        const int64_t x0 = CellCoord(min_c.x_);
+        const int64_t x1 = CellCoord(max_c.x_);
+        const int64_t y0 = CellCoord(min_c.y_);
+        const int64_t y1 = CellCoord(max_c.y_);
+        // Огромный отрезок (например, /tick с большим timeDelta) дешевле проверить перебором
+        if (static_cast<double>(x1 - x0 + 1) * static_cast<double>(y1 - y0 + 1) > static_cast<double>(cells_.size())) {
+            for (size_t id = 0; id < items_.size(); ++id) {
+                fn(id);
+            }
+            return;
+        }
+        for (int64_t x = x0; x <= x1; ++x) {
+            for (int64_t y = y0; y <= y1; ++y) {
+                auto it = cells_.find(CellKey(x, y));
+                if (it == cells_.end()) {
+                    continue;
+                }
+                for (size_t i = it->second.first; i < it->second.second; ++i) {
+                    fn(sorted_ids_[i]);
+                }
+            }
+        }
+    }
+
+private:
+    int64_t CellCoord(double c) const {
+        return static_cast<int64_t>(std::floor(c / cell_size_));
+    }
+
+    static uint64_t CellKey(int64_t x, int64_t y) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    std::vector<Item> items_;
+    std::vector<size_t> sorted_ids_;
+    std::unordered_map<uint64_t, std::pair<size_t, size_t>> cells_;
+    double cell_size_ = MIN_CELL_SIZE;
+    double max_item_width_ = 0.;
+};
+
+}  // namespace
+
+CollectionResult TryCollectPoint(ParamPairDouble a, ParamPairDouble b, ParamPairDouble c) {
+    // Проверим, что перемещение ненулевое.
+    // Тут приходится использовать строгое равенство, а не приближённое,
+    // поскольку при сборе заказов придётся учитывать перемещение даже на небольшое
+    // расстояние.
+    assert(b.x_ != a.x_ || b.y_ != a.y_);
+    const double u_x = c.x_ - a.x_;
+    const double u_y = c.y_ - a.y_;
+    const double v_x = b.x_ - a.x_;
+    const double v_y = b.y_ - a.y_;
+    const double u_dot_v = u_x * v_x + u_y * v_y;
+    const double u_len2 = u_x * u_x + u_y * u_y;
+    const double v_len2 = v_x * v_x + v_y * v_y;
+    const double proj_ratio = u_dot_v / v_len2;
+    const double sq_distance = u_len2 - (u_dot_v * u_dot_v) / v_len2;
+
+    return CollectionResult{sq_distance, proj_ratio};
+}
+
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(provider.GatherersCount());
+    double max_gatherer_width = 0.;
+    for (size_t i = 0; i < provider.GatherersCount(); ++i) {
+        gatherers.push_back(provider.GetGatherer(i));
+        max_gatherer_width = std::max(max_gatherer_width, gatherers.back().width);
+    }
+
+    ItemGrid grid(provider, max_gatherer_width);
+    std::vector<GatheringEvent> events;
+
+    for (size_t gatherer_id = 0; gatherer_id < gatherers.size(); ++gatherer_id) {
+        const Gatherer& gatherer = gatherers[gatherer_id];
+        if (gatherer.start_pos.x_ == gatherer.end_pos.x_ && gatherer.start_pos.y_ == gatherer.end_pos.y_) {
+            continue;
+        }
+        const double reach = gatherer.width + grid.GetMaxItemWidth();
+        ParamPairDouble min_c{std::min(gatherer.start_pos.x_, gatherer.end_pos.x_) - reach,
+                              std::min(gatherer.start_pos.y_, gatherer.end_pos.y_) - reach};
+        ParamPairDouble max_c{std::max(gatherer.start_pos.x_, gatherer.end_pos.x_) + reach,
+                              std::max(gatherer.start_pos.y_, gatherer.end_pos.y_) + reach};
+
+        grid.ForEachInBox(min_c, max_c, [&](size_t item_id) {
+            const Item& item = grid.GetItem(item_id);
+            CollectionResult result = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+            if (result.IsCollected(gatherer.width + item.width)) {
+                events.push_back({item_id, gatherer_id, result.sq_distance, result.proj_ratio});
+            }
+        });
+    }
+
+    std::sort(events.begin(), events.end(), [](const GatheringEvent& l, const GatheringEvent& r) {
+        if (l.time != r.time) {
+            return l.time < r.time;
+        }
+        if (l.gatherer_id != r.gatherer_id) {
+            return l.gatherer_id < r.gatherer_id;
+        }
+        return l.item_id < r.item_id;
+    });
+    return events;
+}
+
+}  // namespace collision_detector
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace collision_detector {
+
+using model::ParamPairDouble;
+
+struct CollectionResult {
+    bool IsCollected(double collect_radius) const {
+        return proj_ratio >= 0 && proj_ratio <= 1 && sq_distance <= collect_radius * collect_radius;
+    }
+
+    // Квадрат расстояния до точки
+    double sq_distance;
+    // Доля пройденного отрезка
+    double proj_ratio;
+};
+
+// Движемся из точки a в точку b и пытаемся подобрать точку c.
+// Отрезок ab должен иметь ненулевую длину
+CollectionResult TryCollectPoint(ParamPairDouble a, ParamPairDouble b, ParamPairDouble c);
+
+// Круглый объект: предмет на карте или офис, куда сдают предметы
+struct Item {
+    ParamPairDouble position;
+    double width;
+};
+
+// Собака за тик: отрезок от начальной до конечной позиции
+struct Gatherer {
+    ParamPairDouble start_pos;
+    ParamPairDouble end_pos;
+    double width;
+};
+
+class ItemGathererProvider {
+protected:
+    ~ItemGathererProvider() = default;
+
+public:
+    virtual size_t ItemsCount() const = 0;
+    virtual Item GetItem(size_t idx) const = 0;
+    virtual size_t GatherersCount() const = 0;
+    virtual Gatherer GetGatherer(size_t idx) const = 0;
+};
+
+struct GatheringEvent {
+    size_t item_id;
+    size_t gatherer_id;
+    double sq_distance;
+    double time;
+};
+
+// Возвращает события сбора, упорядоченные по времени внутри тика.
+// Широкая фаза - равномерная сетка по предметам: собака проверяет только ячейки,
+// которые задевает её отрезок, расширенный на радиусы сбора
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
+
+}  // namespace collision_detector
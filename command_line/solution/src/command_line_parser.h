@@ -1,5 +1,6 @@
 #include <boost/program_options.hpp>
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -12,6 +13,37 @@ struct Args {
     std::string static_root;
     unsigned int tick_period = 0;
     bool random_spawn = false;
+    std::string threading_model = "shared";
+    unsigned int idle_timeout = 30000;
+    unsigned int header_timeout = 30000;
+    unsigned int body_timeout = 30000;
+    std::string records_file;
+    std::optional<uint64_t> random_seed;
+    double ip_rate_limit = 0.;
+    double ip_burst = 0.;
+    double token_rate_limit = 0.;
+    double token_burst = 0.;
+    std::vector<std::string> trusted_proxies;
+    size_t max_strand_queue = 0;
+    unsigned short port = 8080;
+    std::optional<unsigned> shard_id;
+    unsigned shard_count = 1;
+    std::string journal_file;
+    std::string replay_file;
+    std::string state_file;
+    unsigned int save_state_period = 0;
+    unsigned int wal_sync_interval = 0;
+    unsigned int bot_threads = 0;
+    unsigned int map_render_threads = 0;
+    double simulate_seconds = 0.;
+    double state_radius = 0.;
+    unsigned int drain_timeout = 10000;
+    std::string handoff_socket;
+    std::string admin_token;
+    unsigned int memory_log_period = 0;
+    bool pin_threads = false;
+    std::optional<unsigned> numa_node;
+    std::string huge_pages = "off";
 };
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -23,7 +55,38 @@ struct Args {
         ("tick-period,t", po::value<unsigned int>(&args.tick_period)->value_name("milliseconds"s), "set tick period")
         ("config-file,c", po::value(&args.config_file_path)->value_name("file"s), "set config file path")
         ("www-root,w", po::value(&args.static_root)->value_name("dir"s), "set static files root")
-        ("randomize-spawn-points", po::value<bool>(&args.random_spawn), "spawn dogs at random position");
+        ("randomize-spawn-points", po::value<bool>(&args.random_spawn), "spawn dogs at random position")
+        ("threading-model", po::value(&args.threading_model)->value_name("shared|per-core"s), "shared io_context for all threads or io_context per core")
+        ("idle-timeout", po::value<unsigned int>(&args.idle_timeout)->value_name("milliseconds"s), "close keep-alive connection idle for this time")
+        ("header-timeout", po::value<unsigned int>(&args.header_timeout)->value_name("milliseconds"s), "max time to read request headers")
+        ("body-timeout", po::value<unsigned int>(&args.body_timeout)->value_name("milliseconds"s), "max time to read request body")
+        ("records-file", po::value(&args.records_file)->value_name("file"s), "set retired players records file path")
+        ("random-seed", po::value<uint64_t>()->value_name("seed"s), "seed random spawn points for reproducible runs")
+        ("ip-rate-limit", po::value<double>(&args.ip_rate_limit)->value_name("requests/s"s), "max request rate per client IP, 0 - unlimited")
+        ("ip-burst", po::value<double>(&args.ip_burst)->value_name("requests"s), "request burst allowed per client IP")
+        ("trusted-proxy", po::value(&args.trusted_proxies)->value_name("ip"s)->composing(), "take the client IP for --ip-rate-limit from X-Forwarded-For of requests from this address (game_router)")
+        ("token-rate-limit", po::value<double>(&args.token_rate_limit)->value_name("requests/s"s), "max request rate per auth token, 0 - unlimited")
+        ("token-burst", po::value<double>(&args.token_burst)->value_name("requests"s), "request burst allowed per auth token")
+        ("max-strand-queue", po::value<size_t>(&args.max_strand_queue)->value_name("requests"s), "reject API requests with 503 when this many wait for the game strand, 0 - unlimited")
+        ("port", po::value<unsigned short>(&args.port)->value_name("port"s), "listen port, 8080 by default")
+        ("shard-id", po::value<unsigned>()->value_name("id"s), "shard number written into player tokens when running behind game_router")
+        ("shard-count", po::value<unsigned>(&args.shard_count)->value_name("shards"s), "number of game_router upstreams: join and bots only for maps of this shard, 1 by default")
+        ("journal", po::value(&args.journal_file)->value_name("file"s), "append every join, action and tick to a binary journal")
+        ("replay", po::value(&args.replay_file)->value_name("file"s), "replay a journal without network at full speed and exit")
+        ("state-file", po::value(&args.state_file)->value_name("file"s), "restore players from this snapshot and its write-ahead log on start, save them on exit")
+        ("save-state-period", po::value<unsigned int>(&args.save_state_period)->value_name("milliseconds"s), "snapshot game state every this much game time, 0 - only on exit")
+        ("wal-sync-interval", po::value<unsigned int>(&args.wal_sync_interval)->value_name("milliseconds"s), "max delay before write-ahead log fdatasync, 0 - sync every batch")
+        ("bot-threads", po::value<unsigned int>(&args.bot_threads)->value_name("threads"s), "threads computing bot decisions, 0 - one per core")
+        ("map-render-threads", po::value<unsigned int>(&args.map_render_threads)->value_name("threads"s), "threads rendering map responses at startup, 0 - one per core")
+        ("state-radius", po::value<double>(&args.state_radius)->value_name("distance"s), "return only dogs within this distance of the player's dog from /state, 0 - whole session")
+        ("drain-timeout", po::value<unsigned int>(&args.drain_timeout)->value_name("milliseconds"s), "on SIGTERM stop accepting and wait this long for open connections to finish, 0 - stop at once")
+        ("handoff-socket", po::value(&args.handoff_socket)->value_name("path"s), "unix socket to take listening sockets from a running server and to hand them to the next one")
+        ("admin-token", po::value(&args.admin_token)->value_name("token"s), "enable /api/v1/admin/* for requests with this bearer token")
+        ("memory-log-period", po::value<unsigned int>(&args.memory_log_period)->value_name("milliseconds"s), "log memory usage by subsystem with this period, 0 - never")
+        ("pin-threads", po::value<bool>(&args.pin_threads), "pin io threads of the shared threading model to cores, per-core threads are always pinned")
+        ("numa-node", po::value<unsigned>()->value_name("node"s), "run on the cores of this NUMA node and allocate memory from it")
+        ("huge-pages", po::value(&args.huge_pages)->value_name("off|transparent|explicit"s), "back large dog and grid arrays with transparent or hugetlbfs huge pages")
+        ("simulate", po::value<double>(&args.simulate_seconds)->value_name("seconds"s), "run bots from the map config for this much game time without network at full speed and exit");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -34,10 +97,43 @@ struct Args {
         return std::nullopt;
     }
 
-    if (vm.contains("config-file") && vm.contains("www-root")) {
+    // Без явного размера ведра допускается всплеск в одну секунду запросов
+    if (!vm.contains("ip-burst"s)) {
+        args.ip_burst = args.ip_rate_limit;
+    }
+    if (!vm.contains("token-burst"s)) {
+        args.token_burst = args.token_rate_limit;
+    }
+
+    if (vm.contains("random-seed"s)) {
+        args.random_seed = vm["random-seed"s].as<uint64_t>();
+    }
+
+    if (vm.contains("shard-id"s)) {
+        args.shard_id = vm["shard-id"s].as<unsigned>();
+    }
+    if (args.shard_count == 0 || args.shard_id.value_or(0) >= args.shard_count) {
+        throw std::runtime_error("--shard-id must be less than --shard-count"s);
+    }
+
+    if (vm.contains("numa-node"s)) {
+        args.numa_node = vm["numa-node"s].as<unsigned>();
+    }
+
+    // Игроки из снимка не записаны в журнал, и его нельзя было бы воспроизвести
+    if (!args.journal_file.empty() && !args.state_file.empty()) {
+        throw std::runtime_error("--journal cannot be combined with --state-file"s);
+    }
+
+    if (args.threading_model != "shared"s && args.threading_model != "per-core"s) {
+        throw std::runtime_error("Unknown threading model: "s + args.threading_model);
+    }
+
+    // Для воспроизведения журнала и прогона ботов статика не нужна
+    if (vm.contains("config-file") && (vm.contains("www-root") || vm.contains("replay") || vm.contains("simulate"))) {
         return args;
     } else {
-        throw std::runtime_error("Usage: game_server --tick-period[int, optional] --config-file <game-config-json> --www-root <dir-to-content> --randomize-spawn-points[bool, optional]");
+        throw std::runtime_error("Usage: game_server --tick-period[int, optional] --config-file <game-config-json> --www-root <dir-to-content> --randomize-spawn-points[bool, optional] --threading-model[shared|per-core, optional]");
     }
     return std::nullopt;
 }
\ No newline at end of file
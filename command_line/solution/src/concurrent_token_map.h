@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "epoch_reclamation.h"
+
+namespace model {
+
+// Хеш-таблица с открытой адресацией: чтение без ожидания из любого потока, запись под мьютексом.
+// Слот хранит указатель на неизменяемый узел, поэтому читатель видит запись целиком или не видит вовсе.
+// Удалённые узлы и старые таблицы после расширения освобождаются через EpochReclamation
+template <typename Key, typename Value, typename Hasher>
+class ConcurrentTokenMap {
+    ConcurrentTokenMap(const ConcurrentTokenMap&) = delete;
+    ConcurrentTokenMap& operator=(const ConcurrentTokenMap&) = delete;
+
+public:
+    ConcurrentTokenMap() :
+        table_(new Table(MIN_CAPACITY)) {}
+
+    ~ConcurrentTokenMap() {
+        Table* table = table_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            Node* node = table->slots[i].load(std::memory_order_relaxed);
+            if (node && node != Tombstone()) {
+                delete node;
+            }
+        }
+        delete table;
+    }
+
+    // Пустое значение, если ключа нет. Длина пробирования ограничена ёмкостью таблицы
+    Value Find(const Key& key) const {
+        util::EpochReclamation::Guard guard;
+        const size_t hash = Hasher{}(key);
+        const Table* table = table_.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            const Node* node = table->slots[(hash + i) & table->mask].load(std::memory_order_acquire);
+            if (!node) {
+                break;
+            }
+            if (node != Tombstone() && node->hash == hash && node->key == key) {
+                return node->value;
+            }
+        }
+        return Value{};
+    }
+
+    // false, если ключ уже есть
+    bool Insert(const Key& key, Value value) {
+        std::lock_guard lock(write_mutex_);
+        const size_t hash = Hasher{}(key);
+        Table* table = table_.load(std::memory_order_relaxed);
+        std::atomic<Node*>* target = nullptr;
+        for (size_t i = 0; i <= table->mask; ++i) {
+            std::atomic<Node*>& slot = table->slots[(hash + i) & table->mask];
+            Node* node = slot.load(std::memory_order_relaxed);
+            if (!node) {
+                if (!target) {
+                    target = &slot;
+                }
+                break;
+            }
+            if (node == Tombstone()) {
+                if (!target) {
+                    target = &slot;
+                }
+            } else if (node->hash == hash && node->key == key) {
+                return false;
+            }
+        }
+        if (!target || (target->load(std::memory_order_relaxed) == nullptr && (table->occupied + 1) * 2 > table->mask + 1)) {
+            table = Grow(size_ + 1);
+            target = &FreeSlot(*table, hash);
+        }
+        if (target->load(std::memory_order_relaxed) == nullptr) {
+            ++table->occupied;
+        }
+        // Точка линеаризации вставки: после этой записи узел виден всем читателям
+        target->store(new Node{key, hash, std::move(value)}, std::memory_order_release);
+        ++size_;
+        return true;
+    }
+
+    // Возвращает удалённое значение или пустое, если ключа не было
+    Value Erase(const Key& key) {
+        std::lock_guard lock(write_mutex_);
+        const size_t hash = Hasher{}(key);
+        Table* table = table_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            std::atomic<Node*>& slot = table->slots[(hash + i) & table->mask];
+            Node* node = slot.load(std::memory_order_relaxed);
+            if (!node) {
+                break;
+            }
+            if (node != Tombstone() && node->hash == hash && node->key == key) {
+                slot.store(Tombstone(), std::memory_order_release);
+                --size_;
+                Value value = node->value;
+                util::EpochReclamation::Instance().Retire([node] { delete node; });
+                return value;
+            }
+        }
+        return Value{};
+    }
+
+    // Обход под мьютексом писателя: таблица не меняется, пока fn работает
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        std::lock_guard lock(write_mutex_);
+        const Table* table = table_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            const Node* node = table->slots[i].load(std::memory_order_relaxed);
+            if (node && node != Tombstone()) {
+                fn(node->key, node->value);
+            }
+        }
+    }
+
+    size_t Size() const {
+        std::lock_guard lock(write_mutex_);
+        return size_;
+    }
+
+    // Таблица и узлы без памяти, на которую ссылаются ключи и значения
+    size_t MemoryUsage() const {
+        std::lock_guard lock(write_mutex_);
+        const Table* table = table_.load(std::memory_order_relaxed);
+        return sizeof(Table) + (table->mask + 1) * sizeof(std::atomic<Node*>) + size_ * sizeof(Node);
+    }
+
+private:
+    constexpr static size_t MIN_CAPACITY = 64;
+
+    struct Node {
+        const Key key;
+        const size_t hash;
+        const Value value;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) :
+            mask(capacity - 1),
+            slots(new std::atomic<Node*>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        const size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> slots;
+        // Занятые слоты вместе с надгробиями, меняется только писателем
+        size_t occupied = 0;
+    };
+
+    // Метка удалённого слота: цепочку пробирования нельзя рвать пустым слотом
+    static Node* Tombstone() {
+        static Node* const tombstone = reinterpret_cast<Node*>(alignof(Node));
+        return tombstone;
+    }
+
+    static std::atomic<Node*>& FreeSlot(Table& table, size_t hash) {
+        for (size_t i = 0;; ++i) {
+            std::atomic<Node*>& slot = table.slots[(hash + i) & table.mask];
+            if (slot.load(std::memory_order_relaxed) == nullptr) {
+                return slot;
+            }
+        }
+    }
+
+    // Новая таблица без надгробий заполняется живыми узлами и публикуется целиком.
+    // Узлы переезжают без копирования, старый массив слотов освобождается через эпоху
+    Table* Grow(size_t live) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < live * 4) {
+            capacity *= 2;
+        }
+        Table* old_table = table_.load(std::memory_order_relaxed);
+        auto table = std::make_unique<Table>(capacity);
+        for (size_t i = 0; i <= old_table->mask; ++i) {
+            Node* node = old_table->slots[i].load(std::memory_order_relaxed);
+            if (node && node != Tombstone()) {
+                FreeSlot(*table, node->hash).store(node, std::memory_order_relaxed);
+                ++table->occupied;
+            }
+        }
+        table_.store(table.get(), std::memory_order_release);
+        util::EpochReclamation::Instance().Retire([old_table] { delete old_table; });
+        return table.release();
+    }
+
+    std::atomic<Table*> table_;
+    mutable std::mutex write_mutex_;
+    size_t size_ = 0;
+};
+
+}  // namespace model
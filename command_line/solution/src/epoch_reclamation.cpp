@@ -0,0 +1,111 @@
+#include "epoch_reclamation.h"
+
+#include <stdexcept>
+
+namespace util {
+
+// Слот закрепляется за потоком при первом чтении и освобождается при завершении потока
+struct EpochReclamation::ThreadState {
+    ThreadSlot* slot = nullptr;
+    unsigned depth = 0;
+
+    ~ThreadState() {
+        if (slot) {
+            EpochReclamation::Instance().ReleaseSlot(*slot);
+        }
+    }
+};
+
+EpochReclamation& EpochReclamation::Instance() {
+    static EpochReclamation instance;
+    return instance;
+}
+
+EpochReclamation::ThreadState& EpochReclamation::LocalState() {
+    thread_local ThreadState state;
+    return state;
+}
+
+EpochReclamation::Guard::Guard() {
+    ThreadState& state = LocalState();
+    if (state.depth++ > 0) {
+        return;
+    }
+    EpochReclamation& ebr = Instance();
+    if (!state.slot) {
+        state.slot = &ebr.AcquireSlot();
+    }
+    state.slot->epoch.store(ebr.global_epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // Объявление эпохи должно стать видимым раньше любых чтений защищаемой структуры
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochReclamation::Guard::~Guard() {
+    ThreadState& state = LocalState();
+    if (--state.depth == 0) {
+        state.slot->epoch.store(IDLE, std::memory_order_release);
+    }
+}
+
+EpochReclamation::ThreadSlot& EpochReclamation::AcquireSlot() {
+    for (size_t i = 0; i < MAX_THREADS; ++i) {
+        bool expected = false;
+        if (slots_[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            size_t high = slots_high_water_.load(std::memory_order_relaxed);
+            while (high < i + 1 && !slots_high_water_.compare_exchange_weak(high, i + 1, std::memory_order_acq_rel)) {
+            }
+            return slots_[i];
+        }
+    }
+    throw std::runtime_error("Too many threads use epoch-based reclamation");
+}
+
+void EpochReclamation::ReleaseSlot(ThreadSlot& slot) {
+    slot.epoch.store(IDLE, std::memory_order_release);
+    slot.in_use.store(false, std::memory_order_release);
+}
+
+void EpochReclamation::Retire(std::function<void()> deleter) {
+    std::lock_guard lock(retire_mutex_);
+    retired_.emplace_back(global_epoch_.load(std::memory_order_relaxed), std::move(deleter));
+    if (retired_.size() >= RECLAIM_BATCH) {
+        TryAdvance();
+        Reclaim(false);
+    }
+}
+
+// Эпоха продвигается, только если каждый активный читатель уже видел текущую
+bool EpochReclamation::TryAdvance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+    const size_t count = slots_high_water_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t slot_epoch = slots_[i].epoch.load(std::memory_order_acquire);
+        if (slot_epoch != IDLE && slot_epoch != epoch) {
+            return false;
+        }
+    }
+    global_epoch_.store(epoch + 1, std::memory_order_release);
+    return true;
+}
+
+void EpochReclamation::Reclaim(bool force) {
+    const uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+    auto keep = retired_.begin();
+    for (auto it = retired_.begin(); it != retired_.end(); ++it) {
+        if (force || it->first + 2 <= epoch) {
+            it->second();
+        } else {
+            *keep++ = std::move(*it);
+        }
+    }
+    retired_.erase(keep, retired_.end());
+}
+
+// Статический объект разрушается при завершении процесса, когда читателей уже нет
+EpochReclamation::~EpochReclamation() {
+    std::lock_guard lock(retire_mutex_);
+    Reclaim(true);
+}
+
+}  // namespace util
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Освобождение памяти по эпохам (EBR) для структур с чтением без блокировок.
+// Читатель объявляет эпоху на время обращения (Guard), писатель после отсоединения объекта
+// передаёт его удаление в Retire. Объект удаляется, когда глобальная эпоха ушла на два шага вперёд:
+// к этому моменту все читатели, которые могли его видеть, уже вышли из своих секций
+class EpochReclamation {
+    EpochReclamation(const EpochReclamation&) = delete;
+    EpochReclamation& operator=(const EpochReclamation&) = delete;
+
+public:
+    static EpochReclamation& Instance();
+
+    // Секция чтения. Вход и выход - по одной записи в слот потока, без ожидания других потоков.
+    // Вложенные секции допустимы, эпоху объявляет только внешняя
+    class Guard {
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    public:
+        Guard();
+        ~Guard();
+    };
+
+    // Вызывается после того, как объект стал недоступен новым читателям
+    void Retire(std::function<void()> deleter);
+
+    ~EpochReclamation();
+
+private:
+    EpochReclamation() = default;
+
+    friend class Guard;
+
+    constexpr static uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+    constexpr static size_t MAX_THREADS = 512;
+    // Отложенные удаления копятся пачкой, чтобы не обходить слоты потоков на каждое удаление
+    constexpr static size_t RECLAIM_BATCH = 32;
+
+    struct alignas(64) ThreadSlot {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> in_use{false};
+    };
+
+    struct ThreadState;
+    static ThreadState& LocalState();
+
+    ThreadSlot& AcquireSlot();
+    void ReleaseSlot(ThreadSlot& slot);
+    bool TryAdvance();
+    void Reclaim(bool force);
+
+    ThreadSlot slots_[MAX_THREADS];
+    std::atomic<size_t> slots_high_water_{0};
+    std::atomic<uint64_t> global_epoch_{0};
+
+    std::mutex retire_mutex_;
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+
+}  // namespace util
@@ -1,10 +1,23 @@
 #pragma once
 
+#include "bots.h"
+#include "journal.h"
 #include "json_loader.h"
+#include "map_cache.h"
+#include "memory_stats.h"
 #include "model_game.h"
+#include "records_store.h"
+#include "sharding.h"
+#include "state_persistence.h"
 
 #include <boost/asio/io_context.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+
 
 namespace net = boost::asio;
 namespace fs = std::filesystem;
@@ -19,10 +32,12 @@ class GameServer {
     GameServer& operator=(GameServer&&) = delete;
 
 public:
-    GameServer(net::io_context& ioc, fs::path config, fs::path root) :
+    GameServer(net::io_context& ioc, fs::path config, fs::path root, fs::path records_file = {}) :
         ioc_(ioc),
-        root_dir_(root) {
+        root_dir_(root),
+        records_(records_file) {
             game_ = json_loader::LoadGame(config);
+            map_cache_ = std::make_unique<serialization::MapCache>(game_.GetMaps());
             //game_.PrintMaps();
         }
 
@@ -38,42 +53,116 @@ public:
         return game_.GetMaps();
     }
 
+    // Тела ответов с картами строятся на threads потоках (0 - по числу ядер), пока сервер уже принимает запросы
+    void StartMapRendering(unsigned threads, serialization::MapCache::ReadyHandler on_ready = {}) {
+        map_cache_->Start(threads, std::move(on_ready));
+    }
+
+    // Безопасно вызывать вне strand игры: карты не меняются
+    const std::string& GetMapBody(const model::Map& map, bool cbor) {
+        return map_cache_->GetMap(map, cbor);
+    }
+
+    const std::string& GetMapsListBody(bool cbor) {
+        return map_cache_->GetMapsList(cbor);
+    }
+
+    // true - тело ещё строится на другом потоке, fn будет вызвана на нём, когда оно будет готово
+    bool WhenMapBodyReady(const model::Map& map, bool cbor, std::function<void()> fn) {
+        return map_cache_->WhenMapReady(map, cbor, std::move(fn));
+    }
+
+    bool WhenMapsListBodyReady(bool cbor, std::function<void()> fn) {
+        return map_cache_->WhenMapsListReady(cbor, std::move(fn));
+    }
+
+    // За game_router процесс обслуживает только карты, которые sharding::MapShard отдаёт его шарду
+    void SetShard(unsigned shard_id, unsigned shard_count) {
+        shard_id_ = shard_id;
+        shard_count_ = shard_count;
+    }
+
+    bool OwnsMap(const model::Map::Id& id) const {
+        return sharding::MapShard(*id, shard_count_) == shard_id_;
+    }
+
+    // Seed точек появления. Без вызова генератор засевается из std::random_device
+    void SetRandomSeed(uint64_t seed) {
+        spawn_random_ = auxillary::FastRandom(seed);
+    }
+
     /*model::Player&*/std::shared_ptr<model::Player> JoinGame(model::Map::Id id, const std::string& player_name) {
+        if (!OwnsMap(id)) {
+            throw std::invalid_argument("Map "s + *id + " is served by another shard"s);
+        }
+        // Отдельный seed на каждый вход: по журналу точка появления повторяется независимо от потока.
+        // Генератор принадлежит серверу и берётся на strand игры, поэтому с --random-seed
+        // последовательность входов одна и та же, на каком бы потоке ввода-вывода ни пришёл запрос
+        return JoinGame(std::move(id), player_name, spawn_random_.Next(), spawn_dog_random);
+    }
+
+    std::shared_ptr<model::Player> JoinGame(model::Map::Id id, const std::string& player_name, uint64_t spawn_seed, bool random_spawn) {
         auto session = game_.GetGameSession(id);
         if (!session) {
             throw std::runtime_error("Failed to create game session...");
         }
         //model::ParamPairDouble dog_start_position = game_.FindMap(id)->GetRandomDogPosition();
         //std::cout << "Random dog position: " << dog_start_position.x_ << ", " << dog_start_position.y_ << std::endl;
-        auto player = player_list_.AddPlayer(player_name, session/*, dog_start_position*/);
+        auto player = player_list_.MakePlayer(player_name, session/*, dog_start_position*/);
         auto dog = player->GetDog();
         //dog->SetDefaultSpeed(session->GetMap().GetMapDogSpeed());
-        session->AddDog(dog, spawn_dog_random);
+        auxillary::FastRandom spawn_random(spawn_seed);
+        session->AddDog(dog, random_spawn, spawn_random);
+        // Токен становится действительным только после того, как собака появилась в сессии
+        player_list_.PublishPlayer(player);
+        if (journal_) {
+            journal_->Append(journal::JoinEvent{*id, player_name, spawn_seed, random_spawn, static_cast<uint64_t>(dog->GetId())});
+        }
+        if (wal_) {
+            wal_->Append(persistence::JoinRecord{MakePlayerState(*player)});
+        }
         //std::cout << "Game dog speed " << game_.GetDefaultDogSpeed() << std::endl;
         //std::cout << "Map dog speed " << game_.FindMap(id)->GetMapDogSpeed() << std::endl;
         return player;
     }
 
-    std::shared_ptr<const model::Player> FindPlayer(const model::Token& token) {
+    // Безопасно вызывать вне strand игры
+    std::shared_ptr<const model::Player> FindPlayer(const model::Token& token) const {
         return player_list_.FindPlayer(token);
     }
 
-    const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher>& GetPlayers() const noexcept {
-        return player_list_.GetPlayersList();
+    const model::PlayerList& GetPlayers() const noexcept {
+        return player_list_;
+    }
+
+    std::vector<records::Record> GetRecords(size_t start, size_t max_items) const {
+        return records_.GetRecords(start, max_items);
+    }
+
+    // Действие применяется в начале следующего тика или перед чтением состояния сессии
+    void SetPlayerDirection(const model::Player& player, std::string dir) {
+        player.GetPlayersSession()->EnqueueAction(player.GetDog(), std::move(dir));
+    }
+
+    void ApplyPendingActions(const model::Player& player) {
+        player.GetPlayersSession()->ApplyPendingActions();
     }
 
     void Tick(std::chrono::milliseconds delta) {
-        game_.UpdateGame(delta.count()/1000.);
+        AdvanceGame(delta.count()/1000.);
+    }
+
+    void Tick(double dt_seconds) {
+        AdvanceGame(dt_seconds);
     }
 
     void UpdateGames() {
-        game_.UpdateGame(tick_);
+        AdvanceGame(tick_);
     }
 
     void SetGameServerTick(const double tick) {
         tick_ = tick;
-        std::cout << "game server tick is set to " << tick_;
-        //UpdateGames();
+        UpdateGames();
     }
 
     void SetAutoTicker() {
@@ -88,14 +177,352 @@ public:
         return auto_ticker_;
     }
 
+    // Все события, меняющие состояние, с этого момента пишутся в журнал
+    // Журнал пишется с начала работы процесса: игроки, восстановленные из снимка и WAL, в нём
+    // не записаны, и воспроизведение споткнулось бы на их действиях. Поэтому вместе с
+    // EnableStatePersistence журнал не включается
+    void EnableJournal(const fs::path& path) {
+        if (wal_) {
+            throw std::logic_error("Journal cannot be combined with state persistence");
+        }
+        journal_ = std::make_unique<journal::JournalWriter>(path);
+        game_.SetActionObserver([journal = journal_.get()](const model::Dog& dog, const std::string& dir) {
+            journal->Append(journal::ActionEvent{static_cast<uint64_t>(dog.GetId()), dir});
+        });
+    }
+
+    void FlushJournal() {
+        if (journal_) {
+            journal_->Flush();
+        }
+    }
+
+    // Запускает ботов по настройкам карт. threads - потоки, считающие решения ботов, 0 - по числу ядер
+    void StartBots(unsigned threads) {
+        const auto& maps = game_.GetMaps();
+        // Боты чужой карты создали бы на этом шарде её вторую сессию
+        auto has_bots = [this](const model::Map& map) {
+            return map.GetBotsConfig().count > 0 && OwnsMap(map.GetId());
+        };
+        if (std::none_of(maps.begin(), maps.end(), has_bots)) {
+            return;
+        }
+        bots_ = std::make_unique<bots::BotController>(threads);
+        for (const model::Map& map : maps) {
+            if (has_bots(map)) {
+                bots_->AddBots(game_.GetGameSession(map.GetId()), map.GetBotsConfig());
+            }
+        }
+    }
+
+    size_t GetBotCount() const noexcept {
+        return bots_ ? bots_->Size() : 0;
+    }
+
+    // /state отдаёт только собак в радиусе radius от собаки игрока. 0 - всю сессию
+    void SetStateRadius(double radius) {
+        state_radius_ = radius;
+        // Ячейка не меньше радиуса с гистерезисом: выборка затрагивает не больше 3x3 ячеек
+        game_.SetInterestCellSize(radius * (1. + model::GameSession::INTEREST_HYSTERESIS));
+    }
+
+    void CollectVisibleDogs(const model::Player& player, std::vector<const model::Dog*>& out) {
+        player.GetPlayersSession()->CollectVisibleDogs(*player.GetDog(), state_radius_, out);
+    }
+
+    // Версии для ETag ответов /state и /players. Версии начинаются заново при каждом запуске,
+    // поэтому в тег входит ещё и случайный номер запуска
+    uint64_t GetInstanceId() const noexcept {
+        return instance_id_;
+    }
+
+    uint64_t GetStateVersion(const model::Player& player) const {
+        return player.GetPlayersSession()->GetStateVersion();
+    }
+
+    uint64_t GetPlayersVersion() const {
+        return player_list_.GetVersion();
+    }
+
+    // Размеры тел прошлых ответов: HEAD при неизменном состоянии отвечает без сериализации
+    std::optional<size_t> GetCachedStateSize(const model::Player& player, bool cbor) const {
+        return player.GetPlayersSession()->GetCachedStateSize(*player.GetDog(), cbor);
+    }
+
+    void CacheStateSize(const model::Player& player, bool cbor, size_t bytes) {
+        player.GetPlayersSession()->CacheStateSize(*player.GetDog(), cbor, bytes);
+    }
+
+    std::optional<size_t> GetCachedPlayersListSize() const {
+        if (players_list_size_.first != player_list_.GetVersion()) {
+            return std::nullopt;
+        }
+        return players_list_size_.second;
+    }
+
+    void CachePlayersListSize(size_t bytes) {
+        players_list_size_ = {player_list_.GetVersion(), bytes};
+    }
+
+    // Пустой токен отключает служебные запросы /api/v1/admin/*
+    void SetAdminToken(std::string token) {
+        admin_token_ = std::move(token);
+    }
+
+    bool AdminEnabled() const noexcept {
+        return !admin_token_.empty();
+    }
+
+    bool IsAdminToken(std::string_view token) const noexcept {
+        return AdminEnabled() && token == admin_token_;
+    }
+
+    // Память по подсистемам: карты, сессии, игроки, соединения и сведения аллокатора.
+    // Обходит всех собак и игроков, вызывать на strand игры
+    memory::Report GetMemoryReport() const {
+        memory::Report report;
+        for (const model::Map& map : game_.GetMaps()) {
+            report.maps.push_back({*map.GetId(), map.MemoryUsage() + map_cache_->MemoryUsage(map)});
+        }
+        for (const auto& session : game_.GetGameSessions()) {
+            report.sessions.push_back({*session->GetMap().GetId(), session->GetDogs().size(), session->MemoryUsage()});
+        }
+        report.players = player_list_.Size();
+        report.players_bytes = player_list_.MemoryUsage();
+        memory::AddServerMemory(report);
+        return report;
+    }
+
+    // Загружает снимок и хвост WAL из прошлого запуска, затем пишет в WAL каждый вход и уход на покой.
+    // Снимок сохраняется раз в save_period игрового времени, WAL лежит рядом с ним с суффиксом .wal.
+    // on_failure вызывается на потоке WAL, если состояние больше не удаётся записать
+    void EnableStatePersistence(const fs::path& state_file, std::chrono::milliseconds save_period, std::chrono::milliseconds sync_interval,
+                                std::function<void()> on_failure = {}) {
+        if (journal_) {
+            throw std::logic_error("State persistence cannot be combined with a journal");
+        }
+        fs::path wal_file = state_file;
+        wal_file += ".wal";
+        uint64_t snapshot_lsn = 0;
+        if (auto snapshot = persistence::LoadSnapshot(state_file)) {
+            for (const auto& session : snapshot->sessions) {
+                GetSession(session.map_id)->RestoreSessionTime(session.session_time);
+            }
+            for (const auto& player : snapshot->players) {
+                RestorePlayer(player);
+            }
+            snapshot_lsn = snapshot->lsn;
+        }
+        const persistence::WalTail tail = persistence::ReadWal(wal_file, snapshot_lsn, [this](const persistence::WalRecord& record) {
+            if (auto* join = std::get_if<persistence::JoinRecord>(&record)) {
+                RestorePlayer(join->player);
+            } else if (auto player = player_list_.RemovePlayer(model::Token{std::get<persistence::RetireRecord>(record).token})) {
+                player->GetPlayersSession()->DropDog(*player->GetDog());
+            }
+        });
+        wal_ = std::make_unique<persistence::WalWriter>(wal_file, state_file, tail, sync_interval, std::move(on_failure));
+        save_period_ = save_period.count() / 1000.;
+        // Восстановленное состояние сразу фиксируется снимком, а WAL начинается заново
+        SaveState();
+    }
+
+    // На strand игры только копируется изменяемое состояние собак. Игроки после публикации
+    // не меняются и передаются по указателю, строки и кодирование снимка - на потоке WAL
+    void SaveState() {
+        if (!wal_) {
+            return;
+        }
+        wal_->Checkpoint([raw = CopyRawState(), lsn = wal_->LastLsn()] {
+            persistence::Snapshot snapshot;
+            snapshot.lsn = lsn;
+            snapshot.sessions = raw.sessions;
+            snapshot.players.reserve(raw.dogs.size());
+            for (const RawDog& dog : raw.dogs) {
+                snapshot.players.push_back(MakePlayerState(*dog.player, dog.state));
+            }
+            return persistence::EncodeSnapshot(snapshot);
+        });
+        since_save_ = 0.;
+    }
+
+    // fn(true) вызывается, когда все уже принятые входы записаны на диск, fn(false) - если WAL
+    // сломался и записать их не удастся. Без WAL - сразу. Может быть вызвана на потоке WAL
+    void WhenDurable(std::function<void(bool durable)> fn) {
+        if (wal_) {
+            wal_->WhenDurable(std::move(fn));
+        } else {
+            fn(true);
+        }
+    }
+
+    bool StateLost() const {
+        return wal_ && wal_->Failed();
+    }
+
+    void FlushState() {
+        if (wal_) {
+            wal_->Flush();
+        }
+    }
+
+    // Сохраняет снимок и дожидается записи WAL, журнала и рекордов. Вызывать после остановки потоков
+    void Shutdown() {
+        SaveState();
+        FlushState();
+        FlushJournal();
+        records_.Flush();
+    }
+
+    // Отпечаток состояния всех сессий и ушедших на покой собак для сравнения прогонов журнала.
+    // Собаки перебираются в порядке входа, сами id в отпечаток не входят: счётчик id общий на процесс.
+    // Боты не журналируются и при воспроизведении не запускаются, поэтому в отпечаток не входят
+    uint64_t StateHash() const {
+        uint64_t hash = retired_hash_;
+        for (const auto& session : game_.GetGameSessions()) {
+            HashBytes(hash, *session->GetMap().GetId());
+            std::vector<const model::Dog*> dogs;
+            dogs.reserve(session->GetDogs().size());
+            for (const auto& dog : session->GetDogs()) {
+                if (!bots_ || !bots_->IsBot(*dog)) {
+                    dogs.push_back(dog.get());
+                }
+            }
+            std::sort(dogs.begin(), dogs.end(), [](const model::Dog* l, const model::Dog* r) {
+                return l->GetId() < r->GetId();
+            });
+            for (const model::Dog* dog : dogs) {
+                HashValue(hash, dog->GetDogPosition().x_);
+                HashValue(hash, dog->GetDogPosition().y_);
+                HashValue(hash, dog->GetDogSpeed().x_);
+                HashValue(hash, dog->GetDogSpeed().y_);
+                HashBytes(hash, dog->GetDogDirection());
+                HashValue(hash, dog->GetScore());
+            }
+        }
+        return hash;
+    }
+
 private:
+    void AdvanceGame(double dt) {
+        if (bots_) {
+            bots_->Update(dt);
+        }
+        // Действия применяются до записи тика, чтобы в журнале они стояли перед ним
+        game_.ApplyPendingActions();
+        if (journal_) {
+            journal_->Append(journal::TickEvent{dt});
+        }
+        std::vector<records::Record> retired_records;
+        for (const auto& retired : game_.UpdateGame(dt)) {
+            if (bots_ && bots_->Respawn(*retired.dog)) {
+                continue;
+            }
+            HashValue(retired_hash_, retired.dog->GetScore());
+            HashValue(retired_hash_, retired.play_time);
+            if (auto player = player_list_.RemovePlayer(retired.dog->GetToken())) {
+                retired_records.push_back({player->GetName(), retired.dog->GetScore(), retired.play_time});
+                if (wal_) {
+                    wal_->Append(persistence::RetireRecord{*player->GetPlayerToken()});
+                }
+            }
+        }
+        // Запись на диск выполняет поток хранилища, здесь только постановка в очередь
+        records_.Add(std::move(retired_records));
+        since_save_ += dt;
+        if (save_period_ > 0. && since_save_ >= save_period_) {
+            SaveState();
+        }
+    }
+
+    std::shared_ptr<model::GameSession> GetSession(const std::string& map_id) {
+        auto session = game_.GetGameSession(model::Map::Id{map_id});
+        if (!session) {
+            throw std::runtime_error("Saved state refers to unknown map "s + map_id);
+        }
+        return session;
+    }
+
+    void RestorePlayer(const persistence::PlayerState& state) {
+        auto session = GetSession(state.map_id);
+        auto player = std::make_shared<model::Player>(model::Token{state.token}, state.name, session, state.player_id);
+        session->RestoreDog(player->GetDog(), state.dog);
+        player_list_.PublishPlayer(player);
+    }
+
+    static model::DogState CopyDogState(const model::Dog& dog) {
+        return {dog.GetDogPosition(), dog.GetDogSpeed(), dog.GetDogDirection(), dog.GetScore(), dog.GetJoinTime(), dog.GetLastActiveTime()};
+    }
+
+    static persistence::PlayerState MakePlayerState(const model::Player& player, model::DogState dog) {
+        return {*player.GetPlayerToken(), player.GetName(), player.GetId(), *player.GetPlayersSession()->GetMap().GetId(), std::move(dog)};
+    }
+
+    static persistence::PlayerState MakePlayerState(const model::Player& player) {
+        return MakePlayerState(player, CopyDogState(*player.GetDog()));
+    }
+
+    struct RawDog {
+        std::shared_ptr<const model::Player> player;
+        model::DogState state;
+    };
+
+    struct RawState {
+        std::vector<persistence::SessionState> sessions;
+        // Внутри сессии - в порядке активности собак, как в очереди простоя
+        std::vector<RawDog> dogs;
+    };
+
+    RawState CopyRawState() const {
+        RawState raw;
+        for (const auto& session : game_.GetGameSessions()) {
+            raw.sessions.push_back({*session->GetMap().GetId(), session->GetSessionTime()});
+            session->ForEachDogByActivity([this, &raw](const model::Dog& dog) {
+                if (auto player = player_list_.FindPlayer(dog.GetToken())) {
+                    raw.dogs.push_back({std::move(player), CopyDogState(dog)});
+                }
+            });
+        }
+        return raw;
+    }
+
+    // FNV-1a: отпечаток не зависит от реализации std::hash
+    constexpr static uint64_t HASH_OFFSET = 0xcbf29ce484222325ull;
+
+    static void HashBytes(uint64_t& hash, std::string_view bytes) {
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * 0x100000001b3ull;
+        }
+    }
+
+    template <typename T>
+    static void HashValue(uint64_t& hash, const T& value) {
+        HashBytes(hash, std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)));
+    }
+
     net::io_context& ioc_;
     const fs::path root_dir_;
     model::Game game_;
+    std::unique_ptr<serialization::MapCache> map_cache_;
     model::PlayerList player_list_;
+    records::RecordsStore records_;
+    std::unique_ptr<journal::JournalWriter> journal_;
+    std::unique_ptr<persistence::WalWriter> wal_;
+    std::unique_ptr<bots::BotController> bots_;
+    // Период сохранения снимка и игровое время с последнего сохранения, в секундах
+    double save_period_ = 0.;
+    double since_save_ = 0.;
+    uint64_t retired_hash_ = HASH_OFFSET;
 
     bool spawn_dog_random = false;
     bool auto_ticker_ = false;
     double tick_ = 0.1;
+    double state_radius_ = 0.;
+    unsigned shard_id_ = 0;
+    auxillary::FastRandom spawn_random_{static_cast<uint64_t>(std::random_device{}()) << 32 | std::random_device{}()};
+    unsigned shard_count_ = 1;
+    std::string admin_token_;
+    const uint64_t instance_id_ = std::random_device{}() * 0x100000000ull + std::random_device{}();
+    // Версия списка игроков, при которой запомнен размер тела /players, и сам размер
+    std::pair<uint64_t, size_t> players_list_size_{std::numeric_limits<uint64_t>::max(), 0};
 
 };
\ No newline at end of file
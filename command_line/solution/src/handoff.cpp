@@ -0,0 +1,189 @@
+#include "handoff.h"
+#include "logger.h"
+
+#include <boost/asio/write.hpp>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace handoff {
+
+using namespace std::literals;
+
+namespace {
+
+// Больше сокетов не бывает: по одному на ядро в режиме per-core
+constexpr size_t MAX_LISTENERS = 256;
+constexpr char LISTENERS_MARK = 'L';
+constexpr char EXITED_MARK = 'D';
+
+sockaddr_un MakeAddress(const std::filesystem::path& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const std::string& native = path.native();
+    if (native.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Handoff socket path is too long: "s + native);
+    }
+    std::memcpy(addr.sun_path, native.c_str(), native.size() + 1);
+    return addr;
+}
+
+void SendListeners(int fd, const std::vector<int>& listeners) {
+    if (listeners.size() > MAX_LISTENERS) {
+        throw std::runtime_error("Too many listening sockets to hand off");
+    }
+    char mark = LISTENERS_MARK;
+    iovec iov{&mark, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * MAX_LISTENERS));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * listeners.size());
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * listeners.size());
+    std::memcpy(CMSG_DATA(cmsg), listeners.data(), sizeof(int) * listeners.size());
+    while (::sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "Failed to hand off listening sockets");
+        }
+    }
+}
+
+}  // namespace
+
+std::optional<Predecessor> Predecessor::Connect(const std::filesystem::path& path) {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create handoff socket");
+    }
+    const sockaddr_un addr = MakeAddress(path);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        const int err = errno;
+        ::close(fd);
+        // Файла нет или он остался от упавшего процесса
+        if (err == ENOENT || err == ECONNREFUSED) {
+            return std::nullopt;
+        }
+        throw std::system_error(err, std::generic_category(), "Failed to connect to handoff socket "s + path.string());
+    }
+    return Predecessor(fd);
+}
+
+Predecessor::Predecessor(Predecessor&& other) noexcept :
+    fd_(std::exchange(other.fd_, -1)) {
+}
+
+Predecessor::~Predecessor() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::vector<int> Predecessor::TakeListeners() {
+    char mark = 0;
+    iovec iov{&mark, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * MAX_LISTENERS));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    ssize_t received;
+    while ((received = ::recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "Failed to receive listening sockets");
+        }
+    }
+    if (received != 1 || mark != LISTENERS_MARK) {
+        throw std::runtime_error("Unexpected handoff message");
+    }
+
+    std::vector<int> listeners;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const size_t first = listeners.size();
+            listeners.resize(first + count);
+            std::memcpy(listeners.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+        }
+    }
+    return listeners;
+}
+
+bool Predecessor::WaitForExit(std::chrono::milliseconds timeout) {
+    pollfd pfd{fd_, POLLIN, 0};
+    int ready;
+    while ((ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()))) < 0 && errno == EINTR) {
+    }
+    if (ready <= 0) {
+        return false;
+    }
+    // Закрытое без отметки соединение значит, что старый процесс упал: ждать больше нечего
+    char mark = 0;
+    return ::read(fd_, &mark, 1) == 1 && mark == EXITED_MARK;
+}
+
+HandoffServer::HandoffServer(net::io_context& ioc, std::filesystem::path path, ListenersProvider listeners, Handler on_handoff) :
+    acceptor_(ioc),
+    listeners_(std::move(listeners)),
+    on_handoff_(std::move(on_handoff)) {
+    // Файл либо остался от упавшего процесса, либо принадлежит предшественнику, который уже отдал сокеты
+    ::unlink(path.c_str());
+    acceptor_.open();
+    acceptor_.bind(net::local::stream_protocol::endpoint(path.string()));
+    acceptor_.listen();
+    DoAccept();
+}
+
+void HandoffServer::DoAccept() {
+    acceptor_.async_accept([this](boost::system::error_code ec, net::local::stream_protocol::socket socket) {
+        if (ec) {
+            if (ec != net::error::operation_aborted) {
+                logger::LogError(ec, "handoff accept"sv);
+            }
+            return;
+        }
+        const std::vector<int> listeners = listeners_();
+        try {
+            SendListeners(socket.native_handle(), listeners);
+        } catch (const std::exception& ex) {
+            // Новый процесс не получил сокеты: этот продолжает работать
+            logger::LogError(ex);
+            return DoAccept();
+        }
+        boost::json::object add_data;
+        add_data["listeners"] = listeners.size();
+        logger::LogMessageInfo(add_data, "listening sockets handed off"s);
+        successor_ = std::move(socket);
+        Close();
+        on_handoff_();
+    });
+}
+
+void HandoffServer::Close() {
+    boost::system::error_code ignored;
+    acceptor_.close(ignored);
+}
+
+void HandoffServer::NotifyExited() {
+    if (!successor_) {
+        return;
+    }
+    boost::system::error_code ignored;
+    const char mark = EXITED_MARK;
+    net::write(*successor_, net::buffer(&mark, 1), ignored);
+    successor_->close(ignored);
+}
+
+}  // namespace handoff
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// Перезапуск без потери соединений: работающий процесс передаёт новому слушающие сокеты
+// через unix-сокет (SCM_RIGHTS), после чего плавно останавливается
+namespace handoff {
+
+namespace net = boost::asio;
+
+// Сторона нового процесса
+class Predecessor {
+public:
+    // nullopt, если по path никто не слушает: новый процесс стартует как обычно
+    static std::optional<Predecessor> Connect(const std::filesystem::path& path);
+
+    Predecessor(Predecessor&& other) noexcept;
+    Predecessor& operator=(Predecessor&&) = delete;
+    ~Predecessor();
+
+    // Слушающие сокеты старого процесса. Старый процесс сразу перестаёт принимать соединения,
+    // новые ждут в очереди сокета, пока их не примет новый процесс
+    std::vector<int> TakeListeners();
+
+    // Ждёт, пока старый процесс доработает и сохранит состояние. false - не дождались за timeout
+    bool WaitForExit(std::chrono::milliseconds timeout);
+
+private:
+    explicit Predecessor(int fd) :
+        fd_(fd) {}
+
+    int fd_;
+};
+
+// Сторона работающего процесса
+class HandoffServer {
+public:
+    using ListenersProvider = std::function<std::vector<int>()>;
+    using Handler = std::function<void()>;
+
+    // on_handoff вызывается на потоке io_context после передачи сокетов
+    HandoffServer(net::io_context& ioc, std::filesystem::path path, ListenersProvider listeners, Handler on_handoff);
+
+    // Больше не принимать запросов на передачу
+    void Close();
+
+    // Сообщает новому процессу, что этот процесс остановился и всё сохранил
+    void NotifyExited();
+
+private:
+    void DoAccept();
+
+    net::local::stream_protocol::acceptor acceptor_;
+    std::optional<net::local::stream_protocol::socket> successor_;
+    ListenersProvider listeners_;
+    Handler on_handoff_;
+};
+
+}  // namespace handoff
@@ -1,7 +1,11 @@
 #include "http_server.h"
 
 #include <boost/asio/dispatch.hpp>
-#include <iostream>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <array>
 
 namespace http_server {
 
@@ -10,16 +14,107 @@ namespace http_server {
         logger::LogError(ec, what_str);
     }
 
+    ServerControl& ServerControl::Instance() {
+        static ServerControl control;
+        return control;
+    }
+
+    void ServerControl::AddListener(std::shared_ptr<ListenerBase> listener) {
+        std::lock_guard lock(mutex_);
+        listeners_.push_back(std::move(listener));
+    }
+
+    std::vector<int> ServerControl::ListenerHandles() const {
+        std::lock_guard lock(mutex_);
+        std::vector<int> handles;
+        for (const auto& weak_listener : listeners_) {
+            if (auto listener = weak_listener.lock()) {
+                handles.push_back(listener->NativeHandle());
+            }
+        }
+        return handles;
+    }
+
+    void ServerControl::BeginDrain() {
+        std::lock_guard lock(mutex_);
+        if (draining_.exchange(true)) {
+            return;
+        }
+        for (const auto& weak_listener : listeners_) {
+            if (auto listener = weak_listener.lock()) {
+                listener->Stop();
+                listener->CloseIdleSessions();
+            }
+        }
+    }
+
+    ServerControl::MemoryStats ServerControl::GetMemoryStats() const {
+        const size_t sessions = ActiveSessions();
+        // Размер объекта подкласса с обработчиком неизвестен, берётся общая часть
+        return {sessions, sessions * sizeof(SessionBase) + buffer_bytes_.load(std::memory_order_relaxed)};
+    }
+
+    void SessionGroup::AddSession(std::weak_ptr<SessionBase> session) {
+        if (sessions_.size() >= compact_at_) {
+            std::erase_if(sessions_, [](const std::weak_ptr<SessionBase>& session) {
+                return session.expired();
+            });
+            compact_at_ = std::max(MIN_COMPACT_SIZE, sessions_.size() * 2);
+        }
+        sessions_.push_back(std::move(session));
+    }
+
+    void SessionGroup::CloseIdleSessions() {
+        for (const auto& weak_session : sessions_) {
+            if (auto session = weak_session.lock()) {
+                net::dispatch(session->GetExecutor(), [session] {
+                    session->CloseIfIdle();
+                });
+            }
+        }
+    }
+
     void SessionBase::Run() {
-        net::dispatch(stream_.get_executor(), beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
+        // Колесо вызывает обработчик в strand группы, а состояние сессии меняется в её strand
+        deadline_.SetHandler([weak_self = std::weak_ptr<SessionBase>(GetSharedThis())](uint64_t tag) {
+            if (auto self = weak_self.lock()) {
+                net::dispatch(self->GetExecutor(), [self, tag] {
+                    self->OnDeadline(tag);
+                });
+            }
+        });
+        // Сессия регистрируется в группе до первого чтения: обход при остановке, начатый позже,
+        // её уже увидит, а чтение, начатое после остановки, закроет соединение само
+        net::dispatch(group_->GetStrand(), [self = GetSharedThis()] {
+            self->group_->AddSession(self);
+            net::dispatch(self->GetExecutor(), [self] {
+                self->Read();
+            });
+        });
+    }
+
+    void SessionBase::Write(PrebuiltResponse&& response) {
+        struct PendingWrite {
+            PrebuiltResponse response;
+            std::string date_line;
+        };
+        auto pending = std::make_shared<PendingWrite>(PendingWrite{std::move(response), CachedDateLine()});
+        const PrebuiltBlock& block = *pending->response.block;
+        std::array<net::const_buffer, 3> buffers{net::buffer(block.head), net::buffer(pending->date_line), net::buffer(block.tail)};
+        SetDeadline(timeouts_.idle);
+        net::async_write(stream_, buffers, [pending, self = GetSharedThis()](beast::error_code ec, std::size_t bytes_written) {
+            self->OnWrite(pending->response.need_eof(), ec, bytes_written);
+        });
     }
 
     void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
         if (ec) {
+            CancelDeadline();
             return ReportError(ec, "write"sv);
         }
-        if (close) {
-            // Семантика ответа требует закрыть соединение
+        if (close || ServerControl::Instance().Draining()) {
+            // Семантика ответа требует закрыть соединение, либо сервер останавливается
+            CancelDeadline();
             return SessionBase::Close();
         }
         // Считываем следующий запрос
@@ -27,27 +122,122 @@ namespace http_server {
     }
 
     void SessionBase::Read() {
-        using namespace std::literals;
         // Очищаем запрос от прежнего значения (метод Read может быть вызван несколько раз)
-        request_ = {};
-        stream_.expires_after(30s);
-        // Считываем request_ из stream_, используя buffer_ для хранения считанных данных
-        http::async_read(stream_, buffer_, request_,
+        parser_.emplace();
+        if (buffer_.size() > 0) {
+            // Следующий запрос уже частично в буфере (pipelining)
+            return ReadHeader();
+        }
+        // Соединение, зарегистрированное после обхода его группы при остановке, сразу закрывается:
+        // регистрация и обход идут в strand группы, а draining_ выставлен до обхода
+        if (ServerControl::Instance().Draining()) {
+            CancelDeadline();
+            return SessionBase::Close();
+        }
+        // Ждём начала следующего запроса, пока не истечёт таймаут простоя
+        SetDeadline(timeouts_.idle);
+        idle_ = true;
+        stream_.socket().async_wait(tcp::socket::wait_read,
+                                    beast::bind_front_handler(&SessionBase::OnIdleWait, GetSharedThis()));
+    }
+
+    void SessionBase::CloseIfIdle() {
+        if (idle_) {
+            beast::error_code ignored;
+            stream_.socket().close(ignored);
+        }
+    }
+
+    void SessionBase::OnIdleWait(beast::error_code ec) {
+        idle_ = false;
+        if (ec) {
+            CancelDeadline();
+            if (!timed_out_ && !ServerControl::Instance().Draining()) {
+                ReportError(ec, "wait"sv);
+            }
+            // Истёк таймаут простоя keep-alive соединения - штатная ситуация
+            return;
+        }
+        ReadHeader();
+    }
+
+    void SessionBase::ReadHeader() {
+        SetDeadline(timeouts_.header_read);
+        http::async_read_header(stream_, buffer_, *parser_,
+                                beast::bind_front_handler(&SessionBase::OnReadHeader, GetSharedThis()));
+    }
+
+    void SessionBase::OnReadHeader(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        if (HandleReadError(ec)) {
+            return;
+        }
+        SetDeadline(timeouts_.body_read);
+        // Считываем тело запроса из stream_, используя buffer_ для хранения считанных данных
+        http::async_read(stream_, buffer_, *parser_,
                         // По окончании операции будет вызван метод OnRead
                         beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
     }
 
     void SessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
-        using namespace std::literals;
+        if (HandleReadError(ec)) {
+            return;
+        }
+        CancelDeadline();
+        AccountBuffer();
+        HandleRequest(parser_->release());
+    }
+
+    bool SessionBase::HandleReadError(beast::error_code ec) {
+        if (!ec) {
+            return false;
+        }
+        CancelDeadline();
         if (ec == http::error::end_of_stream) {
             // Нормальная ситуация - клиент закрыл соединение
-            return SessionBase::Close();
+            SessionBase::Close();
+            return true;
         }
-        if (ec) {
-            std::cout << "EC in OnRead" << std::endl;
-            return ReportError(ec, "read"sv);
+        if (timed_out_) {
+            ReportError(beast::error::timeout, "read"sv);
+            return true;
+        }
+        ReportError(ec, "read"sv);
+        return true;
+    }
+
+    void SessionBase::AccountBuffer() {
+        const size_t capacity = buffer_.capacity();
+        if (capacity != accounted_buffer_) {
+            auto& bytes = ServerControl::Instance().buffer_bytes_;
+            bytes.fetch_add(capacity, std::memory_order_relaxed);
+            bytes.fetch_sub(accounted_buffer_, std::memory_order_relaxed);
+            accounted_buffer_ = capacity;
+        }
+    }
+
+    // Колесо меняется только в strand группы. Задачи одной сессии приходят туда по порядку,
+    // а срабатывание уже переставленного дедлайна отсеивает проверка номера в OnDeadline
+    void SessionBase::SetDeadline(std::chrono::milliseconds timeout) {
+        net::post(group_->GetStrand(), [self = GetSharedThis(), timeout, tag = ++deadline_tag_] {
+            self->group_->GetWheel().Schedule(self->deadline_, timeout, tag);
+        });
+    }
+
+    void SessionBase::CancelDeadline() {
+        ++deadline_tag_;
+        net::post(group_->GetStrand(), [self = GetSharedThis()] {
+            self->group_->GetWheel().Cancel(self->deadline_);
+        });
+    }
+
+    void SessionBase::OnDeadline(uint64_t tag) {
+        if (tag != deadline_tag_) {
+            // Дедлайн уже переставлен или снят
+            return;
         }
-        HandleRequest(std::move(request_));
+        timed_out_ = true;
+        beast::error_code ignored;
+        stream_.socket().close(ignored);
     }
 
     void SessionBase::Close() {
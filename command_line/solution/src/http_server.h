@@ -3,14 +3,21 @@
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 
 #include "logger.h"
+#include "prebuilt_response.h"
+#include "timing_wheel.h"
 
+#include <atomic>
+#include <mutex>
+#include <optional>
 #include <variant>
+#include <vector>
 
 namespace http_server {
 
@@ -25,6 +32,110 @@ void ReportError(beast::error_code ec, std::string_view what);
 
 void ReportServerExit(int code, const std::exception* ex = nullptr);
 
+#ifdef SO_REUSEPORT
+// Позволяет нескольким акцепторам слушать один порт, ядро само распределяет соединения
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+// Таймауты соединения: ожидание следующего запроса, чтение заголовков и чтение тела
+struct Timeouts {
+    std::chrono::milliseconds idle = 30s;
+    std::chrono::milliseconds header_read = 30s;
+    std::chrono::milliseconds body_read = 30s;
+};
+
+class SessionBase;
+
+// Колесо таймаутов группы соединений и их список для плавной остановки. И то и другое меняется
+// только из strand группы, поэтому блокировок нет. Ввод-вывод каждого соединения идёт в его
+// собственном strand: медленный обработчик одного не задерживает остальные соединения группы
+class SessionGroup {
+public:
+    SessionGroup(net::io_context& ioc, std::chrono::milliseconds wheel_tick) :
+        wheel_(std::make_shared<TimingWheel>(ioc, wheel_tick)) {
+    }
+
+    void Start() {
+        wheel_->Start();
+    }
+
+    const TimingWheel::Strand& GetStrand() const noexcept {
+        return wheel_->GetStrand();
+    }
+
+    TimingWheel& GetWheel() noexcept {
+        return *wheel_;
+    }
+
+    // Дальше - только из strand группы
+    void AddSession(std::weak_ptr<SessionBase> session);
+    // Соединения в ожидании запроса закрываются (каждое в своём strand), остальные закроются после ответа
+    void CloseIdleSessions();
+
+private:
+    // Сессия может разрушиться вне strand (последнюю ссылку отпускает strand игры), поэтому
+    // из списка она не удаляется, а вычищается, когда список вырастает вдвое
+    constexpr static size_t MIN_COMPACT_SIZE = 64;
+
+    std::shared_ptr<TimingWheel> wheel_;
+    std::vector<std::weak_ptr<SessionBase>> sessions_;
+    size_t compact_at_ = MIN_COMPACT_SIZE;
+};
+
+class ListenerBase {
+public:
+    virtual ~ListenerBase() = default;
+
+    // Перестаёт принимать соединения. Копия сокета, переданная другому процессу, продолжает работать
+    virtual void Stop() = 0;
+    // Обходит группы соединений листенера, каждую в её strand
+    virtual void CloseIdleSessions() = 0;
+    virtual int NativeHandle() = 0;
+};
+
+// Листенеры и живые соединения процесса: нужны для плавной остановки и передачи сокетов
+class ServerControl {
+public:
+    static ServerControl& Instance();
+
+    void AddListener(std::shared_ptr<ListenerBase> listener);
+
+    // Слушающие сокеты для передачи новому процессу
+    std::vector<int> ListenerHandles() const;
+
+    // Листенеры перестают принимать соединения, соединения в ожидании запроса закрываются,
+    // остальные закрываются сразу после отправки текущего ответа
+    void BeginDrain();
+
+    bool Draining() const noexcept {
+        return draining_.load(std::memory_order_relaxed);
+    }
+
+    size_t ActiveSessions() const noexcept {
+        return active_sessions_.load(std::memory_order_relaxed);
+    }
+
+    // Память соединений: сами объекты и их буферы чтения
+    struct MemoryStats {
+        size_t sessions = 0;
+        size_t bytes = 0;
+    };
+
+    MemoryStats GetMemoryStats() const;
+
+private:
+    friend class SessionBase;
+
+    // Только листенеры: они добавляются при старте, соединения учитываются в своих SessionGroup
+    mutable std::mutex mutex_;
+    // Листенер живёт, пока ждёт соединение в своём io_context
+    std::vector<std::weak_ptr<ListenerBase>> listeners_;
+    std::atomic<bool> draining_{false};
+    std::atomic<size_t> active_sessions_{0};
+    // Сумма ёмкостей буферов чтения всех соединений
+    std::atomic<size_t> buffer_bytes_{0};
+};
+
 class SessionBase {
 
 public:
@@ -34,44 +145,98 @@ public:
     void Run();
 
 protected:
-    using ResponseVariant = std::variant<http::response<http::string_body>, http::response<http::file_body>>;
+    using ResponseVariant = std::variant<http::response<http::string_body>, http::response<http::file_body>, PrebuiltResponse>;
     using HttpRequest = http::request<http::string_body>;
 
-    explicit SessionBase(tcp::socket&& socket) :
-        stream_(std::move(socket)) {
+    // Сокет должен принадлежать собственному strand сессии
+    SessionBase(tcp::socket&& socket, std::shared_ptr<SessionGroup> group, const Timeouts& timeouts) :
+        stream_(std::move(socket)),
+        group_(std::move(group)),
+        timeouts_(timeouts) {
+        sys::error_code ec;
+        remote_address_ = stream_.socket().remote_endpoint(ec).address();
+        ServerControl::Instance().active_sessions_.fetch_add(1, std::memory_order_relaxed);
     }
 
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response) {
         auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
         auto self = GetSharedThis();
+        // Медленный клиент, не забирающий ответ, ограничен тем же таймаутом простоя
+        SetDeadline(timeouts_.idle);
         http::async_write(stream_, *safe_response, 
                             [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
                             self->OnWrite(safe_response->need_eof(), ec, bytes_written);
                           });
     }
 
+    // Готовый ответ пишется одним gather-вызовом: общий буфер заголовков, Date и общий буфер тела
+    void Write(PrebuiltResponse&& response);
+
     void Write(ResponseVariant&& response) {
         std::visit([this](auto&& resp) {
             Write(std::move(resp));
         }, std::move(response));
     }
 
-    ~SessionBase() = default;
+    ~SessionBase() {
+        // Пока дедлайн стоит, сессию держит ожидающая операция или задача в strand группы,
+        // так что обычно он уже снят. Стоять он может, только если io_context разрушается
+        // с незавершёнными операциями, а тогда потоки уже остановлены и колесо можно трогать вне его strand
+        group_->GetWheel().Cancel(deadline_);
+        ServerControl::Instance().active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+        ServerControl::Instance().buffer_bytes_.fetch_sub(accounted_buffer_, std::memory_order_relaxed);
+    }
+
+    beast::tcp_stream::executor_type GetExecutor() {
+        return stream_.get_executor();
+    }
+
+    const net::ip::address& GetRemoteAddress() const {
+        return remote_address_;
+    }
 
 private:
+    friend class SessionGroup;
+
+    // Вызывается при остановке сервера: соединение, ждущее следующего запроса, закрывается
+    void CloseIfIdle();
+
     void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
     void Read();
+    void OnIdleWait(beast::error_code ec);
+    void ReadHeader();
+    void OnReadHeader(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
     void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
+    bool HandleReadError(beast::error_code ec);
     void Close();
+    // Переносит изменение ёмкости buffer_ в общий счётчик ServerControl
+    void AccountBuffer();
+
+    void SetDeadline(std::chrono::milliseconds timeout);
+    void CancelDeadline();
+    void OnDeadline(uint64_t tag);
 
     // Обработку запроса делегируем подклассу
     virtual void HandleRequest(HttpRequest&& request) = 0;
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
     beast::tcp_stream stream_;
+    net::ip::address remote_address_;
     beast::flat_buffer buffer_;
-    HttpRequest request_;
+    std::optional<http::request_parser<http::string_body>> parser_;
+
+    std::shared_ptr<SessionGroup> group_;
+    // Меняется только в strand группы
+    TimingWheel::Entry deadline_;
+    // Номер текущего дедлайна: срабатывание устаревшего дедлайна игнорируется. Дальше - в strand сессии
+    uint64_t deadline_tag_ = 0;
+    bool timed_out_ = false;
+    // Соединение ждёт начала следующего запроса
+    bool idle_ = false;
+    const Timeouts timeouts_;
+
+    size_t accounted_buffer_ = 0;
 };
 
 template <typename RequestHandler>
@@ -79,15 +244,18 @@ class Session : public SessionBase, public std::enable_shared_from_this<Session<
 	// Напишите недостающий код, используя информацию из урока
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler, const std::string root_dir) :
-        SessionBase(std::move(socket)),
+    Session(tcp::socket&& socket, Handler&& request_handler, std::shared_ptr<SessionGroup> group, const Timeouts& timeouts) :
+        SessionBase(std::move(socket), std::move(group), timeouts),
         request_handler_(std::forward<Handler>(request_handler)) {
     }
 
 private:
     void HandleRequest(HttpRequest&& request) override {
-        request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-            self->Write(std::move(response));
+        request_handler_(std::move(request), GetRemoteAddress(), [self = this->shared_from_this()](auto&& response) {
+            // Ответ может быть сформирован на чужом ядре (strand игры), запись выполняем на executor сессии
+            net::dispatch(self->GetExecutor(), [self, response = std::move(response)]() mutable {
+                self->Write(std::move(response));
+            });
         });
     }
     std::shared_ptr<SessionBase> GetSharedThis() override {
@@ -97,24 +265,70 @@ private:
 };
 
 template <typename RequestHandler>
-class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
+class Listener : public ListenerBase, public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
+    // listen_fd >= 0 - уже слушающий сокет, полученный от предыдущего процесса
+    // io_threads - сколько потоков выполняют ioc: по группе соединений на поток
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint endpoint, Handler&& request_handler) :
+    Listener(net::io_context& ioc, const tcp::endpoint endpoint, Handler&& request_handler, bool reuse_port, const Timeouts& timeouts,
+             unsigned io_threads, int listen_fd = -1) :
         ioc_(ioc),
         acceptor_(net::make_strand(ioc)),
-        request_handler_(std::forward<Handler>(request_handler)) {
+        request_handler_(std::forward<Handler>(request_handler)),
+        timeouts_(timeouts) {
+            for (unsigned i = 0; i < std::max(1u, io_threads); ++i) {
+                groups_.push_back(std::make_shared<SessionGroup>(ioc, WHEEL_TICK));
+            }
+            if (listen_fd >= 0) {
+                acceptor_.assign(endpoint.protocol(), listen_fd);
+                return;
+            }
             acceptor_.open(endpoint.protocol());
             acceptor_.set_option(net::socket_base::reuse_address(true));
+            if (reuse_port) {
+#ifdef SO_REUSEPORT
+                acceptor_.set_option(http_server::reuse_port(true));
+#else
+                throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+            }
             acceptor_.bind(endpoint);
             acceptor_.listen(net::socket_base::max_listen_connections);
     }
 
     void Run() {
+        for (const auto& group : groups_) {
+            group->Start();
+        }
         DoAccept();
     }
+
+    void Stop() override {
+        net::dispatch(acceptor_.get_executor(), [self = this->shared_from_this()] {
+            sys::error_code ignored;
+            self->acceptor_.close(ignored);
+        });
+    }
+
+    void CloseIdleSessions() override {
+        for (const auto& group : groups_) {
+            net::dispatch(group->GetStrand(), [group] {
+                group->CloseIdleSessions();
+            });
+        }
+    }
+
+    int NativeHandle() override {
+        return acceptor_.native_handle();
+    }
+
 private:
+    // Точность срабатывания таймаутов соединений
+    constexpr static std::chrono::milliseconds WHEEL_TICK = 100ms;
+
+    // Сокет соединения получает собственный strand, а дедлайны - колесо группы, группы раздаются по кругу
     void DoAccept() {
+        next_group_ = (next_group_ + 1) % groups_.size();
         acceptor_.async_accept(
             net::make_strand(ioc_),
             beast::bind_front_handler(&Listener::OnAccept, this->shared_from_this()));
@@ -124,6 +338,9 @@ private:
         using namespace std::literals;
 
         if (ec) {
+            if (ec == net::error::operation_aborted && ServerControl::Instance().Draining()) {
+                return;
+            }
             return ReportError(ec, "accept"sv);
         }
         AsyncRunSession(std::move(socket));
@@ -132,20 +349,26 @@ private:
     }
 
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, root_directory_)->Run();
+        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, groups_[next_group_], timeouts_)->Run();
     }
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
-    std::string root_directory_;
+    // Колёса таймаутов: по одному на поток, чтобы дедлайны соединений не сходились в одном strand
+    std::vector<std::shared_ptr<SessionGroup>> groups_;
+    size_t next_group_ = 0;
+    Timeouts timeouts_;
 };
 
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, bool reuse_port = false, const Timeouts& timeouts = {},
+               unsigned io_threads = 1, int listen_fd = -1) {
     // Напишите недостающий код, используя информацию из урока
     using MyListener = Listener<std::decay_t<RequestHandler>>;
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    auto listener = std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), reuse_port, timeouts, io_threads, listen_fd);
+    ServerControl::Instance().AddListener(listener);
+    listener->Run();
 }
 
 }  // namespace http_server
@@ -0,0 +1,169 @@
+#include "journal.h"
+#include "binary_io.h"
+
+#include <stdexcept>
+
+namespace journal {
+
+using namespace std::literals;
+using namespace serialization;
+
+namespace {
+
+constexpr std::string_view SIGNATURE = "GSJ1"sv;
+
+enum class EventType : uint8_t {
+    JOIN = 1,
+    ACTION = 2,
+    TICK = 3,
+};
+
+// Пустое направление (остановка) кодируется нулём
+constexpr char STOP_DIR = 0;
+
+void PutDir(std::string& out, const std::string& dir) {
+    out.push_back(dir.empty() ? STOP_DIR : dir.front());
+}
+
+bool GetDir(std::istream& in, std::string& dir) {
+    const int byte = in.get();
+    if (byte == std::char_traits<char>::eof()) {
+        return false;
+    }
+    dir = byte == STOP_DIR ? ""s : std::string(1, static_cast<char>(byte));
+    return true;
+}
+
+struct Encoder {
+    std::string& out;
+
+    void operator()(const JoinEvent& event) const {
+        out.push_back(static_cast<char>(EventType::JOIN));
+        PutString(out, event.map_id);
+        PutString(out, event.user_name);
+        PutVarint(out, event.spawn_seed);
+        out.push_back(event.random_spawn ? 1 : 0);
+        PutVarint(out, event.dog_id);
+    }
+
+    void operator()(const ActionEvent& event) const {
+        out.push_back(static_cast<char>(EventType::ACTION));
+        PutVarint(out, event.dog_id);
+        PutDir(out, event.dir);
+    }
+
+    void operator()(const TickEvent& event) const {
+        out.push_back(static_cast<char>(EventType::TICK));
+        PutFixed(out, event.dt);
+    }
+};
+
+}  // namespace
+
+JournalWriter::JournalWriter(std::filesystem::path path) :
+    out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_.is_open()) {
+        throw std::runtime_error("Failed to open journal file: "s + path.string());
+    }
+    out_.write(SIGNATURE.data(), SIGNATURE.size());
+    writer_ = std::jthread([this](std::stop_token stop) {
+        WriterLoop(stop);
+    });
+}
+
+JournalWriter::~JournalWriter() {
+    // Поток допишет всё, что уже стоит в очереди, и завершится
+    writer_.request_stop();
+    writer_.join();
+}
+
+void JournalWriter::Append(const Event& event) {
+    {
+        std::lock_guard lock(queue_mutex_);
+        std::visit(Encoder{pending_}, event);
+        ++appended_;
+    }
+    queue_cv_.notify_one();
+}
+
+void JournalWriter::Flush() {
+    std::unique_lock lock(queue_mutex_);
+    const uint64_t target = appended_;
+    flushed_cv_.wait(lock, [this, target] {
+        return written_ >= target;
+    });
+}
+
+void JournalWriter::WriterLoop(std::stop_token stop) {
+    std::string batch;
+    while (true) {
+        uint64_t batch_mark;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_cv_.wait(lock, stop, [this] {
+                return !pending_.empty();
+            });
+            if (pending_.empty()) {
+                return;
+            }
+            // Буферы меняются местами, поэтому память под события не перевыделяется
+            batch.swap(pending_);
+            batch_mark = appended_;
+        }
+        out_.write(batch.data(), batch.size());
+        out_.flush();
+        batch.clear();
+        {
+            std::lock_guard lock(queue_mutex_);
+            written_ = batch_mark;
+        }
+        flushed_cv_.notify_all();
+    }
+}
+
+JournalReader::JournalReader(const std::filesystem::path& path) :
+    in_(path, std::ios::binary) {
+    if (!in_.is_open()) {
+        throw std::runtime_error("Failed to open journal file: "s + path.string());
+    }
+    std::string signature(SIGNATURE.size(), '\0');
+    if (!in_.read(signature.data(), signature.size()) || signature != SIGNATURE) {
+        throw std::runtime_error("Not a game journal: "s + path.string());
+    }
+}
+
+std::optional<Event> JournalReader::Next() {
+    const int type = in_.get();
+    if (type == std::char_traits<char>::eof()) {
+        return std::nullopt;
+    }
+    switch (static_cast<EventType>(type)) {
+        case EventType::JOIN: {
+            JoinEvent event;
+            const int random_spawn = (GetString(in_, event.map_id) && GetString(in_, event.user_name) &&
+                                      GetVarint(in_, event.spawn_seed)) ? in_.get() : std::char_traits<char>::eof();
+            if (random_spawn == std::char_traits<char>::eof() || !GetVarint(in_, event.dog_id)) {
+                return std::nullopt;
+            }
+            event.random_spawn = random_spawn != 0;
+            return event;
+        }
+        case EventType::ACTION: {
+            ActionEvent event;
+            if (!GetVarint(in_, event.dog_id) || !GetDir(in_, event.dir)) {
+                return std::nullopt;
+            }
+            return event;
+        }
+        case EventType::TICK: {
+            TickEvent event;
+            if (!GetFixed(in_, event.dt)) {
+                return std::nullopt;
+            }
+            return event;
+        }
+    }
+    throw std::runtime_error("Corrupted journal: unknown event type "s + std::to_string(type));
+}
+
+}  // namespace journal
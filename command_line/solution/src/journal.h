@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+
+// Журнал событий, меняющих состояние игры: вход игрока, применённое действие, тик.
+// По журналу режим --replay повторяет игру без сети и получает то же самое состояние
+namespace journal {
+
+struct JoinEvent {
+    std::string map_id;
+    std::string user_name;
+    // Seed генератора точки появления собаки
+    uint64_t spawn_seed = 0;
+    bool random_spawn = false;
+    // Id собаки в записавшем процессе: по нему на собаку ссылаются действия
+    uint64_t dog_id = 0;
+};
+
+struct ActionEvent {
+    uint64_t dog_id = 0;
+    std::string dir;
+};
+
+struct TickEvent {
+    double dt = 0.;
+};
+
+using Event = std::variant<JoinEvent, ActionEvent, TickEvent>;
+
+// Формат: сигнатура, затем записи "тип (1 байт) + поля". Целые и длины строк - varint,
+// направление - 1 байт, dt - 8 байт double в порядке байтов little-endian
+class JournalWriter {
+public:
+    explicit JournalWriter(std::filesystem::path path);
+    ~JournalWriter();
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // Только кодирует событие в буфер, на диск его пишет поток журнала
+    void Append(const Event& event);
+
+    // Дожидается, пока всё добавленное окажется в файле
+    void Flush();
+
+private:
+    void WriterLoop(std::stop_token stop);
+
+    std::ofstream out_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable_any queue_cv_;
+    std::condition_variable_any flushed_cv_;
+    std::string pending_;
+    uint64_t appended_ = 0;
+    uint64_t written_ = 0;
+
+    std::jthread writer_;
+};
+
+class JournalReader {
+public:
+    explicit JournalReader(const std::filesystem::path& path);
+
+    // nullopt в конце журнала. Недописанная при аварии последняя запись считается концом
+    std::optional<Event> Next();
+
+private:
+    std::ifstream in_;
+};
+
+}  // namespace journal
@@ -79,6 +79,24 @@ void AddOfficesToMap(const boost::json::value& parsed, model::Map& map) {
     }
 }
 
+model::BotsConfig ParseBotsConfig(const boost::json::object& bots) {
+    model::BotsConfig config;
+    config.count = static_cast<size_t>(bots.at("count").to_number<int64_t>());
+    if (bots.contains("behavior")) {
+        const auto& behavior = bots.at("behavior").as_string();
+        if (behavior == "randomWalk") {
+            config.behavior = model::BotBehavior::RANDOM_WALK;
+        } else if (behavior == "followRoads") {
+            config.behavior = model::BotBehavior::FOLLOW_ROADS;
+        } else if (behavior == "seekOffices") {
+            config.behavior = model::BotBehavior::SEEK_OFFICES;
+        } else {
+            throw std::invalid_argument("Unknown bots behavior: "s + behavior.c_str());
+        }
+    }
+    return config;
+}
+
 void AddMapsToGame (const boost::json::value& parsed, model::Game& game) {
     for (auto& map : parsed.as_array()) {
         model::Map::Id id{map.as_object().at("id").as_string().c_str()};
@@ -98,6 +116,9 @@ void AddMapsToGame (const boost::json::value& parsed, model::Game& game) {
             if (pair.key() == "dogSpeed") {
                 map_i.SetMapDogSpeed(pair.value().as_double());
             }
+            if (pair.key() == "bots") {
+                map_i.SetBotsConfig(ParseBotsConfig(pair.value().as_object()));
+            }
         }
         game.AddMap(map_i);
     }
@@ -124,6 +145,9 @@ model::Game LoadGame(const std::filesystem::path& json_path) {
         model::Game game;
 
         SetDogSpeedToGame(parsed_json.as_object(), game);
+        if (parsed_json.as_object().contains("dogRetirementTime")) {
+            game.SetDogRetirementTime(parsed_json.as_object().at("dogRetirementTime").to_number<double>());
+        }
         AddMapsToGame(parsed_json.as_object().at("maps").as_array(), game);
         
         return game;
@@ -0,0 +1,109 @@
+#include "json_writer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace serialization {
+
+namespace {
+
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+template <typename T>
+void AppendNumber(std::string& out, T value) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+}
+
+}  // namespace
+
+void JsonWriter::BeginObject() {
+    Separate();
+    out_.push_back('{');
+    need_comma_ = false;
+}
+
+void JsonWriter::EndObject() {
+    out_.push_back('}');
+    need_comma_ = true;
+}
+
+void JsonWriter::BeginArray() {
+    Separate();
+    out_.push_back('[');
+    need_comma_ = false;
+}
+
+void JsonWriter::EndArray() {
+    out_.push_back(']');
+    need_comma_ = true;
+}
+
+void JsonWriter::Key(std::string_view key) {
+    Separate();
+    out_.push_back('"');
+    out_.append(key);
+    out_.append("\":", 2);
+    need_comma_ = false;
+}
+
+void JsonWriter::Key(int64_t key) {
+    Separate();
+    out_.push_back('"');
+    AppendNumber(out_, key);
+    out_.append("\":", 2);
+    need_comma_ = false;
+}
+
+void JsonWriter::String(std::string_view value) {
+    Separate();
+    out_.push_back('"');
+    // Обычные символы копируются кусками между экранируемыми
+    size_t plain_start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        const unsigned char c = value[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out_.append(value.substr(plain_start, i - plain_start));
+        plain_start = i + 1;
+        switch (c) {
+            case '"': out_.append("\\\"", 2); break;
+            case '\\': out_.append("\\\\", 2); break;
+            case '\n': out_.append("\\n", 2); break;
+            case '\r': out_.append("\\r", 2); break;
+            case '\t': out_.append("\\t", 2); break;
+            default:
+                out_.append("\\u00", 4);
+                out_.push_back(HEX_DIGITS[c >> 4]);
+                out_.push_back(HEX_DIGITS[c & 0xF]);
+        }
+    }
+    out_.append(value.substr(plain_start));
+    out_.push_back('"');
+}
+
+void JsonWriter::Int(int64_t value) {
+    Separate();
+    AppendNumber(out_, value);
+}
+
+void JsonWriter::Double(double value) {
+    Separate();
+    if (!std::isfinite(value)) {
+        out_.append("null", 4);
+        return;
+    }
+    // Кратчайшее представление, которое читается обратно в то же самое число.
+    // Целое значение дополняется ".0", чтобы клиент прочитал его как дробное
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out_.append(buf, end);
+    if (std::find_if(buf, end, [](char c) { return c == '.' || c == 'e'; }) == end) {
+        out_.append(".0", 2);
+    }
+}
+
+}  // namespace serialization
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+// Потоковая запись JSON прямо в выходную строку, без промежуточного дерева boost::json.
+// Запятые расставляются автоматически, вложенность проверяет вызывающий
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) :
+        out_(out) {}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    // Ключи - константы протокола, экранирование им не нужно
+    void Key(std::string_view key);
+    void Key(int64_t key);
+
+    void String(std::string_view value);
+    void Int(int64_t value);
+    void Double(double value);
+
+private:
+    void Separate() {
+        if (need_comma_) {
+            out_.push_back(',');
+        }
+        need_comma_ = true;
+    }
+
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+}  // namespace serialization
@@ -36,6 +36,7 @@ void LogExit(const int code, const std::exception* ex) {
         add_data["exception"] = what_str;
     }
     BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "server exited";
+    logging::core::get()->flush();
 }
 
 void LogMessageInfo (const boost::json::value& add_data, const std::string message) {
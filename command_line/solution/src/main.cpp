@@ -1,12 +1,18 @@
 #include <boost/asio/signal_set.hpp>
 #include <boost/asio/io_context.hpp>
 
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <thread>
 
 //#include "aux.h"
 //#include "logger.h"
 //#include "game_server.h"
+#include "handoff.h"
+#include "placement.h"
+#include "replay.h"
 #include "request_handler.h"
 #include "ticker.h"
 #include "command_line_parser.h"
@@ -18,15 +24,107 @@ namespace fs = std::filesystem;
 
 namespace {
 
+// fn(номер потока) на n потоках, нулевой - вызывающий
 template <typename Fn>
 void RunWorkers(unsigned n, const Fn& fn) {
     n = std::max(1u, n);
     std::vector<std::jthread> workers;
     workers.reserve(n-1);
-    while (--n) {
-        workers.emplace_back(fn);
+    for (unsigned index = 1; index < n; ++index) {
+        workers.emplace_back(fn, index);
     }
-    fn();
+    fn(0u);
+}
+
+// Режим per-core: у каждого ядра свой io_context и свой поток, привязанный к этому ядру
+void RunPerCoreWorkers(std::vector<std::unique_ptr<net::io_context>>& contexts, const std::vector<unsigned>& cpus) {
+    RunWorkers(contexts.size(), [&contexts, &cpus](unsigned index) {
+        placement::PinThreadToCpu(cpus[index]);
+        memory::BindThreadArena();
+        contexts[index]->run();
+    });
+}
+
+// Прогон журнала без сети: проверка воспроизводимости (state_hash) и замер чистой симуляции
+void RunReplay(const fs::path& config, const Args& args) {
+    net::io_context ioc;
+    GameServer gs(ioc, config, {});
+    const journal::ReplayStats stats = journal::Replay(gs, fs::weakly_canonical(fs::path(args.replay_file)));
+
+    std::ostringstream state_hash;
+    state_hash << std::hex << std::setw(16) << std::setfill('0') << stats.state_hash;
+    boost::json::object add_data;
+    add_data["joins"] = stats.joins;
+    add_data["actions"] = stats.actions;
+    add_data["ticks"] = stats.ticks;
+    add_data["simulated_seconds"] = stats.simulated_seconds;
+    add_data["wall_seconds"] = stats.wall_seconds;
+    add_data["ticks_per_second"] = stats.wall_seconds > 0. ? stats.ticks / stats.wall_seconds : 0.;
+    add_data["state_hash"] = state_hash.str();
+    logger::LogMessageInfo(add_data, "replay finished"s);
+}
+
+// Прогон ботов без сети: стоимость симуляции отдельно от сетевой части
+void RunSimulation(const fs::path& config, const Args& args) {
+    if (args.random_seed) {
+        auxillary::SetRandomSeed(*args.random_seed);
+    }
+    net::io_context ioc;
+    GameServer gs(ioc, config, {});
+    // С радиусом сессии ведут сетку видимости, как и под сетевой нагрузкой
+    if (args.state_radius > 0.) {
+        gs.SetStateRadius(args.state_radius);
+    }
+    gs.StartBots(args.bot_threads);
+    const std::chrono::milliseconds tick(args.tick_period > 0 ? args.tick_period : 100);
+
+    uint64_t ticks = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (double simulated = 0.; simulated < args.simulate_seconds; simulated += tick.count() / 1000.) {
+        gs.Tick(tick);
+        ++ticks;
+    }
+    const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    boost::json::object add_data;
+    add_data["bots"] = gs.GetBotCount();
+    add_data["ticks"] = ticks;
+    add_data["tick_ms"] = tick.count();
+    add_data["wall_seconds"] = wall_seconds;
+    add_data["ticks_per_second"] = wall_seconds > 0. ? ticks / wall_seconds : 0.;
+    add_data["us_per_tick"] = ticks > 0 ? wall_seconds * 1e6 / ticks : 0.;
+    // Для сравнения аллокаторов на одном прогоне
+    const memory::ProcessMemory process = memory::ReadProcessMemory();
+    add_data["allocator"] = process.allocator;
+    add_data["rss"] = process.rss;
+    add_data["heap_in_use"] = process.heap_in_use;
+    logger::LogMessageInfo(add_data, "simulation finished"s);
+}
+
+// Как часто при плавной остановке проверяется, закрылись ли соединения
+constexpr auto DRAIN_POLL_PERIOD = 10ms;
+// Сколько новый процесс ждёт старый сверх его времени на остановку
+constexpr auto HANDOFF_EXIT_MARGIN = 5s;
+
+// Останавливает все io_context, когда закроются все соединения, но не позже deadline
+void StopWhenDrained(net::steady_timer& timer, std::chrono::steady_clock::time_point deadline,
+                     std::vector<std::unique_ptr<net::io_context>>& contexts) {
+    const size_t active = http_server::ServerControl::Instance().ActiveSessions();
+    if (active == 0 || std::chrono::steady_clock::now() >= deadline) {
+        boost::json::object add_data;
+        add_data["unfinished_sessions"] = active;
+        logger::LogMessageInfo(add_data, "drain finished"s);
+        for (auto& context : contexts) {
+            context->stop();
+        }
+        return;
+    }
+    timer.expires_after(DRAIN_POLL_PERIOD);
+    timer.async_wait([&timer, deadline, &contexts](sys::error_code ec) {
+        if (!ec) {
+            StopWhenDrained(timer, deadline, contexts);
+        }
+    });
 }
 
 } // namespace
@@ -54,6 +152,11 @@ int main(int argc, const char* argv[]) {
     logger.Init();
 
     try {
+        // До запуска любых потоков: они наследуют привязку к ядрам и политику памяти
+        if (command_line_args.numa_node) {
+            placement::BindToNode(*command_line_args.numa_node);
+        }
+        placement::SetHugePages(placement::ParseHugePages(command_line_args.huge_pages));
 
         /*
         fs::path config = fs::weakly_canonical(fs::path(auxillary::UrlDecode(argv[1])));
@@ -62,16 +165,102 @@ int main(int argc, const char* argv[]) {
         fs::path config = fs::weakly_canonical(fs::path(auxillary::UrlDecode(command_line_args.config_file_path)));
         fs::path root = fs::weakly_canonical(fs::path(auxillary::UrlDecode(command_line_args.static_root)));
 
-        const unsigned num_threads = std::thread::hardware_concurrency();
-        net::io_context ioc(num_threads);
+        if (!command_line_args.replay_file.empty()) {
+            RunReplay(config, command_line_args);
+            logger::LogExit(0);
+            return 0;
+        }
+        if (command_line_args.simulate_seconds > 0.) {
+            RunSimulation(config, command_line_args);
+            logger::LogExit(0);
+            return 0;
+        }
+
+        // Ядра с учётом taskset и --numa-node
+        const std::vector<unsigned> cpus = placement::AllowedCpus();
+        const unsigned num_threads = cpus.size();
+        const bool per_core = command_line_args.threading_model == "per-core"s;
+
+        // В режиме per-core io_context на каждое ядро, иначе один общий на все потоки
+        std::vector<std::unique_ptr<net::io_context>> contexts;
+        if (per_core) {
+            for (unsigned core = 0; core < num_threads; ++core) {
+                contexts.emplace_back(std::make_unique<net::io_context>(1));
+            }
+        } else {
+            contexts.emplace_back(std::make_unique<net::io_context>(num_threads));
+        }
+        // Состояние игры принадлежит первому io_context, остальные ядра обращаются к нему через strand.
+        // В per-core по ядрам делится только сетевая часть: strand игры - одна очередь в любом режиме,
+        // а делить само состояние по картам - дело шардов за game_router
+        net::io_context& ioc = *contexts.front();
 
         auto api_strand = net::make_strand(ioc);
 
-        GameServer gs(ioc, config, root);
+        fs::path records_file;
+        if (!command_line_args.records_file.empty()) {
+            records_file = fs::weakly_canonical(fs::path(command_line_args.records_file));
+        }
+
+        // Работающий процесс отдаёт слушающие сокеты и плавно останавливается
+        std::optional<handoff::Predecessor> predecessor = command_line_args.handoff_socket.empty()
+            ? std::optional<handoff::Predecessor>{}
+            : handoff::Predecessor::Connect(command_line_args.handoff_socket);
+        std::vector<int> inherited_listeners;
+        if (predecessor) {
+            inherited_listeners = predecessor->TakeListeners();
+            // Файлы рекордов, журнала и состояния открываются только после того, как их допишет старый процесс.
+            // Соединения тем временем копятся в очереди переданного сокета
+            if (!records_file.empty() || !command_line_args.journal_file.empty() || !command_line_args.state_file.empty()) {
+                if (!predecessor->WaitForExit(std::chrono::milliseconds(command_line_args.drain_timeout) + HANDOFF_EXIT_MARGIN)) {
+                    logger::LogMessageInfo(boost::json::object{}, "previous server did not confirm exit"s);
+                }
+            }
+        }
+
+        GameServer gs(ioc, config, root, records_file);
 
         if (command_line_args.random_spawn == true) {
             gs.SetSpawnDogRandomPoint();
         }
+        if (command_line_args.random_seed) {
+            auxillary::SetRandomSeed(*command_line_args.random_seed);
+            gs.SetRandomSeed(*command_line_args.random_seed);
+        }
+        if (command_line_args.shard_id) {
+            model::SetTokenShard(*command_line_args.shard_id);
+        }
+        gs.SetShard(command_line_args.shard_id.value_or(0), command_line_args.shard_count);
+        if (!command_line_args.journal_file.empty()) {
+            gs.EnableJournal(fs::weakly_canonical(fs::path(command_line_args.journal_file)));
+        }
+
+        if (command_line_args.state_radius > 0.) {
+            gs.SetStateRadius(command_line_args.state_radius);
+        }
+        // Сбой записи состояния останавливает сервер так же, как сигнал. Обработчик назначается ниже,
+        // а вызывается из io_context, который к тому времени уже запущен
+        std::function<void()> on_state_failure;
+        if (!command_line_args.state_file.empty()) {
+            gs.EnableStatePersistence(fs::weakly_canonical(fs::path(command_line_args.state_file)),
+                                      std::chrono::milliseconds(command_line_args.save_state_period),
+                                      std::chrono::milliseconds(command_line_args.wal_sync_interval),
+                                      [&ioc, &on_state_failure] {
+                                          net::post(ioc, [&on_state_failure] {
+                                              on_state_failure();
+                                          });
+                                      });
+        }
+
+        gs.StartBots(command_line_args.bot_threads);
+        gs.SetAdminToken(command_line_args.admin_token);
+        // Запросы принимаются сразу: карту, до которой пул ещё не дошёл, построит сам запрос
+        gs.StartMapRendering(command_line_args.map_render_threads, [](size_t bodies, std::chrono::milliseconds elapsed) {
+            boost::json::object add_data;
+            add_data["bodies"] = bodies;
+            add_data["ms"] = elapsed.count();
+            logger::LogMessageInfo(add_data, "maps rendered"s);
+        });
 
         if (command_line_args.tick_period > 0) {
             std::chrono::milliseconds mills(command_line_args.tick_period);
@@ -83,29 +272,122 @@ int main(int argc, const char* argv[]) {
             
         }
 
+        if (command_line_args.memory_log_period > 0) {
+            // Отчёт обходит модель, поэтому собирается на strand игры
+            auto memory_ticker = std::make_shared<Ticker>(api_strand, std::chrono::milliseconds(command_line_args.memory_log_period),
+                [&gs](std::chrono::milliseconds) {
+                    logger::LogMessageInfo(memory::ToJson(gs.GetMemoryReport()), "memory usage"s);
+                });
+            memory_ticker->Start();
+        }
+
         const auto address = net::ip::make_address("0.0.0.0");
-        constexpr net::ip::port_type port = 8080;
+        const net::ip::port_type port = command_line_args.port;
+
+        std::optional<handoff::HandoffServer> handoff_server;
+        net::steady_timer drain_timer(ioc);
+        // Новые соединения больше не принимаются, открытые закрываются после текущего ответа
+        auto begin_drain = [&] {
+            auto& control = http_server::ServerControl::Instance();
+            if (control.Draining()) {
+                return;
+            }
+            if (handoff_server) {
+                handoff_server->Close();
+            }
+            boost::json::object add_data;
+            add_data["sessions"] = control.ActiveSessions();
+            logger::LogMessageInfo(add_data, "drain started"s);
+            control.BeginDrain();
+            StopWhenDrained(drain_timer, std::chrono::steady_clock::now() + std::chrono::milliseconds(command_line_args.drain_timeout), contexts);
+        };
+
+        on_state_failure = begin_drain;
 
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc, &logger](const sys::error_code ec, [[maybe_unused]] int signal_number) {
-            if (!ec) {
-                ioc.stop();
-                //logger::LogExit(0);
+        signals.async_wait([&](const sys::error_code ec, [[maybe_unused]] int signal_number) {
+            if (ec) {
+                return;
             }
+            begin_drain();
+            // Повторный сигнал останавливает сервер, не дожидаясь соединений
+            signals.async_wait([&contexts](const sys::error_code ec, [[maybe_unused]] int signal_number) {
+                if (!ec) {
+                    for (auto& context : contexts) {
+                        context->stop();
+                    }
+                }
+            });
         });
 
-        auto handler = std::make_shared<http_handler::RequestHandler>(ioc, gs, api_strand);
+        std::vector<net::ip::address> trusted_proxies;
+        for (const std::string& proxy : command_line_args.trusted_proxies) {
+            trusted_proxies.push_back(net::ip::make_address(proxy));
+        }
+        http_handler::Limits limits{
+            command_line_args.ip_rate_limit, command_line_args.ip_burst,
+            command_line_args.token_rate_limit, command_line_args.token_burst,
+            command_line_args.max_strand_queue, std::move(trusted_proxies)};
+        auto handler = std::make_shared<http_handler::RequestHandler>(ioc, gs, api_strand, limits);
         http_handler::LoggingRequestHandler<http_handler::RequestHandler> logging_handler{*handler};
         boost::json::object add_data;
         add_data["port"] = port;
         add_data["address"] = address.to_string();
+        add_data["threading_model"] = command_line_args.threading_model;
+        if (command_line_args.shard_id) {
+            add_data["shard_id"] = *command_line_args.shard_id;
+            add_data["shard_count"] = command_line_args.shard_count;
+        }
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+        add_data["io_backend"] = "io_uring";
+#else
+        add_data["io_backend"] = "epoll";
+#endif
         logger::LogMessageInfo(add_data, "server started"s);
+        http_server::Timeouts timeouts{
+            std::chrono::milliseconds(command_line_args.idle_timeout),
+            std::chrono::milliseconds(command_line_args.header_timeout),
+            std::chrono::milliseconds(command_line_args.body_timeout)};
     // Запускаем обработку запросов 
-        http_server::ServeHttp(ioc, {address, port}, logging_handler);
+        // В режиме per-core каждый io_context выполняет один поток
+        const unsigned context_threads = per_core ? 1 : num_threads;
+        if (inherited_listeners.empty()) {
+            for (auto& context : contexts) {
+                http_server::ServeHttp(*context, {address, port}, logging_handler, per_core, timeouts, context_threads);
+            }
+        } else {
+            // Полученные сокеты раздаются по io_context по кругу
+            for (size_t i = 0; i < inherited_listeners.size(); ++i) {
+                http_server::ServeHttp(*contexts[i % contexts.size()], {address, port}, logging_handler, per_core, timeouts, context_threads,
+                                       inherited_listeners[i]);
+            }
+        }
+        if (!command_line_args.handoff_socket.empty()) {
+            handoff_server.emplace(ioc, command_line_args.handoff_socket, [] {
+                return http_server::ServerControl::Instance().ListenerHandles();
+            }, begin_drain);
+        }
 
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
-            ioc.run();
-        });
+        if (per_core) {
+            RunPerCoreWorkers(contexts, cpus);
+        } else {
+            RunWorkers(num_threads, [&ioc, &cpus, pin = command_line_args.pin_threads](unsigned index) {
+                if (pin) {
+                    placement::PinThreadToCpu(cpus[index]);
+                }
+                memory::BindThreadArena();
+                ioc.run();
+            });
+        }
+        // Все потоки остановлены, состояние можно читать вне strand
+        gs.Shutdown();
+        if (handoff_server) {
+            handoff_server->NotifyExited();
+        }
+        if (gs.StateLost()) {
+            logger::LogExit(EXIT_FAILURE);
+            return EXIT_FAILURE;
+        }
     } catch (const std::exception& ex) {
         logger::LogExit(EXIT_FAILURE, &ex);
         return EXIT_FAILURE;
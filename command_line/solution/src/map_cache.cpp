@@ -0,0 +1,137 @@
+#include "map_cache.h"
+#include "cbor_writer.h"
+#include "json_writer.h"
+#include "memory_stats.h"
+#include "placement.h"
+#include "serialization.h"
+
+#include <algorithm>
+
+namespace serialization {
+
+MapCache::MapCache(const std::vector<model::Map>& maps) :
+    maps_(maps),
+    size_((maps.size() + 1) * 2),
+    entries_(std::make_unique<Entry[]>(size_)) {}
+
+void MapCache::Start(unsigned threads, ReadyHandler on_ready) {
+    if (threads == 0) {
+        threads = placement::AllowedCpus().size();
+    }
+    threads = std::min<size_t>(threads, size_);
+    on_ready_ = std::move(on_ready);
+    started_ = std::chrono::steady_clock::now();
+    running_.store(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers_.emplace_back([this](std::stop_token stop) {
+            for (size_t index = next_.fetch_add(1); index < size_ && !stop.stop_requested(); index = next_.fetch_add(1)) {
+                TryRender(index);
+            }
+            if (running_.fetch_sub(1) == 1 && on_ready_ && !stop.stop_requested()) {
+                on_ready_(size_, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_));
+            }
+        });
+    }
+}
+
+const std::string& MapCache::GetMap(const model::Map& map, bool cbor) {
+    return Get(MapIndex(map) * 2 + cbor);
+}
+
+const std::string& MapCache::GetMapsList(bool cbor) {
+    return Get(maps_.size() * 2 + cbor);
+}
+
+bool MapCache::WhenMapReady(const model::Map& map, bool cbor, std::function<void()> fn) {
+    return WhenReady(MapIndex(map) * 2 + cbor, std::move(fn));
+}
+
+bool MapCache::WhenMapsListReady(bool cbor, std::function<void()> fn) {
+    return WhenReady(maps_.size() * 2 + cbor, std::move(fn));
+}
+
+size_t MapCache::MemoryUsage(const model::Map& map) const {
+    size_t bytes = 0;
+    for (size_t index = MapIndex(map) * 2; index < MapIndex(map) * 2 + 2; ++index) {
+        const Entry& entry = entries_[index];
+        if (entry.body.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            try {
+                bytes += memory::StringBytes(entry.body.get());
+            } catch (...) {
+            }
+        }
+    }
+    return bytes;
+}
+
+const std::string& MapCache::Get(size_t index) {
+    TryRender(index);
+    return entries_[index].body.get();
+}
+
+bool MapCache::WhenReady(size_t index, std::function<void()> fn) {
+    Entry& entry = entries_[index];
+    if (!entry.claimed.exchange(true)) {
+        RenderClaimed(index);
+        return false;
+    }
+    std::lock_guard lock(entry.mutex);
+    if (entry.ready) {
+        return false;
+    }
+    entry.waiters.push_back(std::move(fn));
+    return true;
+}
+
+void MapCache::TryRender(size_t index) {
+    if (!entries_[index].claimed.exchange(true)) {
+        RenderClaimed(index);
+    }
+}
+
+void MapCache::RenderClaimed(size_t index) {
+    Entry& entry = entries_[index];
+    try {
+        entry.promise.set_value(Render(index));
+    } catch (...) {
+        entry.promise.set_exception(std::current_exception());
+    }
+    std::vector<std::function<void()>> waiters;
+    {
+        std::lock_guard lock(entry.mutex);
+        entry.ready = true;
+        waiters.swap(entry.waiters);
+    }
+    for (auto& fn : waiters) {
+        fn();
+    }
+}
+
+std::string MapCache::Render(size_t index) const {
+    const size_t map_index = index / 2;
+    std::string body;
+    auto write = [&](auto& writer) {
+        if (map_index == maps_.size()) {
+            WriteMapsList(writer, maps_);
+        } else {
+            WriteMap(writer, maps_[map_index]);
+        }
+    };
+    if (map_index < maps_.size()) {
+        body.reserve(EstimateMapSize(maps_[map_index]));
+    }
+    if (index % 2 == 1) {
+        CborWriter writer(body);
+        write(writer);
+    } else {
+        JsonWriter writer(body);
+        write(writer);
+    }
+    return body;
+}
+
+size_t MapCache::MapIndex(const model::Map& map) const {
+    return static_cast<size_t>(&map - maps_.data());
+}
+
+}  // namespace serialization
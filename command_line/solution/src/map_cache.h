@@ -0,0 +1,81 @@
+#pragma once
+
+#include "model.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace serialization {
+
+// Готовые тела ответов /api/v1/maps и /api/v1/maps/<id> в JSON и CBOR. Карты после загрузки
+// не меняются, поэтому каждое тело строится ровно один раз: пулом потоков при старте или
+// первым запросом к ещё не взятой пулом карте. Запрос к телу, которое уже строит другой поток,
+// не ждёт его: WhenMapReady вызовет продолжение, когда тело будет готово
+class MapCache {
+public:
+    // maps должны пережить кэш и больше не меняться
+    explicit MapCache(const std::vector<model::Map>& maps);
+
+    MapCache(const MapCache&) = delete;
+    MapCache& operator=(const MapCache&) = delete;
+
+    // Вызывается один раз, когда потоки пула разобрали все тела
+    using ReadyHandler = std::function<void(size_t bodies, std::chrono::milliseconds elapsed)>;
+
+    // Строит все тела на threads потоках (0 - по числу ядер). Запросы обслуживаются и до окончания.
+    // Без вызова тела строятся по первому запросу
+    void Start(unsigned threads, ReadyHandler on_ready = {});
+
+    // Можно вызывать из любого потока. Ошибка построения пробрасывается каждому запросу этого тела.
+    // Если тело строит другой поток, ждут его
+    const std::string& GetMap(const model::Map& map, bool cbor);
+    const std::string& GetMapsList(bool cbor);
+
+    // false - тело готово (или построено прямо сейчас этим вызовом), и GetMap вернёт его без ожидания.
+    // true - тело строит другой поток, fn будет вызвана на нём после построения
+    bool WhenMapReady(const model::Map& map, bool cbor, std::function<void()> fn);
+    bool WhenMapsListReady(bool cbor, std::function<void()> fn);
+
+    // Уже построенные тела карты
+    size_t MemoryUsage(const model::Map& map) const;
+
+private:
+    struct Entry {
+        std::atomic<bool> claimed{false};
+        std::promise<std::string> promise;
+        std::shared_future<std::string> body = promise.get_future().share();
+        std::mutex mutex;
+        bool ready = false;
+        std::vector<std::function<void()>> waiters;
+    };
+
+    // Тела карты i лежат в 2 * i (JSON) и 2 * i + 1 (CBOR), списка карт - в двух последних
+    const std::string& Get(size_t index);
+    bool WhenReady(size_t index, std::function<void()> fn);
+    // Ничего не делает, если тело уже строит другой поток
+    void TryRender(size_t index);
+    // Строит тело, которое этот поток только что взял, и будит ждущих
+    void RenderClaimed(size_t index);
+    std::string Render(size_t index) const;
+    size_t MapIndex(const model::Map& map) const;
+
+    const std::vector<model::Map>& maps_;
+    const size_t size_;
+    std::unique_ptr<Entry[]> entries_;
+
+    std::atomic<size_t> next_{0};
+    std::atomic<unsigned> running_{0};
+    std::chrono::steady_clock::time_point started_;
+    ReadyHandler on_ready_;
+    // Потоки объявлены последними: при разрушении они останавливаются раньше, чем уходят тела
+    std::vector<std::jthread> workers_;
+};
+
+}  // namespace serialization
@@ -0,0 +1,117 @@
+#include "memory_stats.h"
+#include "http_server.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+#if defined(GAME_SERVER_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(GAME_SERVER_MIMALLOC)
+#include <mimalloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace memory {
+
+namespace {
+
+size_t ReadRss() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+#if defined(GAME_SERVER_JEMALLOC)
+size_t ReadJemallocStat(const char* name) {
+    size_t value = 0;
+    size_t size = sizeof(value);
+    return ::mallctl(name, &value, &size, nullptr, 0) == 0 ? value : 0;
+}
+#endif
+
+}  // namespace
+
+ProcessMemory ReadProcessMemory() {
+    ProcessMemory result;
+    result.rss = ReadRss();
+#if defined(GAME_SERVER_JEMALLOC)
+    // Статистика jemalloc обновляется только при смене эпохи
+    uint64_t epoch = 1;
+    size_t epoch_size = sizeof(epoch);
+    ::mallctl("epoch", &epoch, &epoch_size, &epoch, epoch_size);
+    const size_t allocated = ReadJemallocStat("stats.allocated");
+    const size_t active = ReadJemallocStat("stats.active");
+    result.heap_in_use = allocated;
+    result.heap_free = active > allocated ? active - allocated : 0;
+    result.heap_mmapped = ReadJemallocStat("stats.mapped");
+    result.allocator = "jemalloc";
+#elif defined(GAME_SERVER_MIMALLOC)
+    size_t elapsed_ms, user_ms, system_ms, current_rss, peak_rss, current_commit, peak_commit, page_faults;
+    ::mi_process_info(&elapsed_ms, &user_ms, &system_ms, &current_rss, &peak_rss, &current_commit, &peak_commit, &page_faults);
+    // mimalloc не разделяет занятое и свободное внутри выделенных страниц
+    result.heap_in_use = current_commit;
+    result.allocator = "mimalloc";
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    // mallinfo2 обходит все арены под их мьютексами: вызывать редко
+    const struct mallinfo2 info = ::mallinfo2();
+    result.heap_in_use = info.uordblks;
+    result.heap_free = info.fordblks;
+    result.heap_mmapped = info.hblkhd;
+    result.allocator = "glibc";
+#else
+    result.allocator = "unknown";
+#endif
+    return result;
+}
+
+void BindThreadArena() {
+#if defined(GAME_SERVER_JEMALLOC)
+    // Мелкие объекты соединений и ответов выделяются и чаще всего освобождаются на одном потоке:
+    // своя арена убирает конкуренцию за общие арены и перемешивание их страниц между потоками
+    unsigned arena = 0;
+    size_t size = sizeof(arena);
+    if (::mallctl("arenas.create", &arena, &size, nullptr, 0) == 0) {
+        ::mallctl("thread.arena", nullptr, nullptr, &arena, sizeof(arena));
+    }
+#endif
+}
+
+void AddServerMemory(Report& report) {
+    const auto http = http_server::ServerControl::Instance().GetMemoryStats();
+    report.http_sessions = http.sessions;
+    report.http_bytes = http.bytes;
+    report.process = ReadProcessMemory();
+}
+
+boost::json::object ToJson(const Report& report) {
+    boost::json::array maps;
+    size_t maps_bytes = 0;
+    for (const MapMemory& map : report.maps) {
+        maps.push_back(boost::json::object{{"id", map.id}, {"bytes", map.bytes}});
+        maps_bytes += map.bytes;
+    }
+    boost::json::array sessions;
+    size_t sessions_bytes = 0;
+    for (const SessionMemory& session : report.sessions) {
+        sessions.push_back(boost::json::object{{"map", session.map_id}, {"dogs", session.dogs}, {"bytes", session.bytes}});
+        sessions_bytes += session.bytes;
+    }
+    return boost::json::object{
+        {"maps", boost::json::object{{"bytes", maps_bytes}, {"items", std::move(maps)}}},
+        {"sessions", boost::json::object{{"bytes", sessions_bytes}, {"items", std::move(sessions)}}},
+        {"players", boost::json::object{{"count", report.players}, {"bytes", report.players_bytes}}},
+        {"http", boost::json::object{{"connections", report.http_sessions}, {"bytes", report.http_bytes}}},
+        {"process", boost::json::object{{"rss", report.process.rss},
+                                        {"allocator", report.process.allocator},
+                                        {"heapInUse", report.process.heap_in_use},
+                                        {"heapFree", report.process.heap_free},
+                                        {"heapMmapped", report.process.heap_mmapped}}}};
+}
+
+}  // namespace memory
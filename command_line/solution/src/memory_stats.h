@@ -0,0 +1,75 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Учёт памяти по подсистемам. Объём оценивается по ёмкости контейнеров и размерам объектов,
+// без служебных данных аллокатора, поэтому сумма подсистем меньше RSS процесса
+namespace memory {
+
+template <typename T, typename Allocator>
+size_t VectorBytes(const std::vector<T, Allocator>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+// Только то, что лежит вне самого объекта строки: короткие строки хранятся внутри
+inline size_t StringBytes(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+// Узел std::list: значение и два указателя
+template <typename T>
+constexpr size_t LIST_NODE_BYTES = sizeof(T) + 2 * sizeof(void*);
+
+// Блок std::make_shared: объект и два счётчика ссылок с указателем на таблицу виртуальных функций
+template <typename T>
+constexpr size_t SHARED_BLOCK_BYTES = sizeof(T) + 2 * sizeof(int) + sizeof(void*);
+
+struct MapMemory {
+    std::string id;
+    size_t bytes = 0;
+};
+
+struct SessionMemory {
+    std::string map_id;
+    size_t dogs = 0;
+    size_t bytes = 0;
+};
+
+// Сведения аллокатора и ядра. Нули - источник недоступен на этой платформе
+struct ProcessMemory {
+    size_t rss = 0;
+    // Занято и свободно в кучах malloc, отображено отдельными mmap
+    size_t heap_in_use = 0;
+    size_t heap_free = 0;
+    size_t heap_mmapped = 0;
+    std::string allocator;
+};
+
+struct Report {
+    std::vector<MapMemory> maps;
+    std::vector<SessionMemory> sessions;
+    size_t players = 0;
+    size_t players_bytes = 0;
+    size_t http_sessions = 0;
+    size_t http_bytes = 0;
+    ProcessMemory process;
+};
+
+ProcessMemory ReadProcessMemory();
+
+// Отдельная арена аллокатора для вызывающего потока ввода-вывода (jemalloc). glibc и mimalloc
+// сами раздают потокам арены и кучи, для них вызов ничего не делает
+void BindThreadArena();
+
+// Соединения и сведения процесса; игровую часть заполняет GameServer
+void AddServerMemory(Report& report);
+
+boost::json::object ToJson(const Report& report);
+
+}  // namespace memory
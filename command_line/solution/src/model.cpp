@@ -1,31 +1,81 @@
 #include "model.h"
+#include "memory_stats.h"
+
+#include <tuple>
 
 namespace model {
 using namespace std::literals;
 
-double RoundToTwoDigits(double d) {
-    return ((int)(d * 100 + 0.5) / 100.0);
+namespace {
+
+constexpr double HALF_ROAD_WIDTH = 0.4;
+
+RoadSegment MakeSegment(bool horizontal, Coord line, Coord from, Coord to) {
+    RoadSegment segment{horizontal, line, from, to, {}, {}};
+    if (horizontal) {
+        segment.area.left_bottom = {from - HALF_ROAD_WIDTH, line - HALF_ROAD_WIDTH};
+        segment.area.right_top = {to + HALF_ROAD_WIDTH, line + HALF_ROAD_WIDTH};
+    } else {
+        segment.area.left_bottom = {line - HALF_ROAD_WIDTH, from - HALF_ROAD_WIDTH};
+        segment.area.right_top = {line + HALF_ROAD_WIDTH, to + HALF_ROAD_WIDTH};
+    }
+    return segment;
+}
+
+// Склеивает перекрывающиеся и соприкасающиеся дороги одной линии
+void MergeCollinear(std::vector<RoadSegment>& out, bool horizontal, std::vector<std::tuple<Coord, Coord, Coord>> lines) {
+    std::sort(lines.begin(), lines.end());
+    for (size_t i = 0; i < lines.size();) {
+        auto [line, from, to] = lines[i];
+        size_t j = i + 1;
+        while (j < lines.size() && std::get<0>(lines[j]) == line && std::get<1>(lines[j]) <= to) {
+            to = std::max(to, std::get<2>(lines[j]));
+            ++j;
+        }
+        out.push_back(MakeSegment(horizontal, line, from, to));
+        i = j;
+    }
+}
+
+double AlongAxis(const ParamPairDouble& p, bool along_x) {
+    return along_x ? p.x_ : p.y_;
+}
+
+double AcrossAxis(const ParamPairDouble& p, bool along_x) {
+    return along_x ? p.y_ : p.x_;
 }
 
-void Map::AddRoad(const Road& road) {
-    roads_.emplace_back(road);
-    std::shared_ptr<Road> road_ptr = std::make_shared<Road>(roads_.back());
-    //std::cout << "road emplaced: " << road_ptr << std::endl;
-    
-    if (road.IsHorizontal()) {
-        //std::cout << "Adding Horizontal road " << std::endl;
-        for (Coord x = std::min(road_ptr->GetStart().x, road_ptr->GetEnd().x); x <= std::max(road_ptr->GetStart().x, road_ptr->GetEnd().x); x++) {
-            //std::cout << "adding point: {" << x << ", " << road_ptr->GetStart().y << "} " << road_ptr << std::endl; 
-            coord_to_road[{x, road_ptr->GetStart().y}].emplace(road_ptr);
+} // namespace
+
+size_t Map::MemoryUsage() const {
+    auto keys_bytes = [](const Element& element) {
+        size_t bytes = memory::VectorBytes(element.GetKeys());
+        for (const std::string& key : element.GetKeys()) {
+            bytes += memory::StringBytes(key);
         }
+        return bytes;
+    };
+    size_t bytes = sizeof(Map) + memory::StringBytes(*id_) + memory::StringBytes(name_) + keys_bytes(*this);
+    bytes += memory::VectorBytes(roads_);
+    for (const Road& road : roads_) {
+        bytes += keys_bytes(road);
+    }
+    bytes += memory::VectorBytes(buildings_);
+    for (const Building& building : buildings_) {
+        bytes += keys_bytes(building);
+    }
+    bytes += memory::VectorBytes(offices_);
+    for (const Office& office : offices_) {
+        bytes += keys_bytes(office) + memory::StringBytes(*office.GetId());
     }
-    if (road.IsVertical()) {
-        //std::cout << "Adding Vertical road " << std::endl;
-        for (Coord y = std::min(road_ptr->GetStart().y, road_ptr->GetEnd().y); y <= std::max(road_ptr->GetStart().y, road_ptr->GetEnd().y); y++) {
-            //std::cout << "adding point: {" << road_ptr->GetStart().x << ", " << y << "} " << road_ptr << std::endl; 
-            coord_to_road[{road_ptr->GetStart().x, y}].emplace(road_ptr);
-        }        
+    // Корзины и узлы с закэшированным хешем
+    bytes += warehouse_id_to_index_.bucket_count() * sizeof(void*)
+           + warehouse_id_to_index_.size() * (sizeof(OfficeIdToIndex::value_type) + 2 * sizeof(void*));
+    bytes += memory::VectorBytes(segments_);
+    for (const RoadSegment& segment : segments_) {
+        bytes += memory::VectorBytes(segment.adjacent);
     }
+    return bytes + memory::VectorBytes(spawn_probability_) + memory::VectorBytes(spawn_alias_);
 }
 
 void Map::AddOffice(Office office) {
@@ -43,69 +93,176 @@ void Map::AddOffice(Office office) {
     }
 }
 
-std::set<std::shared_ptr<Road>> Map::GetRoadsByCoords(Point p) const {
-    if (coord_to_road.contains(p)) {
-        return coord_to_road.at(p);
+ParamPairDouble Map::GetRandomDogPosition(auxillary::FastRandom& random) const {
+    if (segments_.empty()) {
+        throw std::runtime_error("No roads to put dog on...");
+    }
+
+    // Метод псевдонимов: участок выбирается за O(1) с вероятностью, пропорциональной длине
+    size_t index = random.NextIndex(segments_.size());
+    if (random.NextDouble() >= spawn_probability_[index]) {
+        index = spawn_alias_[index];
     }
-    return {};    
+    const RoadSegment& segment = segments_[index];
+
+    const double along = segment.from + (segment.to - segment.from) * random.NextDouble();
+    const double across = segment.line + (2 * random.NextDouble() - 1) * HALF_ROAD_WIDTH;
+    return segment.horizontal ? ParamPairDouble{along, across} : ParamPairDouble{across, along};
 }
 
-ParamPairDouble Map::GetRandomDogPosition() const {
-    if (roads_.empty()) {
-        throw std::runtime_error("No roads to put dog on...");
+ParamPairDouble Map::GetStartPosition(bool random, auxillary::FastRandom& rng) const {
+    if (random) {
+        return GetRandomDogPosition(rng);
     }
+    Point p = roads_.at(0).GetStart();
+    return {p.x*1., p.y*1.};
+}
 
-    std::random_device rd;
-    std::mt19937 gen{rd()};
-    int road_number = 0;
-    if (roads_.size() > 1) {
-        std::uniform_int_distribution<int> dist(0, roads_.size()-1);
-        road_number = dist(gen);
+void Map::BuildRoadGraph() {
+    std::vector<std::tuple<Coord, Coord, Coord>> horizontal;
+    std::vector<std::tuple<Coord, Coord, Coord>> vertical;
+    for (const Road& road : roads_) {
+        Point start = road.GetStart();
+        Point end = road.GetEnd();
+        if (road.IsHorizontal()) {
+            horizontal.emplace_back(start.y, std::min(start.x, end.x), std::max(start.x, end.x));
+        } else {
+            vertical.emplace_back(start.x, std::min(start.y, end.y), std::max(start.y, end.y));
+        }
     }
-    Road road = roads_.at(road_number);
-    Point road_start = road.GetStart();
-    Point road_end = road.GetEnd();
 
-    ParamPairDouble random_point{static_cast<double>(road_start.x), static_cast<double>(road_start.y)};
-    double width;
-    {
-        std::uniform_real_distribution<> dist(-0.4, 0.4);
-        width = dist(gen);
-        width = RoundToTwoDigits(width);
+    segments_.clear();
+    MergeCollinear(segments_, true, std::move(horizontal));
+    const size_t first_vertical = segments_.size();
+    MergeCollinear(segments_, false, std::move(vertical));
+
+    // Параллельные участки с целыми координатами не касаются друг друга, поэтому
+    // смежными могут быть только горизонтальный и вертикальный участки, которые пересекаются
+    for (size_t h = 0; h < first_vertical; ++h) {
+        for (size_t v = first_vertical; v < segments_.size(); ++v) {
+            RoadSegment& hs = segments_[h];
+            RoadSegment& vs = segments_[v];
+            if (vs.line >= hs.from && vs.line <= hs.to && hs.line >= vs.from && hs.line <= vs.to) {
+                hs.adjacent.push_back(v);
+                vs.adjacent.push_back(h);
+            }
+        }
     }
 
-    if (road.IsHorizontal()) {
-        std::uniform_real_distribution<> dist(road_start.x, road_end.x);
-        random_point.x_ = dist(gen);
-        random_point.y_ += width;
+    if (!segments_.empty()) {
+        road_bounds_ = segments_.front().area;
     }
-    if (road.IsVertical()) {
-        std::uniform_real_distribution<> dist(road_start.y, road_end.y);
-        random_point.y_ = dist(gen);
-        random_point.x_ += width;
+    for (const RoadSegment& segment : segments_) {
+        road_bounds_.left_bottom.x_ = std::min(road_bounds_.left_bottom.x_, segment.area.left_bottom.x_);
+        road_bounds_.left_bottom.y_ = std::min(road_bounds_.left_bottom.y_, segment.area.left_bottom.y_);
+        road_bounds_.right_top.x_ = std::max(road_bounds_.right_top.x_, segment.area.right_top.x_);
+        road_bounds_.right_top.y_ = std::max(road_bounds_.right_top.y_, segment.area.right_top.y_);
     }
-    random_point.x_ = RoundToTwoDigits(random_point.x_); 
-    random_point.y_ = RoundToTwoDigits(random_point.y_);
 
-    return random_point;
+    BuildSpawnTable();
 }
 
-ParamPairDouble Map::GetStartPosition(bool random) const {
-    if (random) {
-        return GetRandomDogPosition();
+void Map::BuildSpawnTable() {
+    const size_t count = segments_.size();
+    spawn_probability_.assign(count, 1.);
+    spawn_alias_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        spawn_alias_[i] = i;
+    }
+
+    double total = 0.;
+    for (const RoadSegment& segment : segments_) {
+        total += segment.to - segment.from;
+    }
+    // Карта из одних точечных дорог - все участки равновероятны
+    if (total == 0.) {
+        return;
+    }
+
+    // Алгоритм Vose: участки делятся на недобравшие и перебравшие среднюю долю,
+    // недобор каждого из них закрывается одним перебравшим участком
+    std::vector<double> scaled(count);
+    std::vector<size_t> small;
+    std::vector<size_t> large;
+    for (size_t i = 0; i < count; ++i) {
+        scaled[i] = (segments_[i].to - segments_[i].from) * count / total;
+        (scaled[i] < 1. ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const size_t s = small.back();
+        small.pop_back();
+        const size_t l = large.back();
+        spawn_probability_[s] = scaled[s];
+        spawn_alias_[s] = l;
+        scaled[l] -= 1. - scaled[s];
+        if (scaled[l] < 1.) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Остатки отличаются от 1 только ошибкой округления
+    for (size_t i : small) {
+        spawn_probability_[i] = 1.;
+    }
+    for (size_t i : large) {
+        spawn_probability_[i] = 1.;
     }
-    Point p = roads_.at(0).GetStart();
-    return {p.x*1., p.y*1.};
 }
 
-void Map::PrintCoordToRoad() const {
-    for (auto [point, road] : coord_to_road) {
-        
-        std::cout << "{" << point.x << ", " << point.y << "} " << ": " << std::endl;
-        for (auto r : road) {
-            std::cout << "road ptr " << r << std::endl;
+size_t Map::FindSegment(ParamPairDouble pos) const {
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const RoadArea& area = segments_[i].area;
+        if (pos.x_ >= area.left_bottom.x_ && pos.x_ <= area.right_top.x_ &&
+            pos.y_ >= area.left_bottom.y_ && pos.y_ <= area.right_top.y_) {
+            return i;
+        }
+    }
+    return NO_SEGMENT;
+}
+
+RoadMove Map::MoveAlongRoads(size_t segment, ParamPairDouble pos, ParamPairDouble shift) const {
+    const bool along_x = shift.x_ != 0.;
+    const double delta = AlongAxis(shift, along_x);
+    if (delta == 0.) {
+        return {pos, segment, false};
+    }
+    const double target = AlongAxis(pos, along_x) + delta;
+    const double across = AcrossAxis(pos, along_x);
+
+    // Докуда участок пускает в направлении движения
+    auto limit_of = [&](const RoadSegment& s) {
+        return delta > 0 ? AlongAxis(s.area.right_top, along_x) : AlongAxis(s.area.left_bottom, along_x);
+    };
+    auto beyond = [&](double a, double b) {
+        return delta > 0 ? a > b : a < b;
+    };
+
+    size_t current = segment;
+    double reached = limit_of(segments_[current]);
+    while (beyond(target, reached)) {
+        // Ищем среди смежных участок, продолжающий линию движения за точку reached
+        size_t next = NO_SEGMENT;
+        double next_limit = reached;
+        for (size_t adjacent : segments_[current].adjacent) {
+            const RoadSegment& s = segments_[adjacent];
+            if (across < AcrossAxis(s.area.left_bottom, along_x) || across > AcrossAxis(s.area.right_top, along_x) ||
+                reached < AlongAxis(s.area.left_bottom, along_x) || reached > AlongAxis(s.area.right_top, along_x)) {
+                continue;
+            }
+            if (double limit = limit_of(s); beyond(limit, next_limit)) {
+                next = adjacent;
+                next_limit = limit;
+            }
+        }
+        if (next == NO_SEGMENT) {
+            (along_x ? pos.x_ : pos.y_) = reached;
+            return {pos, current, true};
         }
+        current = next;
+        reached = next_limit;
     }
+    (along_x ? pos.x_ : pos.y_) = target;
+    return {pos, current, false};
 }
 
 }
\ No newline at end of file
@@ -48,7 +48,7 @@ public:
         keys_.push_back(str);
     }
 
-    std::vector<std::string> GetKeys() const {
+    const std::vector<std::string>& GetKeys() const {
         return keys_;
     }
 private:
@@ -124,6 +124,26 @@ private:
     }
 };
 
+// Участок дорожного графа: склеенные коллинеарные дороги одной линии
+struct RoadSegment {
+    bool horizontal;
+    // Координата линии (y для горизонтальных, x для вертикальных) и границы вдоль неё
+    Coord line;
+    Coord from;
+    Coord to;
+    RoadArea area;
+    // Индексы пересекающихся участков (перекрёстки и примыкания)
+    std::vector<size_t> adjacent;
+};
+
+// Результат перемещения по дорожному графу
+struct RoadMove {
+    ParamPairDouble position;
+    size_t segment;
+    // Собака упёрлась в край дороги
+    bool stopped;
+};
+
 class Building : public Element {
 public:
     explicit Building(Rectangle bounds) noexcept :
@@ -164,6 +184,21 @@ private:
     std::vector<std::string> keys_;
 };
 
+// Поведение ботов - собак без HTTP-клиента, которыми управляет сам сервер
+enum class BotBehavior {
+    // Случайная смена направления без оглядки на дороги
+    RANDOM_WALK,
+    // Движение по дорогам со случайными поворотами на перекрёстках и в тупиках
+    FOLLOW_ROADS,
+    // Движение к случайно выбранному офису, затем к следующему
+    SEEK_OFFICES,
+};
+
+struct BotsConfig {
+    size_t count = 0;
+    BotBehavior behavior = BotBehavior::FOLLOW_ROADS;
+};
+
 class Map : public Element {
 public:
     using Id = util::Tagged<std::string, Map>;
@@ -195,9 +230,30 @@ public:
         return offices_;
     }
 
-    void AddRoad(const Road& road);/* {
+    void AddRoad(const Road& road) {
         roads_.emplace_back(road);
-    }*/
+    }
+
+    // Строит дорожный граф, вызывается один раз после загрузки всех дорог
+    void BuildRoadGraph();
+
+    const std::vector<RoadSegment>& GetRoadSegments() const noexcept {
+        return segments_;
+    }
+
+    // Прямоугольник, охватывающий все дороги вместе с их шириной
+    const RoadArea& GetRoadBounds() const noexcept {
+        return road_bounds_;
+    }
+
+    // Участок, которому принадлежит точка, или NO_SEGMENT
+    size_t FindSegment(ParamPairDouble pos) const;
+
+    // Сдвигает точку вдоль одной из осей на shift, переходя через перекрёстки по графу.
+    // Стоимость - O(числа пройденных участков)
+    RoadMove MoveAlongRoads(size_t segment, ParamPairDouble pos, ParamPairDouble shift) const;
+
+    constexpr static size_t NO_SEGMENT = static_cast<size_t>(-1);
 
     void AddBuilding(const Building& building) {
         buildings_.emplace_back(building);
@@ -205,9 +261,11 @@ public:
 
     void AddOffice(Office office);
 
-    ParamPairDouble GetRandomDogPosition() const;
+    // Случайная точка на дорогах, плотность равномерна по длине дорог.
+    // Свой генератор нужен, чтобы повторить точку появления при воспроизведении журнала
+    ParamPairDouble GetRandomDogPosition(auxillary::FastRandom& random = auxillary::ThreadRandom()) const;
 
-    ParamPairDouble GetStartPosition(bool random) const;
+    ParamPairDouble GetStartPosition(bool random, auxillary::FastRandom& rng = auxillary::ThreadRandom()) const;
 
     void SetMapDogSpeed(double ds) {
         //std::cout << "Map id: " << *id_ << " Setting map dog speed " << ds << std::endl;
@@ -218,9 +276,17 @@ public:
         return map_dog_speed_;
     }
 
-    std::set<std::shared_ptr<Road>> GetRoadsByCoords(Point p) const;
+    void SetBotsConfig(const BotsConfig& bots) {
+        bots_ = bots;
+    }
+
+    const BotsConfig& GetBotsConfig() const noexcept {
+        return bots_;
+    }
+
+    // Объекты карты, дорожный граф и таблицы выбора точки появления
+    size_t MemoryUsage() const;
 
-    void PrintCoordToRoad() const;
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
@@ -234,8 +300,15 @@ private:
     Offices offices_;
 
     double map_dog_speed_;
+    BotsConfig bots_;
+
+    std::vector<RoadSegment> segments_;
+    RoadArea road_bounds_{{0., 0.}, {0., 0.}};
+    // Таблица псевдонимов для выбора участка пропорционально длине
+    std::vector<double> spawn_probability_;
+    std::vector<size_t> spawn_alias_;
 
-    std::unordered_map<Point, std::set<std::shared_ptr<Road>>, PointHash> coord_to_road;
+    void BuildSpawnTable();
 };
 
 
@@ -1,7 +1,15 @@
 #include "model_app.h"
+#include "memory_stats.h"
+#include "sharding.h"
+
+#include <optional>
 
 namespace model {
 
+namespace {
+std::optional<unsigned> token_shard;
+}  // namespace
+
 int Dog::dog_id_counter_ = 0;
 int Player::player_id_counter_ = 0;
 
@@ -20,7 +28,26 @@ Token GetToken() {
     ss << std::setw(16) << std::setfill('0') << std::hex << generator2_(); 
     std::string result = ss.str();
     assert(result.size() == 32);
-    return Token(ss.str());
+    if (token_shard) {
+        sharding::StampToken(result, *token_shard);
+    }
+    return Token(std::move(result));
+}
+
+void SetTokenShard(unsigned shard) {
+    if (shard >= sharding::MAX_SHARDS) {
+        throw std::invalid_argument("Shard id must be less than "s + std::to_string(sharding::MAX_SHARDS));
+    }
+    token_shard = shard;
+}
+
+size_t PlayerList::MemoryUsage() const {
+    size_t bytes = players_.MemoryUsage();
+    players_.ForEach([&bytes](const Token& token, const std::shared_ptr<Player>& player) {
+        // Токен хранится дважды: в ключе узла индекса и в самом игроке
+        bytes += memory::SHARED_BLOCK_BYTES<Player> + 2 * memory::StringBytes(*token) + memory::StringBytes(player->GetName());
+    });
+    return bytes;
 }
 
 /*
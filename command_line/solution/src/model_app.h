@@ -1,12 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <iomanip>
+#include <list>
 #include <memory>
 #include <random>
 #include <vector>
 #include <unordered_map>
 
+#include "concurrent_token_map.h"
 #include "types.h"
 //#include "tagged.h"
 
@@ -23,13 +28,20 @@ using TokenHasher = util::TaggedHasher<Token>;
 
 class Player;
 class GameSession;
+class SpatialGrid;
 
 Token GetToken();
+// Номер шарда процесса, который записывается в каждый новый токен (см. sharding.h)
+void SetTokenShard(unsigned shard);
 
 class Dog {
 public:
-    explicit Dog(Token pl_tok) :
+    // Id игрока у собак без игрока (ботов)
+    constexpr static int NO_PLAYER = 0;
+
+    explicit Dog(Token pl_tok, int player_id = NO_PLAYER) :
         dog_id_(++dog_id_counter_),
+        player_id_(player_id),
         token_(pl_tok),
         dog_position_(0., 0.),
         dog_speed_(0., 0.),
@@ -40,10 +52,15 @@ public:
         return dog_id_;
     }
 
-    Token GetToken() const {
+    const Token& GetToken() const {
         return token_;
     }
 
+    // Id игрока-хозяина, NO_PLAYER у ботов. /state пишет его без поиска игрока по токену
+    int GetPlayerId() const noexcept {
+        return player_id_;
+    }
+
     bool SetToken(const Token& pl_token) {
         if ((*token_).empty()) {
             token_ = pl_token;
@@ -92,8 +109,12 @@ public:
         return dir_;
     }
 
+    static bool IsValidDirection(const std::string& dir) {
+        return dir == "U" || dir == "R" || dir == "L" || dir == "D" || dir == "";
+    }
+
     void SetDogDirection(const std::string& dir) {
-        if (dir != "U" && dir != "R" && dir != "L" && dir != "D" && dir != "") {
+        if (!IsValidDirection(dir)) {
             throw std::invalid_argument("Unknown direction...");
         }
         dir_ = dir;
@@ -105,15 +126,61 @@ public:
         dog_position_.y_ += move_dist.y_;
     }
 
+    int GetScore() const {
+        return score_;
+    }
+
+    void AddScore(int points) {
+        score_ += points;
+    }
+
+    bool IsMoving() const {
+        return dog_speed_.x_ != 0. || dog_speed_.y_ != 0.;
+    }
+
+    // Время указывается в игровом времени сессии, в секундах
+    double GetJoinTime() const {
+        return join_time_;
+    }
+
+    double GetLastActiveTime() const {
+        return last_active_time_;
+    }
+
+    size_t GetRoadSegment() const {
+        return road_segment_;
+    }
+
 private:
+    friend class GameSession;
+    friend class SpatialGrid;
+
     Token token_;
     int dog_id_;
+    int player_id_;
     static int dog_id_counter_;
 
     std::string dir_;
     ParamPairDouble dog_position_;
     ParamPairDouble dog_speed_;
     double default_dog_speed_ = 1.;
+    int score_ = 0;
+
+    // Учёт собаки в сессии: слот в GameSession::dogs_ и место в очереди по давности активности
+    size_t session_index_ = 0;
+    std::list<Dog*>::iterator idle_pos_;
+    // Участок дорожного графа карты, на котором стоит собака
+    size_t road_segment_ = 0;
+    double join_time_ = 0.;
+    double last_active_time_ = 0.;
+    // Ячейка сетки интереса сессии и место в ней
+    size_t grid_cell_ = 0;
+    size_t grid_slot_ = 0;
+    // Отсортированные id собак из прошлого ответа /state хозяина этой собаки (гистерезис видимости)
+    std::vector<int> visible_ids_;
+    // Размеры тела прошлого ответа /state хозяина (JSON и CBOR) при версии сессии state_size_version_
+    uint64_t state_size_version_ = 0;
+    std::array<size_t, 2> state_sizes_{};
 };
 
 class Player {
@@ -123,10 +190,20 @@ public:
         player_name_(name),
         session_{sess},
         player_id_(++player_id_counter_){
-            SetDog(std::make_shared<Dog>(token));
+            SetDog(std::make_shared<Dog>(token, player_id_));
             //dog_->SetPosition(dsp);
         }
 
+    // Восстановление из снимка или WAL: id остаётся прежним, новые игроки получат id больше него
+    Player(const Token& token, const std::string& name, std::shared_ptr<GameSession> sess, int id) :
+        player_token_(token),
+        player_name_(name),
+        session_{sess},
+        player_id_(id) {
+            player_id_counter_ = std::max(player_id_counter_, id);
+            SetDog(std::make_shared<Dog>(token, player_id_));
+        }
+
     Token GetPlayerToken() const {
         return player_token_;
     }
@@ -182,38 +259,64 @@ private:
     static int player_id_counter_;
 };
 
+// Индекс игроков по токену. Поиск допустим из любого потока, в том числе до входа в strand игры:
+// токен проверяется параллельно с игровыми обновлениями. Добавление и удаление линеаризуемы
 class PlayerList {
 public:    
-    /*Player**/std::shared_ptr<Player> FindPlayer(const Token& token) {
-        if (players_.contains(token)) {
-            return players_.at(token);
+    std::shared_ptr<Player> FindPlayer(const Token& token) const {
+        return players_.Find(token);
+    }
+
+    // Игрок с новым токеном, ещё не видимый через FindPlayer
+    std::shared_ptr<Player> MakePlayer(const std::string& name, std::shared_ptr<GameSession> session) const {
+        return std::make_shared<Player>(GetToken(), name, session);
+    }
+
+    void PublishPlayer(std::shared_ptr<Player> player) {
+        const Token token = player->GetPlayerToken();
+        if (!players_.Insert(token, std::move(player))) {
+            throw std::runtime_error("Failed to add player...");
         }
-        return nullptr;
+        version_.fetch_add(1, std::memory_order_relaxed);
     }
 
     /*Player&*/std::shared_ptr<Player> AddPlayer(const std::string& name, std::shared_ptr<GameSession> session) {
-        Token token = GetToken();
-        auto p = players_.emplace(token, std::make_shared<Player>(token, name, session));
-        if (p.second) {
-            return players_.at(token);
+        auto player = MakePlayer(name, session);
+        PublishPlayer(player);
+        return player;
+    }
+
+    std::shared_ptr<Player> RemovePlayer(const Token& token) {
+        auto player = players_.Erase(token);
+        if (player) {
+            version_.fetch_add(1, std::memory_order_relaxed);
         }
-        throw std::runtime_error("Failed to add player...");
+        return player;
     }
 
-    const std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher>& GetPlayersList() const {
-        return players_;
+    // Меняется при каждом входе и выходе игрока
+    uint64_t GetVersion() const {
+        return version_.load(std::memory_order_relaxed);
     }
-    
-    auto begin() {
-        return players_.begin();
+
+    // fn(const std::shared_ptr<Player>&)
+    template <typename Fn>
+    void ForEachPlayer(Fn&& fn) const {
+        players_.ForEach([&fn](const Token&, const std::shared_ptr<Player>& player) {
+            fn(player);
+        });
     }
 
-    auto end() {
-        return players_.end();
+    size_t Size() const {
+        return players_.Size();
     }
 
+    // Индекс, игроки и их строки. Собаки учитываются в сессиях
+    size_t MemoryUsage() const;
+
 private:
-    std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher> players_;
+    ConcurrentTokenMap<Token, std::shared_ptr<Player>, TokenHasher> players_;
+    std::atomic<uint64_t> version_{0};
 };
 
 }
\ No newline at end of file
@@ -1,76 +1,123 @@
 #include "model_game.h"
+#include "memory_stats.h"
 
 namespace model {
 
-void GameSession::UpdateDogsPosition(const double dt) {
-    const Map& map = GetMap();
-    for (auto dog : GetDogs()) {
-        //std::cout << "Searching for dog: " << dog->GetId() << " at map: " << map.GetName() << "..." << std::endl;
-        ParamPairDouble cur_dog_pos = dog->GetDogPosition();
-        //std::cout << "Found dog at coord: " << cur_dog_pos.x_ << ", " << cur_dog_pos.y_ << std::endl;
-        Point p_cur_dog_pos = {static_cast<Coord>(std::round(cur_dog_pos.x_)), static_cast<Coord>(std::round(cur_dog_pos.y_))};
-        //std::cout << "point for this coord {" << p_cur_dog_pos.x << ", " << p_cur_dog_pos.y << "}" << std::endl;
-        std::set<std::shared_ptr<Road>> roads_at_point = map.GetRoadsByCoords(p_cur_dog_pos);
-        //std::cout << "At this point there are " << roads_at_point.size() << " roads" << std::endl;
-        /*
-        if (!roads_at_point.empty()) {
-            //std::cout << "Roads at point " << cur_dog_pos.x_ << " " << cur_dog_pos.y_ << " are: " << std::endl;
-            for (auto road : roads_at_point) {
-                
-                std::cout << road << std::endl;
-                std::cout << "{" << road->GetStart().x << ", " << road->GetStart().y << "} - {" << road->GetEnd().x << ", " << road->GetEnd().y << "}" << std::endl;
-            }
-        }*/
-        auto dog_speed = dog->GetDogSpeed();
-        //std::cout << "dog speed is {" << dog_speed.x_ << ", " << dog_speed.y_ << "}" << std::endl;
-        auto new_dog_pos = cur_dog_pos + (dog_speed * dt);
-        if (CheckIfMovedProperly(roads_at_point, new_dog_pos)) {
-            dog->SetPosition(new_dog_pos);
-        } else {
-            std::cout << "Dog moved out of road" << std::endl;
-            SetMaxMoveForTick(roads_at_point, new_dog_pos);
-            dog->SetPosition(new_dog_pos);
+void GameSession::ApplyPendingActions() {
+    actions_.Drain([this](DogAction& action) {
+        Dog& dog = *action.dog;
+        // Собака могла уйти на покой, пока действие стояло в очереди
+        if (dog.session_index_ >= dogs_.size() || dogs_[dog.session_index_] != action.dog) {
+            return;
+        }
+        SetDogDirection(dog, action.dir);
+        if (action_observer_) {
+            action_observer_(dog, action.dir);
+        }
+    });
+}
+
+std::vector<RetiredDog> GameSession::UpdateDogsPosition(const double dt) {
+    ApplyPendingActions();
+    session_time_ += dt;
+    bool moved = false;
+    for (auto& dog : dogs_) {
+        if (!dog->IsMoving()) {
+            continue;
+        }
+        moved = true;
+        MarkActive(*dog);
+        RoadMove move = map_.MoveAlongRoads(dog->road_segment_, dog->GetDogPosition(), dog->GetDogSpeed() * dt);
+        dog->SetPosition(move.position);
+        dog->road_segment_ = move.segment;
+        if (grid_.Enabled()) {
+            grid_.Update(*dog);
+        }
+        if (move.stopped) {
             dog->ResetSpeed();
         }
     }
+    if (moved) {
+        ++state_version_;
+    }
+    return RetireIdleDogs();
 }
 
-bool CheckIfMovedProperly(std::set<std::shared_ptr<Road>>& roads, ParamPairDouble& new_pos) {
-    for (auto& road : roads) {
-        //std::cout << "point: {" << new_pos.x_ << ", " << new_pos.y_ << "} ";
-        //std::cout << "Road: x =" << road->GetRoadArea().left_bottom.x_ << "..." << road->GetRoadArea().right_top.x_;
-        //std::cout << " y =" << road->GetRoadArea().left_bottom.y_ << "..." << road->GetRoadArea().right_top.y_ << std::endl;
-        if (road->PointIsOnRoad(new_pos)) {
-            return true;
+std::vector<RetiredDog> GameSession::RetireIdleDogs() {
+    std::vector<RetiredDog> retired;
+    while (!idle_order_.empty()) {
+        Dog& dog = *idle_order_.front();
+        if (session_time_ - dog.last_active_time_ < dog_retirement_time_) {
+            break;
         }
+        retired.push_back({dogs_[dog.session_index_], session_time_ - dog.join_time_});
+        RemoveDog(dog);
+    }
+    return retired;
+}
+
+void GameSession::RemoveDog(Dog& dog) {
+    const size_t index = dog.session_index_;
+    idle_order_.erase(dog.idle_pos_);
+    if (grid_.Enabled()) {
+        grid_.Remove(dog);
+    }
+    if (index + 1 != dogs_.size()) {
+        dogs_[index] = std::move(dogs_.back());
+        dogs_[index]->session_index_ = index;
     }
-    return false;
+    dogs_.pop_back();
+    ++state_version_;
 }
 
-RoadArea CreateMaxMovingCoords(std::set<std::shared_ptr<Road>>& roads) {
-    ParamPairDouble min_c = roads.begin()->get()->GetRoadArea().left_bottom;
-    ParamPairDouble max_c = roads.begin()->get()->GetRoadArea().right_top;
-    for (auto& road : roads) {
-        if (min_c.x_ > road->GetRoadArea().left_bottom.x_) {min_c.x_ = road->GetRoadArea().left_bottom.x_;}
-        if (min_c.y_ > road->GetRoadArea().left_bottom.y_) {min_c.y_ = road->GetRoadArea().left_bottom.y_;}
-        if (max_c.x_ < road->GetRoadArea().right_top.x_) {max_c.x_ = road->GetRoadArea().right_top.x_;}
-        if (max_c.y_ < road->GetRoadArea().right_top.y_) {max_c.y_ = road->GetRoadArea().right_top.y_;}        
+size_t GameSession::MemoryUsage() const {
+    size_t bytes = sizeof(GameSession) + memory::VectorBytes(dogs_) + grid_.MemoryUsage()
+                 + idle_order_.size() * memory::LIST_NODE_BYTES<Dog*>;
+    for (const auto& dog : dogs_) {
+        bytes += memory::SHARED_BLOCK_BYTES<Dog> + memory::StringBytes(*dog->token_)
+               + memory::StringBytes(dog->dir_) + memory::VectorBytes(dog->visible_ids_);
     }
-    return {min_c, max_c};
+    return bytes;
 }
 
-void SetMaxMoveForTick(std::set<std::shared_ptr<Road>>& roads, ParamPairDouble& new_pos) {
-    RoadArea max_possible_coords = CreateMaxMovingCoords(roads);
-    if (new_pos.x_ < max_possible_coords.left_bottom.x_) {new_pos.x_ = max_possible_coords.left_bottom.x_;}
-    if (new_pos.y_ < max_possible_coords.left_bottom.y_) {new_pos.y_ = max_possible_coords.left_bottom.y_;}
-    if (new_pos.x_ > max_possible_coords.right_top.x_) {new_pos.x_ = max_possible_coords.right_top.x_;}
-    if (new_pos.y_ > max_possible_coords.right_top.y_) {new_pos.y_ = max_possible_coords.right_top.y_;}
+void GameSession::SetInterestCellSize(double cell_size) {
+    grid_ = cell_size > 0. ? SpatialGrid(map_.GetRoadBounds(), cell_size) : SpatialGrid();
+    if (grid_.Enabled()) {
+        for (auto& dog : dogs_) {
+            grid_.Insert(*dog);
+        }
+    }
+}
+
+void GameSession::CollectVisibleDogs(Dog& viewer, double radius, std::vector<const Dog*>& out) {
+    if (!grid_.Enabled() || radius <= 0.) {
+        out.reserve(out.size() + dogs_.size());
+        for (const auto& dog : dogs_) {
+            out.push_back(dog.get());
+        }
+        return;
+    }
+    const ParamPairDouble center = viewer.GetDogPosition();
+    const double keep_radius = radius * (1. + INTEREST_HYSTERESIS);
+    const std::vector<int>& was_visible = viewer.visible_ids_;
+    std::vector<int> visible;
+    visible.reserve(was_visible.size());
+    grid_.ForEachNear(center, keep_radius, [&](const Dog& dog) {
+        const double dx = dog.GetDogPosition().x_ - center.x_;
+        const double dy = dog.GetDogPosition().y_ - center.y_;
+        const double distance2 = dx * dx + dy * dy;
+        if (distance2 <= radius * radius ||
+            (distance2 <= keep_radius * keep_radius && std::binary_search(was_visible.begin(), was_visible.end(), dog.GetId()))) {
+            out.push_back(&dog);
+            visible.push_back(dog.GetId());
+        }
+    });
+    std::sort(visible.begin(), visible.end());
+    viewer.visible_ids_ = std::move(visible);
 }
 
 void Game::AddMap(Map map) {
-    //std::cout << "Point/road for this map is: " << std::endl;
-    //map.PrintCoordToRoad();
-    //std::cout << std::endl;
+    map.BuildRoadGraph();
     const size_t index = maps_.size();
     if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
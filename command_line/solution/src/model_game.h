@@ -1,67 +1,207 @@
 #pragma once
 
 #include <cmath>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <optional>
 
+#include "action_queue.h"
 #include "model_app.h"
 #include "model.h"
+#include "placement.h"
+#include "spatial_grid.h"
 
 namespace model {
 
-bool CheckIfMovedProperly(std::set<std::shared_ptr<Road>>& roads, ParamPairDouble& new_pos);
-void SetMaxMoveForTick(std::set<std::shared_ptr<Road>>& roads, ParamPairDouble& new_pos);
-RoadArea CreateMaxMovingCoords(std::set<std::shared_ptr<Road>>& roads);
+struct RetiredDog {
+    std::shared_ptr<Dog> dog;
+    double play_time;
+};
+
+// Состояние собаки, которое переживает перезапуск сервера (снимок и WAL)
+struct DogState {
+    ParamPairDouble position{0., 0.};
+    ParamPairDouble speed{0., 0.};
+    std::string dir;
+    int score = 0;
+    double join_time = 0.;
+    double last_active_time = 0.;
+};
+
+using ActionObserver = std::function<void(const Dog& dog, const std::string& dir)>;
 
 class GameSession {
     GameSession(const GameSession&) = delete;
     GameSession& operator=(const GameSession&) = delete;
 
 public:
-    explicit GameSession(const Map& map) :
-        map_(map) {}
+    GameSession(const Map& map, double dog_retirement_time) :
+        map_(map),
+        dog_retirement_time_(dog_retirement_time) {}
 
     const Map& GetMap() const {
         return map_;
     }
 
-    void AddDog(std::shared_ptr<Dog> dog, bool random_position) {
-        dog->SetPosition(map_.GetStartPosition(random_position));
+    void AddDog(std::shared_ptr<Dog> dog, bool random_position, auxillary::FastRandom& random = auxillary::ThreadRandom()) {
+        dog->SetPosition(map_.GetStartPosition(random_position, random));
+        dog->road_segment_ = map_.FindSegment(dog->GetDogPosition());
+        if (dog->road_segment_ == Map::NO_SEGMENT) {
+            throw std::logic_error("Dog start position is off road...");
+        }
         dog->SetDefaultSpeed(map_.GetMapDogSpeed());
-        dogs_.emplace_back(dog);
+        dog->session_index_ = dogs_.size();
+        dog->join_time_ = session_time_;
+        dog->last_active_time_ = session_time_;
+        dog->idle_pos_ = idle_order_.insert(idle_order_.end(), dog.get());
+        if (grid_.Enabled()) {
+            grid_.Insert(*dog);
+        }
+        dogs_.emplace_back(std::move(dog));
+        ++state_version_;
     }
 
-    void UpdateDogsPosition(const double dt);
+    // Собаки восстанавливаются в порядке последней активности, поэтому добавляются в конец очереди простоя
+    void RestoreDog(std::shared_ptr<Dog> dog, const DogState& state) {
+        dog->SetPosition(state.position);
+        dog->road_segment_ = map_.FindSegment(state.position);
+        if (dog->road_segment_ == Map::NO_SEGMENT) {
+            throw std::logic_error("Restored dog position is off road...");
+        }
+        dog->SetDefaultSpeed(map_.GetMapDogSpeed());
+        dog->dir_ = state.dir;
+        dog->dog_speed_ = state.speed;
+        dog->score_ = state.score;
+        dog->join_time_ = state.join_time;
+        dog->last_active_time_ = state.last_active_time;
+        session_time_ = std::max(session_time_, state.last_active_time);
+        dog->session_index_ = dogs_.size();
+        dog->idle_pos_ = idle_order_.insert(idle_order_.end(), dog.get());
+        if (grid_.Enabled()) {
+            grid_.Insert(*dog);
+        }
+        dogs_.emplace_back(std::move(dog));
+        ++state_version_;
+    }
 
-    const std::vector<std::shared_ptr<Dog>> GetDogs() {
-        std::vector<std::shared_ptr<Dog>> result;
-        result.reserve(dogs_.size());
+    // Убирает собаку, ушедшую на покой до сбоя (запись WAL)
+    void DropDog(Dog& dog) {
+        if (dog.session_index_ < dogs_.size() && dogs_[dog.session_index_].get() == &dog) {
+            RemoveDog(dog);
+        }
+    }
 
-        auto iter = dogs_.begin();
-        while (iter != dogs_.end()) {
-            if (iter->expired()) {
-                iter = dogs_.erase(iter);
-            } else {
-                result.push_back(iter->lock());
-                ++iter;
-            }
+    // fn(const Dog&) - от дольше всех бездействующей к самой активной
+    template <typename Fn>
+    void ForEachDogByActivity(Fn&& fn) const {
+        for (const Dog* dog : idle_order_) {
+            fn(*dog);
+        }
+    }
+
+    // Сетка для выборки собак вокруг игрока, ячейка не меньше cell_size. 0 - без сетки
+    void SetInterestCellSize(double cell_size);
+
+    // Собаки в радиусе radius от viewer. Уже видимая собака остаётся в выборке, пока не отойдёт
+    // дальше radius * (1 + INTEREST_HYSTERESIS), чтобы не мигать на границе. Без сетки - все собаки
+    void CollectVisibleDogs(Dog& viewer, double radius, std::vector<const Dog*>& out);
+
+    constexpr static double INTEREST_HYSTERESIS = 0.2;
+
+    double GetSessionTime() const {
+        return session_time_;
+    }
+
+    void RestoreSessionTime(double session_time) {
+        session_time_ = std::max(session_time_, session_time);
+    }
+
+    void SetDogDirection(Dog& dog, const std::string& dir) {
+        dog.SetDogDirection(dir);
+        MarkActive(dog);
+        ++state_version_;
+    }
+
+    // Меняется при любом изменении собак сессии, которое видно в /state: появление, уход,
+    // смена направления, движение. Пока версия та же, ответ /state любого игрока сессии тот же
+    uint64_t GetStateVersion() const {
+        return state_version_;
+    }
+
+    // Размер тела прошлого ответа /state игрока viewer, если с тех пор состояние не менялось
+    std::optional<size_t> GetCachedStateSize(const Dog& viewer, bool cbor) const {
+        if (viewer.state_size_version_ != state_version_ || viewer.state_sizes_[cbor] == 0) {
+            return std::nullopt;
+        }
+        return viewer.state_sizes_[cbor];
+    }
+
+    void CacheStateSize(Dog& viewer, bool cbor, size_t bytes) {
+        if (viewer.state_size_version_ != state_version_) {
+            viewer.state_size_version_ = state_version_;
+            viewer.state_sizes_ = {};
         }
-        return result;
+        viewer.state_sizes_[cbor] = bytes;
+    }
+
+    // Ставит действие в очередь сессии, можно вызывать из любого потока.
+    // Направление проверяется сразу, чтобы ошибка дошла до клиента
+    void EnqueueAction(std::shared_ptr<Dog> dog, std::string dir) {
+        if (!Dog::IsValidDirection(dir)) {
+            throw std::invalid_argument("Unknown direction...");
+        }
+        actions_.Push({std::move(dog), std::move(dir)});
+    }
+
+    // Применяет накопленные действия. Вызывается на strand игры перед тиком и чтением состояния
+    void ApplyPendingActions();
+
+    // Вызывается для каждого применённого действия в порядке применения (журнал событий)
+    void SetActionObserver(ActionObserver observer) {
+        action_observer_ = std::move(observer);
+    }
+
+    // Сдвигает собак на dt секунд и возвращает собак, простоявших дольше dog_retirement_time_
+    std::vector<RetiredDog> UpdateDogsPosition(const double dt);
 
+    const placement::HugeVector<std::shared_ptr<Dog>>& GetDogs() const {
+        return dogs_;
     }
 
+    // Собаки, индексы и сетка сессии. Обходит всех собак, вызывать на strand игры
+    size_t MemoryUsage() const;
+
     const std::shared_ptr<Dog> GetDog(const Token& token) const {
-        for (const auto& weak_dog : dogs_) {
-            if (auto dog = weak_dog.lock()) {
-                if (dog->GetToken() == token) {
-                    return dog;
-                }
+        for (const auto& dog : dogs_) {
+            if (dog->GetToken() == token) {
+                return dog;
             }
         }
         return nullptr;
     }
 
 private:
+    void MarkActive(Dog& dog) {
+        dog.last_active_time_ = session_time_;
+        idle_order_.splice(idle_order_.end(), idle_order_, dog.idle_pos_);
+    }
+
+    std::vector<RetiredDog> RetireIdleDogs();
+    void RemoveDog(Dog& dog);
+
     const Map& map_;
-    std::vector<std::weak_ptr<Dog>> dogs_;
+    // Собаки хранятся плотно: при удалении на место ушедшей переносится последняя
+    placement::HugeVector<std::shared_ptr<Dog>> dogs_;
+    // Собаки в порядке последней активности: в начале - дольше всех стоящие без движения
+    std::list<Dog*> idle_order_;
+    SpatialGrid grid_;
+    ActionQueue actions_;
+    ActionObserver action_observer_;
+    double session_time_ = 0.;
+    double dog_retirement_time_;
+    // С единицы: нулевая версия у собаки значит, что размер ответа ещё не запоминался
+    uint64_t state_version_ = 1;
 };
 
 class Game {
@@ -93,7 +233,9 @@ public:
             }
         }
 
-        auto game_session = std::make_shared<GameSession>(*map);
+        auto game_session = std::make_shared<GameSession>(*map, dog_retirement_time_);
+        game_session->SetActionObserver(action_observer_);
+        game_session->SetInterestCellSize(interest_cell_size_);
         //std::cout << "New session" << std::endl;
         game_sessions_.push_back(game_session);
 
@@ -108,10 +250,46 @@ public:
         return default_dog_speed_;
     }
 
-    void UpdateGame(const double dt) {
+    void SetDogRetirementTime(double seconds) {
+        dog_retirement_time_ = seconds;
+    }
+
+    double GetDogRetirementTime() const {
+        return dog_retirement_time_;
+    }
+
+    void ApplyPendingActions() {
+        for (auto& gs : game_sessions_) {
+            gs->ApplyPendingActions();
+        }
+    }
+
+    void SetActionObserver(ActionObserver observer) {
+        for (auto& gs : game_sessions_) {
+            gs->SetActionObserver(observer);
+        }
+        action_observer_ = std::move(observer);
+    }
+
+    void SetInterestCellSize(double cell_size) {
+        for (auto& gs : game_sessions_) {
+            gs->SetInterestCellSize(cell_size);
+        }
+        interest_cell_size_ = cell_size;
+    }
+
+    // Сессии в порядке создания
+    const std::vector<std::shared_ptr<GameSession>>& GetGameSessions() const noexcept {
+        return game_sessions_;
+    }
+
+    std::vector<RetiredDog> UpdateGame(const double dt) {
+        std::vector<RetiredDog> retired;
         for (auto& gs : game_sessions_) {
-            gs->UpdateDogsPosition(dt);
+            auto session_retired = gs->UpdateDogsPosition(dt);
+            std::move(session_retired.begin(), session_retired.end(), std::back_inserter(retired));
         }
+        return retired;
     }
 
     void PrintMaps() {
@@ -132,8 +310,11 @@ private:
     MapIdToIndex map_id_to_index_;
 
     std::vector<std::shared_ptr<GameSession>> game_sessions_;
+    ActionObserver action_observer_;
 
     double default_dog_speed_ = 1.;
+    double dog_retirement_time_ = 60.;
+    double interest_cell_size_ = 0.;
 
 };
 
@@ -0,0 +1,178 @@
+#include "placement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace placement {
+
+using namespace std::literals;
+
+namespace {
+
+std::atomic<HugePages> huge_pages{HugePages::OFF};
+
+size_t RoundToLargeBlock(size_t bytes) {
+    return (bytes + LARGE_BLOCK - 1) / LARGE_BLOCK * LARGE_BLOCK;
+}
+
+// Список ядер в формате sysfs: "0-7,16-23"
+std::vector<unsigned> ParseCpuList(const std::string& list) {
+    std::vector<unsigned> cpus;
+    std::istringstream input(list);
+    std::string range;
+    while (std::getline(input, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const unsigned first = std::stoul(range.substr(0, dash));
+        const unsigned last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+        for (unsigned cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+}  // namespace
+
+std::vector<unsigned> AllowedCpus() {
+    std::vector<unsigned> cpus;
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (::sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpuset)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+void PinThreadToCpu(unsigned cpu) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset); err != 0) {
+        std::cerr << "Failed to pin thread to core " << cpu << ": " << err << std::endl;
+    }
+#endif
+}
+
+void BindToNode(unsigned node) {
+#ifdef __linux__
+    const std::string path = "/sys/devices/system/node/node"s + std::to_string(node) + "/cpulist"s;
+    std::ifstream file(path);
+    std::string list;
+    if (!std::getline(file, list)) {
+        throw std::runtime_error("NUMA node "s + std::to_string(node) + " not found"s);
+    }
+    const std::vector<unsigned> cpus = ParseCpuList(list);
+    if (cpus.empty()) {
+        throw std::runtime_error("NUMA node "s + std::to_string(node) + " has no cpus"s);
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (unsigned cpu : cpus) {
+        CPU_SET(cpu, &cpuset);
+    }
+    if (::sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to bind to NUMA node cpus");
+    }
+    // MPOL_PREFERRED: память с узла node, а когда она кончится - с соседних. libnuma не нужна
+    constexpr int MPOL_PREFERRED = 1;
+    constexpr size_t MASK_BITS = 1024;
+    if (node >= MASK_BITS) {
+        throw std::runtime_error("NUMA node number is too large");
+    }
+    unsigned long mask[MASK_BITS / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MASK_BITS + 1) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to set NUMA memory policy");
+    }
+#else
+    throw std::runtime_error("NUMA binding is supported only on Linux");
+#endif
+}
+
+HugePages ParseHugePages(const std::string& mode) {
+    if (mode == "off") {
+        return HugePages::OFF;
+    } else if (mode == "transparent") {
+        return HugePages::TRANSPARENT;
+    } else if (mode == "explicit") {
+        return HugePages::EXPLICIT;
+    }
+    throw std::runtime_error("Unknown huge pages mode: "s + mode);
+}
+
+void SetHugePages(HugePages mode) {
+    huge_pages.store(mode, std::memory_order_relaxed);
+}
+
+void* AllocateLarge(size_t bytes) {
+#ifdef __linux__
+    const size_t length = RoundToLargeBlock(bytes);
+    const HugePages mode = huge_pages.load(std::memory_order_relaxed);
+    if (mode == HugePages::EXPLICIT) {
+        void* ptr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            return ptr;
+        }
+        // Пул hugetlbfs пуст или не настроен
+    }
+    // Прозрачная большая страница возможна только на выровненном участке: берём с запасом и обрезаем края
+    void* raw = ::mmap(nullptr, length + LARGE_BLOCK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (begin + LARGE_BLOCK - 1) / LARGE_BLOCK * LARGE_BLOCK;
+    if (aligned > begin) {
+        ::munmap(raw, aligned - begin);
+    }
+    ::munmap(reinterpret_cast<void*>(aligned + length), begin + LARGE_BLOCK - aligned);
+    void* ptr = reinterpret_cast<void*>(aligned);
+    if (mode != HugePages::OFF) {
+        ::madvise(ptr, length, MADV_HUGEPAGE);
+    }
+    return ptr;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+void FreeLarge(void* ptr, size_t bytes) noexcept {
+#ifdef __linux__
+    ::munmap(ptr, RoundToLargeBlock(bytes));
+#else
+    ::operator delete(ptr);
+#endif
+}
+
+}  // namespace placement
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+// Размещение потоков и памяти: привязка к ядрам, к узлу NUMA и большие страницы для крупных массивов
+namespace placement {
+
+// Ядра, на которых процессу разрешено работать (с учётом taskset и BindToNode)
+std::vector<unsigned> AllowedCpus();
+
+// Привязывает вызывающий поток к ядру. Ошибка не фатальна: поток продолжает работать без привязки
+void PinThreadToCpu(unsigned cpu);
+
+// Процесс работает только на ядрах узла node и берёт память с этого узла, пока она там есть.
+// Вызывать до запуска потоков: потоки наследуют привязку. Рассчитано на процесс-шард на узел
+void BindToNode(unsigned node);
+
+enum class HugePages {
+    OFF,
+    // Прозрачные большие страницы через madvise
+    TRANSPARENT,
+    // Заранее выделенные страницы hugetlbfs, без них - как TRANSPARENT
+    EXPLICIT,
+};
+
+HugePages ParseHugePages(const std::string& mode);
+
+// Действует на выделения, сделанные после вызова
+void SetHugePages(HugePages mode);
+
+// Блоки от LARGE_BLOCK берутся напрямую через mmap, меньшие - из обычной кучи
+constexpr size_t LARGE_BLOCK = 2 * 1024 * 1024;
+
+void* AllocateLarge(size_t bytes);
+void FreeLarge(void* ptr, size_t bytes) noexcept;
+
+// Аллокатор для больших плотных массивов (собаки сессии, сетка видимости): одна большая страница
+// вместо сотен обычных разгружает TLB при обходе массива на каждом тике
+template <typename T>
+class HugePageAllocator {
+public:
+    using value_type = T;
+
+    HugePageAllocator() noexcept = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        if (bytes >= LARGE_BLOCK) {
+            return static_cast<T*>(AllocateLarge(bytes));
+        }
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        const size_t bytes = n * sizeof(T);
+        if (bytes >= LARGE_BLOCK) {
+            FreeLarge(ptr, bytes);
+        } else {
+            ::operator delete(ptr, bytes, std::align_val_t(alignof(T)));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+template <typename T>
+using HugeVector = std::vector<T, HugePageAllocator<T>>;
+
+}  // namespace placement
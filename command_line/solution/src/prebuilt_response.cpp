@@ -0,0 +1,67 @@
+#include "prebuilt_response.h"
+
+#include <chrono>
+#include <ctime>
+
+namespace http_server {
+
+using namespace std::literals;
+
+PrebuiltBlock MakePrebuiltBlock(http::status status, std::string_view body,
+                                unsigned version, bool keep_alive,
+                                std::string_view content_type,
+                                std::string_view cache,
+                                std::string_view allow,
+                                std::string_view retry_after) {
+    PrebuiltBlock block{{}, {}, std::string(content_type), status, keep_alive};
+    std::string& head = block.head;
+    head.append(version == 10 ? "HTTP/1.0 "sv : "HTTP/1.1 "sv);
+    head.append(std::to_string(static_cast<unsigned>(status)));
+    head.push_back(' ');
+    head.append(http::obsolete_reason(status));
+    head.append("\r\nContent-Type: "sv).append(content_type);
+    head.append("\r\nContent-Length: "sv).append(std::to_string(body.size()));
+    if (!cache.empty()) {
+        head.append("\r\nCache-Control: "sv).append(cache);
+    }
+    if (!allow.empty()) {
+        head.append("\r\nAllow: "sv).append(allow);
+    }
+    if (!retry_after.empty()) {
+        head.append("\r\nRetry-After: "sv).append(retry_after);
+    }
+    // Как у beast: в HTTP/1.1 явно пишется только close, в HTTP/1.0 - только keep-alive
+    if (version == 10 && keep_alive) {
+        head.append("\r\nConnection: keep-alive"sv);
+    } else if (version != 10 && !keep_alive) {
+        head.append("\r\nConnection: close"sv);
+    }
+    head.append("\r\n"sv);
+
+    block.tail.reserve(2 + body.size());
+    block.tail.append("\r\n"sv).append(body);
+    return block;
+}
+
+const std::string& CachedDateLine() {
+    thread_local std::time_t cached_second = 0;
+    thread_local std::string line;
+    const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (now != cached_second) {
+        cached_second = now;
+        std::tm tm{};
+        gmtime_r(&now, &tm);
+        char buf[64];
+        const size_t size = std::strftime(buf, sizeof(buf), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        line.assign(buf, size);
+    }
+    return line;
+}
+
+std::string_view CachedDate() {
+    std::string_view line = CachedDateLine();
+    // Без "Date: " и завершающего CRLF
+    return line.substr(6, line.size() - 8);
+}
+
+}  // namespace http_server
@@ -0,0 +1,52 @@
+#pragma once
+
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/http/status.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace http_server {
+
+namespace http = boost::beast::http;
+
+// Готовый ответ целиком: статусная строка и заголовки (кроме Date) и тело
+// собраны один раз и пишутся в сокет из общего неизменяемого буфера
+struct PrebuiltBlock {
+    // Статусная строка и заголовки, каждый с завершающим CRLF
+    std::string head;
+    // Пустая строка-разделитель и тело
+    std::string tail;
+    std::string content_type;
+    http::status status;
+    bool keep_alive;
+};
+
+struct PrebuiltResponse {
+    std::shared_ptr<const PrebuiltBlock> block;
+
+    unsigned result_int() const {
+        return static_cast<unsigned>(block->status);
+    }
+
+    bool need_eof() const {
+        return !block->keep_alive;
+    }
+};
+
+PrebuiltBlock MakePrebuiltBlock(http::status status, std::string_view body,
+                                unsigned version, bool keep_alive,
+                                std::string_view content_type,
+                                std::string_view cache,
+                                std::string_view allow,
+                                std::string_view retry_after = {});
+
+// Строка "Date: ...\r\n" для текущей секунды. Пересобирается не чаще раза в секунду на поток
+const std::string& CachedDateLine();
+
+// Значение заголовка Date для текущей секунды
+std::string_view CachedDate();
+
+}  // namespace http_server
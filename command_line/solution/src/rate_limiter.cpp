@@ -0,0 +1,49 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+namespace http_handler {
+
+RateLimiter::RateLimiter(double rate, double burst, size_t slots) :
+    emission_interval_(rate > 0 ? static_cast<uint64_t>(1e6 / rate) : 0),
+    burst_tolerance_(rate > 0 ? static_cast<uint64_t>(std::max(burst - 1., 0.) * 1e6 / rate) : 0),
+    slot_mask_(std::bit_ceil(std::max<size_t>(slots, 1)) - 1),
+    slots_(std::make_unique<std::atomic<uint64_t>[]>(slot_mask_ + 1)) {
+}
+
+bool RateLimiter::TryAcquire(std::string_view key) {
+    return TryAcquire(std::hash<std::string_view>{}(key));
+}
+
+bool RateLimiter::TryAcquire(uint64_t key_hash) {
+    if (!Enabled()) {
+        return true;
+    }
+    // Младшие биты хэша выбирают слот, старшие служат отпечатком ключа
+    std::atomic<uint64_t>& slot = slots_[key_hash & slot_mask_];
+    const uint64_t tag = (key_hash >> TIME_BITS) << TIME_BITS;
+    const uint64_t now = NowMicros();
+
+    uint64_t current = slot.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t tat = now;
+        if ((current & ~TIME_MASK) == tag && current != 0) {
+            tat = std::max(current & TIME_MASK, now);
+        }
+        if (tat - now > burst_tolerance_) {
+            return false;
+        }
+        const uint64_t next = tag | ((tat + emission_interval_) & TIME_MASK);
+        if (slot.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+uint64_t RateLimiter::NowMicros() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+}  // namespace http_handler
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace http_handler {
+
+// Ограничитель частоты запросов по ключу (IP или токен) без блокировок.
+// Ведро токенов реализовано как GCRA: на ключ хранится одно 64-битное слово -
+// 16 бит отпечатка ключа и 48 бит "теоретического времени прихода" в микросекундах.
+// Таблица фиксированного размера: ключи, попавшие в один слот, вытесняют друг друга,
+// и вытесненный ключ начинает с полного ведра
+class RateLimiter {
+public:
+    // rate - запросов в секунду, burst - размер ведра. rate == 0 отключает ограничение
+    RateLimiter(double rate, double burst, size_t slots = DEFAULT_SLOTS);
+
+    bool Enabled() const {
+        return emission_interval_ > 0;
+    }
+
+    // true - запрос пропускается, false - ведро пусто
+    bool TryAcquire(std::string_view key);
+    bool TryAcquire(uint64_t key_hash);
+
+private:
+    constexpr static size_t DEFAULT_SLOTS = size_t{1} << 16;
+    constexpr static unsigned TIME_BITS = 48;
+    constexpr static uint64_t TIME_MASK = (uint64_t{1} << TIME_BITS) - 1;
+
+    uint64_t NowMicros() const;
+
+    const uint64_t emission_interval_;
+    const uint64_t burst_tolerance_;
+    const size_t slot_mask_;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+    const std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+};
+
+}  // namespace http_handler
@@ -0,0 +1,167 @@
+#include "records_store.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace records {
+
+using namespace std::literals;
+
+bool RecordsStore::IndexOrder::operator()(const IndexKey& l, const IndexKey& r) const {
+    if (l.record.score != r.record.score) {
+        return l.record.score > r.record.score;
+    }
+    if (l.record.play_time != r.record.play_time) {
+        return l.record.play_time < r.record.play_time;
+    }
+    if (l.record.name != r.record.name) {
+        return l.record.name < r.record.name;
+    }
+    return l.seq < r.seq;
+}
+
+RecordsStore::RecordsStore(std::filesystem::path path) :
+    path_(std::move(path)) {
+    if (!path_.empty()) {
+        LoadLog();
+        log_.open(path_, std::ios::binary | std::ios::app);
+        if (!log_.is_open()) {
+            throw std::runtime_error("Failed to open records file: "s + path_.string());
+        }
+    }
+    writer_ = std::jthread([this](std::stop_token stop) {
+        WriterLoop(stop);
+    });
+}
+
+RecordsStore::~RecordsStore() {
+    // Поток допишет всё, что уже стоит в очереди, и завершится
+    writer_.request_stop();
+    writer_.join();
+}
+
+void RecordsStore::Add(std::vector<Record> records) {
+    if (records.empty()) {
+        return;
+    }
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (pending_.empty()) {
+            pending_ = std::move(records);
+        } else {
+            std::move(records.begin(), records.end(), std::back_inserter(pending_));
+        }
+        ++enqueued_batches_;
+    }
+    queue_cv_.notify_one();
+}
+
+std::vector<Record> RecordsStore::GetRecords(size_t start, size_t max_items) const {
+    std::vector<Record> result;
+    std::shared_lock lock(index_mutex_);
+    if (start >= index_.size()) {
+        return result;
+    }
+#ifdef __GNUC__
+    auto it = index_.find_by_order(start);
+#else
+    auto it = std::next(index_.begin(), start);
+#endif
+    result.reserve(std::min(max_items, index_.size() - start));
+    for (; it != index_.end() && result.size() < max_items; ++it) {
+        result.push_back(it->record);
+    }
+    return result;
+}
+
+void RecordsStore::Flush() {
+    std::unique_lock lock(queue_mutex_);
+    const uint64_t target = enqueued_batches_;
+    flushed_cv_.wait(lock, [this, target] {
+        return written_batches_ >= target;
+    });
+}
+
+void RecordsStore::LoadLog() {
+    if (!std::filesystem::exists(path_)) {
+        return;
+    }
+    std::ifstream in(path_, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open records file: "s + path_.string());
+    }
+
+    std::vector<Record> loaded;
+    std::streamoff valid_size = 0;
+    while (true) {
+        uint32_t name_size;
+        Record record;
+        if (!in.read(reinterpret_cast<char*>(&name_size), sizeof(name_size))) {
+            break;
+        }
+        record.name.resize(name_size);
+        if (!in.read(record.name.data(), name_size)
+            || !in.read(reinterpret_cast<char*>(&record.score), sizeof(record.score))
+            || !in.read(reinterpret_cast<char*>(&record.play_time), sizeof(record.play_time))) {
+            break;
+        }
+        valid_size = in.tellg();
+        loaded.push_back(std::move(record));
+    }
+    in.close();
+
+    // Недописанная при аварии последняя запись отбрасывается
+    if (static_cast<std::uintmax_t>(valid_size) != std::filesystem::file_size(path_)) {
+        std::filesystem::resize_file(path_, valid_size);
+    }
+    IndexBatch(std::move(loaded));
+}
+
+void RecordsStore::WriterLoop(std::stop_token stop) {
+    while (true) {
+        std::vector<Record> batch;
+        uint64_t batch_mark;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_cv_.wait(lock, stop, [this] {
+                return !pending_.empty();
+            });
+            if (pending_.empty()) {
+                return;
+            }
+            batch.swap(pending_);
+            batch_mark = enqueued_batches_;
+        }
+        WriteBatch(batch);
+        IndexBatch(std::move(batch));
+        {
+            std::lock_guard lock(queue_mutex_);
+            written_batches_ = batch_mark;
+        }
+        flushed_cv_.notify_all();
+    }
+}
+
+void RecordsStore::WriteBatch(const std::vector<Record>& batch) {
+    if (!log_.is_open()) {
+        return;
+    }
+    for (const Record& record : batch) {
+        const uint32_t name_size = static_cast<uint32_t>(record.name.size());
+        log_.write(reinterpret_cast<const char*>(&name_size), sizeof(name_size));
+        log_.write(record.name.data(), name_size);
+        log_.write(reinterpret_cast<const char*>(&record.score), sizeof(record.score));
+        log_.write(reinterpret_cast<const char*>(&record.play_time), sizeof(record.play_time));
+    }
+    log_.flush();
+}
+
+void RecordsStore::IndexBatch(std::vector<Record>&& batch) {
+    std::unique_lock lock(index_mutex_);
+    for (Record& record : batch) {
+        index_.insert(IndexKey{std::move(record), next_seq_++});
+    }
+}
+
+}  // namespace records
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __GNUC__
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#else
+#include <set>
+#endif
+
+namespace records {
+
+struct Record {
+    std::string name;
+    int score = 0;
+    double play_time = 0.;  // секунды
+};
+
+// Хранилище ушедших на покой игроков: журнал только на дозапись + упорядоченный индекс в памяти.
+// Запись выполняет отдельный поток пачками, вызывающий (strand игры) только ставит записи в очередь.
+class RecordsStore {
+public:
+    // Пустой путь - хранилище только в памяти
+    explicit RecordsStore(std::filesystem::path path = {});
+    ~RecordsStore();
+
+    RecordsStore(const RecordsStore&) = delete;
+    RecordsStore& operator=(const RecordsStore&) = delete;
+
+    void Add(std::vector<Record> records);
+
+    // Страница таблицы рекордов за O(log n + max_items)
+    std::vector<Record> GetRecords(size_t start, size_t max_items) const;
+
+    // Дожидается, пока все поставленные записи попадут в журнал и индекс
+    void Flush();
+
+private:
+    // Порядок: больше очков, затем меньше время игры, затем по имени; seq различает одинаковые записи
+    struct IndexKey {
+        Record record;
+        uint64_t seq;
+    };
+
+    struct IndexOrder {
+        bool operator()(const IndexKey& l, const IndexKey& r) const;
+    };
+
+#ifdef __GNUC__
+    using Index = __gnu_pbds::tree<IndexKey, __gnu_pbds::null_type, IndexOrder,
+                                   __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update>;
+#else
+    using Index = std::set<IndexKey, IndexOrder>;
+#endif
+
+    void LoadLog();
+    void WriterLoop(std::stop_token stop);
+    void WriteBatch(const std::vector<Record>& batch);
+    void IndexBatch(std::vector<Record>&& batch);
+
+    const std::filesystem::path path_;
+    std::ofstream log_;
+
+    mutable std::shared_mutex index_mutex_;
+    Index index_;
+    uint64_t next_seq_ = 0;
+
+    std::mutex queue_mutex_;
+    std::condition_variable_any queue_cv_;
+    std::condition_variable_any flushed_cv_;
+    std::vector<Record> pending_;
+    uint64_t enqueued_batches_ = 0;
+    uint64_t written_batches_ = 0;
+
+    std::jthread writer_;
+};
+
+}  // namespace records
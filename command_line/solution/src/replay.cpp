@@ -0,0 +1,42 @@
+#include "replay.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace journal {
+
+using namespace std::literals;
+
+ReplayStats Replay(GameServer& gs, const std::filesystem::path& path) {
+    JournalReader reader(path);
+    ReplayStats stats;
+    // Id собак в журнале и при повторе могут не совпасть, действия адресуются по id из журнала
+    std::unordered_map<uint64_t, std::shared_ptr<model::Player>> players;
+
+    const auto start = std::chrono::steady_clock::now();
+    while (auto event = reader.Next()) {
+        if (auto* join = std::get_if<JoinEvent>(&*event)) {
+            players[join->dog_id] = gs.JoinGame(model::Map::Id{join->map_id}, join->user_name, join->spawn_seed, join->random_spawn);
+            ++stats.joins;
+        } else if (auto* action = std::get_if<ActionEvent>(&*event)) {
+            auto it = players.find(action->dog_id);
+            if (it == players.end()) {
+                throw std::runtime_error("Journal action refers to unknown dog "s + std::to_string(action->dog_id));
+            }
+            // Тот же путь, что и у запроса: очередь сессии и проверка, что собака ещё в игре
+            gs.SetPlayerDirection(*it->second, action->dir);
+            gs.ApplyPendingActions(*it->second);
+            ++stats.actions;
+        } else if (auto* tick = std::get_if<TickEvent>(&*event)) {
+            gs.Tick(tick->dt);
+            stats.simulated_seconds += tick->dt;
+            ++stats.ticks;
+        }
+    }
+    stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.state_hash = gs.StateHash();
+    return stats;
+}
+
+}  // namespace journal
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "game_server.h"
+
+#include <cstdint>
+#include <filesystem>
+
+namespace journal {
+
+struct ReplayStats {
+    uint64_t joins = 0;
+    uint64_t actions = 0;
+    uint64_t ticks = 0;
+    // Игровое время, прошедшее за все тики
+    double simulated_seconds = 0.;
+    double wall_seconds = 0.;
+    uint64_t state_hash = 0;
+};
+
+// Повторяет журнал на сервере с тем же конфигом без сети и таймеров, с максимальной скоростью.
+// Сервер должен быть только что создан: журнал пишется с начала работы процесса
+ReplayStats Replay(GameServer& gs, const std::filesystem::path& path);
+
+}  // namespace journal
@@ -2,7 +2,9 @@
 
 namespace http_handler {
 
-RequestData RequestParser(const std::string& req_target) {
+namespace {
+
+RequestData ParseTargetPath(const std::string& req_target) {
     //std::cout << "Request Parser Run: req_target = " << req_target << std::endl;
     if (req_target.find("/api") == 0) {
         size_t pos = req_target.find("/api/v1/");
@@ -14,26 +16,33 @@ RequestData RequestParser(const std::string& req_target) {
                 if (req_.find("maps/") == 0) {
                     req_ = req_.substr(next_slash_pos+1);
                     if (req_.find('/') == std::string::npos) {
-                        return {RequestType::API, std::string(req_)};
+                        return {RequestType::API, std::string(req_), {}};
                     } else {
                         throw std::logic_error("Invalid request (/api/v1/maps/id/?)"s);
                     }
                 }
+                if (req_.find("admin/") == 0) {
+                    req_ = req_.substr(next_slash_pos+1);
+                    if (req_.find('/') == std::string::npos) {
+                        return {RequestType::ADMIN, std::string(req_), {}};
+                    }
+                    throw std::logic_error("Invalid request (/api/v1/admin/***/?)"s);
+                }
                 if (req_.find("game/") == 0) {
                     req_ = req_.substr(next_slash_pos+1); 
                     if (req_.find('/') == std::string::npos) {
-                        return {RequestType::PLAYER, std::string(req_)};
+                        return {RequestType::PLAYER, std::string(req_), {}};
                     } else if (req_.find("player/") == 0) {
                         next_slash_pos = req_.find('/');
                         req_ = req_.substr(next_slash_pos+1);
-                        return {RequestType::PLAYER, std::string(req_)};
+                        return {RequestType::PLAYER, std::string(req_), {}};
                     } else {
                         throw std::logic_error("Invalid request (/api/v1/game/***/?)"s);
                     }
                 }
             } else {
                 if (req_ == "maps") {
-                    return {RequestType::API,std::string(req_)};
+                    return {RequestType::API,std::string(req_), {}};
                 } else {
                     throw std::logic_error("Invalid request (/api/v1/?)"s);
                 }
@@ -42,15 +51,27 @@ RequestData RequestParser(const std::string& req_target) {
             throw std::logic_error("Invalid request (/api/?)"s);
         }
     } else {
-        return {RequestType::FILE, req_target};
+        return {RequestType::FILE, req_target, {}};
     }
     throw std::logic_error("Invalid request (unhandled case)"s);
 }
 
+} // namespace
+
+RequestData RequestParser(const std::string& req_target) {
+    size_t query_pos = req_target.find('?');
+    RequestData rd = ParseTargetPath(req_target.substr(0, query_pos));
+    if (query_pos != std::string::npos) {
+        rd.query = req_target.substr(query_pos + 1);
+    }
+    return rd;
+}
+
 std::string toString(RequestType type) {
     switch (type) {
         case RequestType::API: return "API";
         case RequestType::PLAYER: return "PLAYER";
+        case RequestType::ADMIN: return "ADMIN";
         case RequestType::FILE: return "FILE";
         default: return "UNKNOWN";
     }
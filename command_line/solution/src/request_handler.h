@@ -9,11 +9,13 @@
 #include <boost/asio/strand.hpp>
 #include <boost/json.hpp>
 #include <filesystem>
+#include <atomic>
 #include <chrono>
 #include <variant>
 
 #include "api_handler.h"
 #include "http_server.h"
+#include "rate_limiter.h"
 
 namespace http_handler {
 
@@ -24,38 +26,102 @@ namespace net = boost::asio;
 namespace sys = boost::system;
 using tcp = net::ip::tcp;
 
-using ResponseVariant = std::variant<http::response<http::string_body>, http::response<http::file_body>>;
+using ResponseVariant = std::variant<http::response<http::string_body>, http::response<http::file_body>, http_server::PrebuiltResponse>;
 
 RequestData RequestParser(const std::string& req_target);
 std::string toString(RequestType type);
 
+// Ограничения нагрузки. Нулевое значение отключает соответствующую проверку
+struct Limits {
+    double ip_rate = 0.;
+    double ip_burst = 0.;
+    double token_rate = 0.;
+    double token_burst = 0.;
+    // Сколько запросов может ждать strand игры, прежде чем новые начнут отклоняться с 503
+    size_t max_strand_queue = 0;
+    // Адреса роутеров: у их запросов лимит по IP считается по X-Forwarded-For
+    std::vector<net::ip::address> trusted_proxies;
+};
+
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
-    explicit RequestHandler(net::io_context& ioc, GameServer& gs, net::strand<net::io_context::executor_type> api_strand) :
+    explicit RequestHandler(net::io_context& ioc, GameServer& gs, net::strand<net::io_context::executor_type> api_strand, const Limits& limits = {}) :
         ioc_(ioc),
         gs_(gs),
-        strand_(api_strand) {}
+        strand_(api_strand),
+        max_strand_queue_(limits.max_strand_queue),
+        trusted_proxies_(limits.trusted_proxies),
+        ip_limiter_(limits.ip_rate, limits.ip_burst),
+        token_limiter_(limits.token_rate, limits.token_burst) {}
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
     template <typename Body, typename Allocator, typename Send>
-    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {  
+    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, const net::ip::address& remote_address, Send&& send) {  
         try {
+            // Лимит по IP проверяется до разбора запроса и до постановки в strand: отказ почти бесплатен
+            if (!CheckIpLimit(req, remote_address)) {
+                return send(MakeStaticResponse(http::status::too_many_requests, Errors::RATE_LIMITED, req.version(), req.keep_alive(), ContentType::JSON, "no-cache"sv, ""sv, RETRY_AFTER));
+            }
             std::string req_target = std::string(req.target());
             RequestData r_data = RequestParser(auxillary::UrlDecode(req_target));
             //std::cout << "r_data parsed successfully: " << r_data.r_target << " " << toString(r_data.type) << std::endl;
             if (r_data.type != RequestType::FILE /*запрос к API*/) {
-                
                 auto req_ptr = std::make_shared<http::request<Body, http::basic_fields<Allocator>>>(std::move(req));
+                auto api_handler = std::make_shared<ApiHandler<Body,Allocator,Send>>(/*req*/ *req_ptr, gs_, std::move(r_data), &token_limiter_);
+                // Запросы карт не занимают strand игры. Тело, которое ещё строит пул, не ждём и на потоке
+                // ввода-вывода: ответ соберётся в io_context, когда пул его достроит
+                if (!api_handler->RequiresGameStrand()) {
+                    auto respond = [req_ptr, api_handler, send] {
+                        std::visit([&send](auto&& result) {
+                            send(std::forward<decltype(result)>(result));
+                        }, api_handler->HandleRequest());
+                    };
+                    if (api_handler->DeferUntilMapReady([&ioc = ioc_, respond] {
+                        net::post(ioc, respond);
+                    })) {
+                        return;
+                    }
+                    return respond();
+                }
+                if (max_strand_queue_ > 0 && strand_queue_depth_.load(std::memory_order_relaxed) >= max_strand_queue_) {
+                    return send(MakeStaticResponse(http::status::service_unavailable, Errors::OVERLOADED, req_ptr->version(), req_ptr->keep_alive(), ContentType::JSON, "no-cache"sv, ""sv, RETRY_AFTER));
+                }
+                // Неизвестный токен отклоняется на потоке ввода-вывода, не занимая strand
+                if (auto rejection = api_handler->PreAuthorize()) {
+                    return std::visit([&send](auto&& result) {
+                        send(std::forward<decltype(result)>(result));
+                    }, std::move(*rejection));
+                }
+                if (const model::Player* player = api_handler->AuthorizedPlayer(); player && !CheckTokenLimit(*player)) {
+                    return send(MakeStaticResponse(http::status::too_many_requests, Errors::RATE_LIMITED, req_ptr->version(), req_ptr->keep_alive(), ContentType::JSON, "no-cache"sv, ""sv, RETRY_AFTER));
+                }
 
-                return boost::asio::dispatch(strand_, [self = shared_from_this(),
-                                                        api_handler = std::make_shared<ApiHandler<Body,Allocator,Send>>(/*req*/ *req_ptr, gs_, r_data), 
-                                                        send = std::move(send)] {
+                strand_queue_depth_.fetch_add(1, std::memory_order_relaxed);
+                return boost::asio::dispatch(strand_, [self = shared_from_this(), req_ptr, api_handler, send = std::move(send)] {
+                    self->strand_queue_depth_.fetch_sub(1, std::memory_order_relaxed);
                     // Этот assert не выстрелит, так как лямбда-функция будет выполняться внутри strand
                     //auto api_handler = std::make_shared<ApiHandler<Body,Allocator,Send>>(*req_ptr, self->gs_, r_data);
                     assert(self->strand_.running_in_this_thread());
-                    send(api_handler->HandleRequest());
+                    if (api_handler->RequiresDurability()) {
+                        // WhenDurable может позвать продолжение на потоке WAL: ответ отправляется из strand,
+                        // как и все остальные ответы API. Вход, который не удалось сохранить, не подтверждается
+                        auto result = std::make_shared<ApiResponse>(api_handler->HandleRequest());
+                        return self->gs_.WhenDurable([self, result, send, version = req_ptr->version(), keep_alive = req_ptr->keep_alive()](bool durable) {
+                            net::dispatch(self->strand_, [result, send, durable, version, keep_alive] {
+                                if (!durable) {
+                                    return send(MakeStaticResponse(http::status::service_unavailable, Errors::STATE_NOT_SAVED, version, keep_alive, ContentType::JSON, "no-cache"sv));
+                                }
+                                std::visit([&send](auto&& response) {
+                                    send(std::forward<decltype(response)>(response));
+                                }, std::move(*result));
+                            });
+                        });
+                    }
+                    std::visit([&send](auto&& result) {
+                        send(std::forward<decltype(result)>(result));
+                    }, api_handler->HandleRequest());
                 });
                 return;
                 /*
@@ -88,10 +154,10 @@ public:
             filepath = filepath / "index.html";
         }
         if (!auxillary::IsSubPath(root, filepath)) {
-            return MakeResponse(http::status::bad_request, "Bad Request: Requested file is outside of the root directory"sv, req.version(), req.keep_alive(), ContentType::PLAIN);
+            return MakeStaticResponse(http::status::bad_request, "Bad Request: Requested file is outside of the root directory"sv, req.version(), req.keep_alive(), ContentType::PLAIN);
         }
         if (!fs::exists(filepath) || !fs::is_regular_file(filepath)) {
-            return MakeResponse(http::status::not_found, "Bad Request: Requested file not found"sv, req.version(), req.keep_alive(), ContentType::PLAIN);
+            return MakeStaticResponse(http::status::not_found, "Bad Request: Requested file not found"sv, req.version(), req.keep_alive(), ContentType::PLAIN);
         }
 
         http::file_body::value_type file;
@@ -108,12 +174,75 @@ public:
     
 
 private:
+    constexpr static std::string_view RETRY_AFTER = "1"sv;
+
+    template <typename Body, typename Allocator>
+    bool CheckIpLimit(const http::request<Body, http::basic_fields<Allocator>>& req, const net::ip::address& remote_address) {
+        if (!ip_limiter_.Enabled()) {
+            return true;
+        }
+        const net::ip::address client = ClientAddress(req, remote_address);
+        if (client.is_v4()) {
+            const auto bytes = client.to_v4().to_bytes();
+            return ip_limiter_.TryAcquire(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+        }
+        const auto bytes = client.to_v6().to_bytes();
+        return ip_limiter_.TryAcquire(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+    }
+
+    // Ключ - токен уже найденного игрока. Выдуманные токены отклоняются раньше и не вытесняют
+    // из таблицы ограничителя ведра настоящих игроков
+    bool CheckTokenLimit(const model::Player& player) {
+        return !token_limiter_.Enabled() || token_limiter_.TryAcquire(*player.GetPlayerToken());
+    }
+
+    // Доверенный прокси дописывает адрес своего клиента последним в X-Forwarded-For.
+    // Заголовку от остальных не верим: клиент обошёл бы лимит, подставив чужой адрес
+    template <typename Body, typename Allocator>
+    net::ip::address ClientAddress(const http::request<Body, http::basic_fields<Allocator>>& req, const net::ip::address& remote_address) const {
+        if (std::find(trusted_proxies_.begin(), trusted_proxies_.end(), remote_address) == trusted_proxies_.end()) {
+            return remote_address;
+        }
+        auto it = req.find("X-Forwarded-For"sv);
+        if (it == req.end()) {
+            return remote_address;
+        }
+        std::string_view forwarded = it->value();
+        if (size_t comma = forwarded.rfind(','); comma != std::string_view::npos) {
+            forwarded.remove_prefix(comma + 1);
+        }
+        while (!forwarded.empty() && forwarded.front() == ' ') {
+            forwarded.remove_prefix(1);
+        }
+        sys::error_code ec;
+        net::ip::address client = net::ip::make_address(forwarded, ec);
+        return ec ? remote_address : client;
+    }
+
     net::io_context& ioc_;
     GameServer& gs_;
     net::strand<net::io_context::executor_type> strand_;
 
+    const size_t max_strand_queue_;
+    const std::vector<net::ip::address> trusted_proxies_;
+    // Запросы, отправленные в strand игры и ещё не начавшие выполняться
+    std::atomic<size_t> strand_queue_depth_{0};
+    RateLimiter ip_limiter_;
+    RateLimiter token_limiter_;
+
 };
 
+// У 304 Not Modified нет Content-Type
+template <typename Response>
+std::string_view ResponseContentType(const Response& response) {
+    auto it = response.find(http::field::content_type);
+    return it == response.end() ? std::string_view{} : it->value();
+}
+
+inline std::string_view ResponseContentType(const http_server::PrebuiltResponse& response) {
+    return response.block->content_type;
+}
+
 template <typename RequestHandler>
 class LoggingRequestHandler {
 public:
@@ -121,38 +250,28 @@ public:
         decorated_(handler) {}
     
     template <typename Body, typename Allocator, typename Send>
-    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
-
-        std::chrono::high_resolution_clock timer;
-        auto start_time = timer.now();
+    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, const net::ip::address& remote_address, Send&& send) {
 
-        LogRequest(req);
-        std::string content_type = "null";
-        int code_result;
+        const auto start_time = std::chrono::steady_clock::now();
 
-        auto req_ptr = std::make_shared<http::request<Body, http::basic_fields<Allocator>>>(std::move(req));
+        LogRequest(req, remote_address);
 
-        decorated_(/*std::move(req)*/ std::move(*req_ptr), [s = std::move(send), &content_type, &code_result](auto&& response){
-            code_result = response.result_int();
-            content_type = static_cast<std::string>(response.at(http::field::content_type));
-            s(response);
+        // Ответ может уйти уже после выхода из operator() (strand игры, ожидание WAL),
+        // поэтому он логируется в самом send, а не после вызова обработчика
+        decorated_(std::move(req), remote_address, [s = std::move(send), start_time](auto&& response) {
+            const auto dtime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+            LogResponse(dtime, response.result_int(), static_cast<std::string>(ResponseContentType(response)));
+            s(std::forward<decltype(response)>(response));
         });
-        auto stop_time = timer.now();
-        auto dtime = std::chrono::duration_cast<std::chrono::microseconds>(stop_time - start_time).count();
-        LogResponse(dtime, code_result, content_type);
-        return;
     }
 
 private:
     RequestHandler& decorated_;
 
     template <typename Body, typename Allocator>
-    static void LogRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        std::string host = static_cast<std::string>(req.at(http::field::host));
-        host = host.substr(0, host.rfind(':'));
-
+    static void LogRequest(http::request<Body, http::basic_fields<Allocator>>& req, const net::ip::address& remote_address) {
         boost::json::object obj{
-            {"ip", host},
+            {"ip", remote_address.to_string()},
             {"URI", req.target()},
             {"method", req.method_string()}};
         BOOST_LOG_TRIVIAL(info) << boost::log::add_value(additional_data, obj) << "request received"sv;
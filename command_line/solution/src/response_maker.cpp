@@ -1,7 +1,43 @@
 #include "response_maker.h"
 
+#include <boost/container_hash/hash.hpp>
+
+#include <unordered_map>
+
 namespace http_handler {
 
+namespace {
+
+struct PrebuiltKey {
+    const char* text;
+    const char* content_type;
+    const char* cache;
+    const char* allow;
+    const char* retry_after;
+    http::status status;
+    unsigned version;
+    bool keep_alive;
+
+    bool operator==(const PrebuiltKey&) const = default;
+};
+
+struct PrebuiltKeyHasher {
+    size_t operator()(const PrebuiltKey& key) const {
+        size_t seed = 0;
+        boost::hash_combine(seed, key.text);
+        boost::hash_combine(seed, key.content_type);
+        boost::hash_combine(seed, key.cache);
+        boost::hash_combine(seed, key.allow);
+        boost::hash_combine(seed, key.retry_after);
+        boost::hash_combine(seed, static_cast<unsigned>(key.status));
+        boost::hash_combine(seed, key.version);
+        boost::hash_combine(seed, key.keep_alive);
+        return seed;
+    }
+};
+
+}  // namespace
+
 http::response<http::string_body> MakeResponse(http::status status, std::string_view text, 
                                     unsigned version, bool keep_alive, 
                                     std::string_view content_type,
@@ -10,6 +46,7 @@ http::response<http::string_body> MakeResponse(http::status status, std::string_
 
     http::response<http::string_body> response(status, version);
     response.set(http::field::content_type, content_type);
+    response.set(http::field::date, http_server::CachedDate());
     response.body() = text;
     response.prepare_payload();
     response.keep_alive(keep_alive);
@@ -22,12 +59,52 @@ http::response<http::string_body> MakeResponse(http::status status, std::string_
     return response;
 }
 
+http::response<http::string_body> MakeResponse(http::status status, std::string&& body,
+                                    unsigned version, bool keep_alive,
+                                    std::string_view content_type,
+                                    std::string_view cache,
+                                    std::string_view allow) {
+
+    http::response<http::string_body> response(status, version);
+    response.set(http::field::content_type, content_type);
+    response.set(http::field::date, http_server::CachedDate());
+    response.body() = std::move(body);
+    response.prepare_payload();
+    response.keep_alive(keep_alive);
+    if (!cache.empty()) {
+        response.set(http::field::cache_control, cache);
+    }
+    if (!allow.empty()) {
+        response.set(http::field::allow, allow);
+    }
+    return response;
+}
+
+http_server::PrebuiltResponse MakeStaticResponse(http::status status, std::string_view text,
+                                    unsigned version, bool keep_alive,
+                                    std::string_view content_type,
+                                    std::string_view cache,
+                                    std::string_view allow,
+                                    std::string_view retry_after) {
+    // Кэш на поток: поиск без блокировок, набор ключей конечен (константы x версия x keep-alive)
+    thread_local std::unordered_map<PrebuiltKey, http_server::PrebuiltResponse, PrebuiltKeyHasher> cache_by_key;
+    const PrebuiltKey key{text.data(), content_type.data(), cache.data(), allow.data(), retry_after.data(), status, version, keep_alive};
+    auto it = cache_by_key.find(key);
+    if (it == cache_by_key.end()) {
+        auto block = std::make_shared<const http_server::PrebuiltBlock>(
+            http_server::MakePrebuiltBlock(status, text, version, keep_alive, content_type, cache, allow, retry_after));
+        it = cache_by_key.emplace(key, http_server::PrebuiltResponse{std::move(block)}).first;
+    }
+    return it->second;
+}
+
 http::response<http::file_body> MakeResponse(http::status status, http::file_body::value_type& file, 
                                     unsigned version,
                                     bool keep_alive,
                                     std::string_view content_type, std::string_view cache_control) {
     http::response<http::file_body> response(status, version);
     response.set(http::field::content_type, content_type);
+    response.set(http::field::date, http_server::CachedDate());
     response.body() = std::move(file);
     response.prepare_payload();
     response.keep_alive(keep_alive);
@@ -4,8 +4,10 @@
 
 #include <boost/beast/http.hpp>
 
+#include <string>
 #include <string_view>
 #include "aux.h"
+#include "prebuilt_response.h"
 
 namespace http_handler {
 
@@ -18,6 +20,23 @@ http::response<http::string_body> MakeResponse(http::status status, std::string_
                                     std::string_view cache = ""sv,
                                     std::string_view allow = ""sv);
 
+// Тело уже собрано в строку - перемещается в ответ без копирования
+http::response<http::string_body> MakeResponse(http::status status, std::string&& body,
+                                    unsigned version, bool keep_alive,
+                                    std::string_view content_type,
+                                    std::string_view cache = ""sv,
+                                    std::string_view allow = ""sv);
+
+// Ответ с постоянным текстом (Errors::*, пустой объект и т.п.). Собирается один раз на поток и дальше
+// раздаётся из общего буфера. Все строки должны жить всё время работы программы:
+// кэш различает их по адресу, а не по содержимому
+http_server::PrebuiltResponse MakeStaticResponse(http::status status, std::string_view text,
+                                    unsigned version, bool keep_alive,
+                                    std::string_view content_type = ContentType::JSON,
+                                    std::string_view cache = ""sv,
+                                    std::string_view allow = ""sv,
+                                    std::string_view retry_after = ""sv);
+
 http::response<http::file_body> MakeResponse(http::status status, http::file_body::value_type& file, 
                                     unsigned version,
                                     bool keep_alive,
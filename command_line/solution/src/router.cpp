@@ -0,0 +1,338 @@
+#include "router.h"
+#include "sharding.h"
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace router {
+
+namespace json = boost::json;
+
+namespace {
+
+constexpr std::string_view GAME_PREFIX = "/api/v1/game/"sv;
+// Страница /records, больше которой сервер не отдаёт
+constexpr size_t MAX_RECORDS_PAGE = 100;
+// Каждая сотня рекордов глубины - ещё один запрос к каждому шарду
+constexpr size_t MAX_MERGED_RECORDS = 10000;
+
+std::optional<std::string_view> BearerToken(const Request& request) {
+    auto it = request.find(http::field::authorization);
+    if (it == request.end()) {
+        return std::nullopt;
+    }
+    std::string_view value = it->value();
+    constexpr std::string_view BEARER = "Bearer "sv;
+    if (!value.starts_with(BEARER)) {
+        return std::nullopt;
+    }
+    return value.substr(BEARER.size());
+}
+
+// Тело входа в игру: {"userName": ..., "mapId": ...}
+std::optional<std::string> JoinMapId(const Request& request) {
+    try {
+        json::value body = json::parse(request.body());
+        return std::string(body.as_object().at("mapId").as_string());
+    } catch (...) {
+        return std::nullopt;
+    }
+}
+
+// Индексы действий пачки по шардам их токенов. Действие с токеном без номера шарда отклонит
+// любой процесс, оно уходит с первой группой. nullopt - тело не разобрано, его отклонит сервер
+std::optional<std::map<unsigned, std::vector<size_t>>> SplitActions(const json::array& actions, unsigned shard_count) {
+    std::map<unsigned, std::vector<size_t>> groups;
+    std::vector<size_t> unknown;
+    try {
+        for (size_t i = 0; i < actions.size(); ++i) {
+            auto shard = sharding::TokenShard(actions[i].as_object().at("token").as_string());
+            if (shard && *shard < shard_count) {
+                groups[*shard].push_back(i);
+            } else {
+                unknown.push_back(i);
+            }
+        }
+    } catch (...) {
+        return std::nullopt;
+    }
+    if (!groups.empty()) {
+        auto& first = groups.begin()->second;
+        first.insert(first.end(), unknown.begin(), unknown.end());
+    }
+    return groups;
+}
+
+// Порядок таблицы рекордов сервера: очки по убыванию, затем время игры и имя
+bool RecordBefore(const json::object& l, const json::object& r) {
+    const auto l_score = l.at("score").to_number<int64_t>();
+    const auto r_score = r.at("score").to_number<int64_t>();
+    if (l_score != r_score) {
+        return l_score > r_score;
+    }
+    const double l_time = l.at("playTime").to_number<double>();
+    const double r_time = r.at("playTime").to_number<double>();
+    if (l_time != r_time) {
+        return l_time < r_time;
+    }
+    return std::string_view(l.at("name").as_string()) < std::string_view(r.at("name").as_string());
+}
+
+// Ответы частей запроса, разосланного нескольким шардам
+struct GatherState {
+    std::mutex mutex;
+    size_t pending;
+    beast::error_code ec;
+    std::vector<std::optional<Response>> responses;
+    UpstreamPool::Callback callback;
+};
+
+}  // namespace
+
+Router::Router(net::io_context& ioc, const std::vector<std::string>& upstreams, size_t max_idle, std::chrono::milliseconds timeout) {
+    if (upstreams.empty()) {
+        throw std::invalid_argument("At least one upstream game server is required");
+    }
+    if (upstreams.size() > sharding::MAX_SHARDS) {
+        throw std::invalid_argument("Too many upstream game servers");
+    }
+    for (const std::string& address : upstreams) {
+        pools_.push_back(std::make_shared<UpstreamPool>(ioc, address, max_idle, timeout));
+    }
+}
+
+Route Router::RouteRequest(const Request& request) {
+    std::string_view path = request.target();
+    path = path.substr(0, path.find('?'));
+    const unsigned shard_count = static_cast<unsigned>(pools_.size());
+
+    if (!path.starts_with(GAME_PREFIX)) {
+        // Карты и статика одинаковы на всех шардах
+        return {NextShard()};
+    }
+    const std::string_view endpoint = path.substr(GAME_PREFIX.size());
+    if (endpoint == "tick"sv) {
+        return {std::nullopt};
+    }
+    if (endpoint == "join"sv) {
+        if (auto map_id = JoinMapId(request)) {
+            return {sharding::MapShard(*map_id, shard_count)};
+        }
+        return {NextShard()};
+    }
+    // Таблица рекордов у каждого шарда своя, страница собирается из всех
+    if (endpoint == "records"sv) {
+        if (shard_count == 1) {
+            return {0u};
+        }
+        return {std::nullopt, Merge::RECORDS};
+    }
+    if (endpoint == "actions"sv) {
+        std::optional<std::map<unsigned, std::vector<size_t>>> groups;
+        try {
+            groups = SplitActions(json::parse(request.body()).as_array(), shard_count);
+        } catch (...) {
+        }
+        // Неразобранную или пустую пачку сервер отклонит сам
+        if (!groups || groups->empty()) {
+            return {NextShard()};
+        }
+        if (groups->size() == 1) {
+            return {groups->begin()->first};
+        }
+        return {std::nullopt, Merge::ACTIONS};
+    }
+    if (auto token = BearerToken(request)) {
+        // Токен с чужим номером шарда всё равно отправляется серверу - он и ответит 401
+        if (auto shard = sharding::TokenShard(*token); shard && *shard < shard_count) {
+            return {*shard};
+        }
+    }
+    return {NextShard()};
+}
+
+void Router::Forward(Request&& request, const Route& route, UpstreamPool::Callback&& callback) {
+    if (route.shard) {
+        return pools_[*route.shard]->Forward(std::move(request), std::move(callback));
+    }
+    if (route.merge == Merge::RECORDS) {
+        return ForwardRecords(std::move(request), std::move(callback));
+    }
+    if (route.merge == Merge::ACTIONS) {
+        return ForwardActions(std::move(request), std::move(callback));
+    }
+    std::vector<std::pair<unsigned, Request>> parts;
+    for (unsigned shard = 0; shard < pools_.size(); ++shard) {
+        parts.emplace_back(shard, request);
+    }
+    Gather(std::move(parts), [](std::vector<Response>&& responses) {
+        return std::move(responses.front());
+    }, std::move(callback));
+}
+
+// Каждый шард отдаёт страницами сервера свои первые start + maxItems рекордов, роутер сливает их
+// и вырезает запрошенную страницу. Глубже MAX_MERGED_RECORDS таблица не листается
+void Router::ForwardRecords(Request&& request, UpstreamPool::Callback&& callback) {
+    const std::string_view target = request.target();
+    const size_t query_pos = target.find('?');
+    const std::string path(target.substr(0, query_pos));
+    size_t start = 0;
+    size_t max_items = MAX_RECORDS_PAGE;
+    bool valid = request.method() == http::verb::get || request.method() == http::verb::head;
+    try {
+        auto params = auxillary::ParseQuery(query_pos == std::string_view::npos ? ""sv : target.substr(query_pos + 1));
+        if (auto it = params.find("start"); it != params.end()) {
+            start = std::stoul(it->second);
+        }
+        if (auto it = params.find("maxItems"); it != params.end()) {
+            max_items = std::stoul(it->second);
+        }
+    } catch (...) {
+        valid = false;
+    }
+    // Ошибочный запрос и пустую страницу сервер обработает сам
+    if (!valid || max_items == 0 || max_items > MAX_RECORDS_PAGE) {
+        return pools_[0]->Forward(std::move(request), std::move(callback));
+    }
+    if (start > MAX_MERGED_RECORDS - max_items) {
+        return callback({}, http_handler::MakeResponse(http::status::bad_request, http_handler::Errors::RECORDS_PARAMS, request.version(), request.keep_alive(), http_handler::ContentType::JSON, "no-cache"sv));
+    }
+    const size_t depth = start + max_items;
+    const bool head = request.method() == http::verb::head;
+
+    std::vector<std::pair<unsigned, Request>> parts;
+    for (unsigned shard = 0; shard < pools_.size(); ++shard) {
+        for (size_t offset = 0; offset < depth; offset += MAX_RECORDS_PAGE) {
+            Request part{request.base()};
+            part.method(http::verb::get);
+            part.target(path + "?start="s + std::to_string(offset) + "&maxItems="s + std::to_string(std::min(MAX_RECORDS_PAGE, depth - offset)));
+            part.prepare_payload();
+            parts.emplace_back(shard, std::move(part));
+        }
+    }
+    Gather(std::move(parts), [start, max_items, head](std::vector<Response>&& responses) {
+        std::vector<json::object> records;
+        for (const Response& response : responses) {
+            json::value page = json::parse(response.body());
+            for (json::value& record : page.as_array()) {
+                records.push_back(std::move(record.as_object()));
+            }
+        }
+        std::stable_sort(records.begin(), records.end(), RecordBefore);
+        json::array result;
+        for (size_t i = start; i < records.size() && i < start + max_items; ++i) {
+            result.push_back(std::move(records[i]));
+        }
+        Response response = std::move(responses.front());
+        response.body() = json::serialize(result);
+        response.prepare_payload();
+        // На HEAD - только длина склеенной страницы
+        if (head) {
+            const size_t size = response.body().size();
+            response.body().clear();
+            response.content_length(size);
+        }
+        return response;
+    }, std::move(callback));
+}
+
+// Пачка делится на пачки шардов с сохранением порядка действий. Номера отклонённых действий
+// переводятся обратно в номера исходной пачки
+void Router::ForwardActions(Request&& request, UpstreamPool::Callback&& callback) {
+    json::array actions;
+    std::map<unsigned, std::vector<size_t>> groups;
+    try {
+        actions = std::move(json::parse(request.body()).as_array());
+        groups = SplitActions(actions, static_cast<unsigned>(pools_.size())).value();
+    } catch (...) {
+        return pools_[NextShard()]->Forward(std::move(request), std::move(callback));
+    }
+
+    std::vector<std::pair<unsigned, Request>> parts;
+    std::vector<std::vector<size_t>> indices;
+    for (auto& [shard, group] : groups) {
+        json::array batch;
+        for (size_t i : group) {
+            batch.push_back(actions[i]);
+        }
+        Request part{request.base()};
+        part.body() = json::serialize(batch);
+        part.prepare_payload();
+        parts.emplace_back(shard, std::move(part));
+        indices.push_back(std::move(group));
+    }
+    Gather(std::move(parts), [indices = std::move(indices)](std::vector<Response>&& responses) {
+        int64_t accepted = 0;
+        std::vector<size_t> rejected;
+        for (size_t part = 0; part < responses.size(); ++part) {
+            json::value parsed = json::parse(responses[part].body());
+            const json::object& result = parsed.as_object();
+            accepted += result.at("accepted").to_number<int64_t>();
+            for (const json::value& index : result.at("rejected").as_array()) {
+                rejected.push_back(indices[part].at(index.to_number<size_t>()));
+            }
+        }
+        std::sort(rejected.begin(), rejected.end());
+        json::array rejected_json;
+        for (size_t index : rejected) {
+            rejected_json.emplace_back(index);
+        }
+        Response response = std::move(responses.front());
+        response.body() = json::serialize(json::object{{"accepted", accepted}, {"rejected", std::move(rejected_json)}});
+        response.prepare_payload();
+        return response;
+    }, std::move(callback));
+}
+
+void Router::Gather(std::vector<std::pair<unsigned, Request>>&& parts, Merger&& merge, UpstreamPool::Callback&& callback) {
+    auto state = std::make_shared<GatherState>();
+    state->pending = parts.size();
+    state->responses.resize(parts.size());
+    state->callback = std::move(callback);
+    auto finish = [state, merge = std::move(merge)] {
+        if (state->ec) {
+            return state->callback(state->ec, {});
+        }
+        std::vector<Response> responses;
+        for (auto& response : state->responses) {
+            if (response->result() != http::status::ok) {
+                return state->callback({}, std::move(*response));
+            }
+            responses.push_back(std::move(*response));
+        }
+        Response merged;
+        try {
+            merged = merge(std::move(responses));
+        } catch (...) {
+            // Сервер ответил 200 телом, которое роутер не разобрал
+            return state->callback(beast::errc::make_error_code(beast::errc::bad_message), {});
+        }
+        state->callback({}, std::move(merged));
+    };
+    for (size_t i = 0; i < parts.size(); ++i) {
+        pools_[parts[i].first]->Forward(std::move(parts[i].second), [state, i, finish](beast::error_code ec, Response&& response) {
+            std::unique_lock lock(state->mutex);
+            if (ec) {
+                if (!state->ec) {
+                    state->ec = ec;
+                }
+            } else {
+                state->responses[i] = std::move(response);
+            }
+            if (--state->pending > 0) {
+                return;
+            }
+            lock.unlock();
+            finish();
+        });
+    }
+}
+
+unsigned Router::NextShard() {
+    return round_robin_.fetch_add(1, std::memory_order_relaxed) % pools_.size();
+}
+
+}  // namespace router
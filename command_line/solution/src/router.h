@@ -0,0 +1,75 @@
+#pragma once
+
+#include "aux.h"
+#include "response_maker.h"
+#include "upstream_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace router {
+
+// Как свести ответы нескольких шардов в один
+enum class Merge {
+    // Ручной тик должен дойти до каждого процесса, клиенту уходит первая ошибка
+    FIRST_ERROR,
+    // Страница рекордов собирается из таблиц всех шардов
+    RECORDS,
+    // Пачка действий игроков разных шардов делится по шардам токенов
+    ACTIONS
+};
+
+// Куда отправить запрос: конкретному шарду или нескольким сразу
+struct Route {
+    std::optional<unsigned> shard;
+    Merge merge = Merge::FIRST_ERROR;
+};
+
+// Фронтовой роутер: принимает запросы клиентов и пересылает их процессам game_server.
+// Шард игрока определяется по префиксу токена, шард карты при входе в игру - по id карты.
+// Запросы без привязки (карты, статика) раскладываются по шардам по кругу
+class Router {
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+public:
+    Router(net::io_context& ioc, const std::vector<std::string>& upstreams, size_t max_idle, std::chrono::milliseconds timeout);
+
+    Route RouteRequest(const Request& request);
+
+    template <typename Send>
+    void operator()(Request&& request, const net::ip::address& remote_address, Send&& send) {
+        const unsigned version = request.version();
+        const bool keep_alive = request.keep_alive();
+        request.set("X-Forwarded-For"sv, remote_address.to_string());
+        const Route route = RouteRequest(request);
+        Forward(std::move(request), route, [send = std::forward<Send>(send), version, keep_alive](beast::error_code ec, Response&& response) mutable {
+            if (ec) {
+                return send(http_handler::MakeStaticResponse(http::status::bad_gateway, http_handler::Errors::BAD_GATEWAY, version, keep_alive, http_handler::ContentType::JSON, "no-cache"sv));
+            }
+            // Keep-alive клиента и keep-alive соединения с сервером независимы
+            response.version(version);
+            response.keep_alive(keep_alive);
+            send(std::move(response));
+        });
+    }
+
+private:
+    // Сводит успешные ответы частей в один ответ клиенту
+    using Merger = std::function<Response(std::vector<Response>&&)>;
+
+    void Forward(Request&& request, const Route& route, UpstreamPool::Callback&& callback);
+    void ForwardRecords(Request&& request, UpstreamPool::Callback&& callback);
+    void ForwardActions(Request&& request, UpstreamPool::Callback&& callback);
+    // Отправляет части запроса их шардам. Ошибка соединения или ответ не 200 любой части
+    // уходит клиенту как есть, иначе ответы сводит merge
+    void Gather(std::vector<std::pair<unsigned, Request>>&& parts, Merger&& merge, UpstreamPool::Callback&& callback);
+    unsigned NextShard();
+
+    std::vector<std::shared_ptr<UpstreamPool>> pools_;
+    std::atomic<unsigned> round_robin_{0};
+};
+
+}  // namespace router
@@ -0,0 +1,123 @@
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "http_server.h"
+#include "logger.h"
+#include "router.h"
+
+using namespace std::literals;
+namespace net = boost::asio;
+namespace sys = boost::system;
+
+namespace {
+
+struct RouterArgs {
+    unsigned short port = 8080;
+    std::vector<std::string> upstreams;
+    size_t max_idle_connections = 64;
+    unsigned int upstream_timeout = 10000;
+    unsigned int idle_timeout = 30000;
+};
+
+[[nodiscard]] std::optional<RouterArgs> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+    po::options_description desc{"Allowed options:"};
+    RouterArgs args;
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("port", po::value<unsigned short>(&args.port)->value_name("port"s), "listen port, 8080 by default")
+        ("upstream", po::value(&args.upstreams)->value_name("host:port"s)->composing(), "game_server address; the n-th upstream is shard n (its --shard-id)")
+        ("max-idle-connections", po::value<size_t>(&args.max_idle_connections)->value_name("connections"s), "keep-alive connections kept open to each upstream")
+        ("upstream-timeout", po::value<unsigned int>(&args.upstream_timeout)->value_name("milliseconds"s), "max time to connect to upstream and receive its response")
+        ("idle-timeout", po::value<unsigned int>(&args.idle_timeout)->value_name("milliseconds"s), "close client keep-alive connection idle for this time");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.upstreams.empty()) {
+        throw std::runtime_error("Usage: game_router --upstream <host:port> [--upstream <host:port> ...] --port[int, optional]");
+    }
+    return args;
+}
+
+template <typename Fn>
+void RunWorkers(unsigned n, const Fn& fn) {
+    n = std::max(1u, n);
+    std::vector<std::jthread> workers;
+    workers.reserve(n-1);
+    while (--n) {
+        workers.emplace_back(fn);
+    }
+    fn();
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    RouterArgs args;
+    try {
+        if (auto parsed = ParseCommandLine(argc, argv)) {
+            args = *parsed;
+        } else {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& ex) {
+        std::cout << "Failed parsing command line arguments: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    logger::Logger logger;
+    logger.Init();
+
+    try {
+        const unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+        net::io_context ioc(num_threads);
+
+        auto router = std::make_shared<router::Router>(ioc, args.upstreams, args.max_idle_connections,
+                                                       std::chrono::milliseconds(args.upstream_timeout));
+
+        net::signal_set signals(ioc, SIGINT, SIGTERM);
+        signals.async_wait([&ioc](const sys::error_code ec, [[maybe_unused]] int signal_number) {
+            if (!ec) {
+                ioc.stop();
+            }
+        });
+
+        const auto address = net::ip::make_address("0.0.0.0");
+        http_server::Timeouts timeouts;
+        timeouts.idle = std::chrono::milliseconds(args.idle_timeout);
+        http_server::ServeHttp(ioc, {address, args.port}, [router](auto&& request, const net::ip::address& remote_address, auto&& send) {
+            (*router)(std::move(request), remote_address, std::forward<decltype(send)>(send));
+        }, false, timeouts, num_threads);
+
+        boost::json::object add_data;
+        add_data["port"] = args.port;
+        add_data["address"] = address.to_string();
+        boost::json::array upstreams;
+        for (const std::string& upstream : args.upstreams) {
+            upstreams.emplace_back(upstream);
+        }
+        add_data["upstreams"] = std::move(upstreams);
+        logger::LogMessageInfo(add_data, "router started"s);
+
+        RunWorkers(num_threads, [&ioc] {
+            ioc.run();
+        });
+    } catch (const std::exception& ex) {
+        logger::LogExit(EXIT_FAILURE, &ex);
+        return EXIT_FAILURE;
+    }
+    logger::LogExit(0);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "model_game.h"
+#include "tagged.h"
+
+#include <string_view>
+
+// Общий фронтенд сериализации ответов API. Writer - потоковый писатель формата
+// (JsonWriter или CborWriter), поэтому обход модели не зависит от формата ответа
+namespace serialization {
+
+using namespace std::literals;
+
+// Оценка размера ответа, чтобы выходной буфер не перевыделялся по ходу записи
+constexpr size_t STATE_BYTES_PER_DOG = 96;
+constexpr size_t MAP_BYTES_PER_ELEMENT = 48;
+
+inline size_t EstimateStateSize(size_t dogs) {
+    return 16 + dogs * STATE_BYTES_PER_DOG;
+}
+
+inline size_t EstimateMapSize(const model::Map& map) {
+    return 64 + map.GetName().size() +
+        (map.GetRoads().size() + map.GetBuildings().size() + map.GetOffices().size()) * MAP_BYTES_PER_ELEMENT;
+}
+
+template <typename Writer>
+void WritePair(Writer& w, std::string_view key, const model::ParamPairDouble& value) {
+    w.Key(key);
+    w.BeginArray();
+    w.Double(value.x_);
+    w.Double(value.y_);
+    w.EndArray();
+}
+
+// {"players": {"<id>": {"dir": ..., "pos": [x, y], "speed": [x, y]}, ...}}.
+// Собаки без игрока (боты) пропускаются
+template <typename Writer>
+void WriteState(Writer& w, const std::vector<const model::Dog*>& dogs) {
+    w.BeginObject();
+    w.Key("players"sv);
+    w.BeginObject();
+    for (const model::Dog* dog : dogs) {
+        if (dog->GetPlayerId() == model::Dog::NO_PLAYER) {
+            continue;
+        }
+        w.Key(static_cast<int64_t>(dog->GetPlayerId()));
+        w.BeginObject();
+        w.Key("dir"sv);
+        w.String(dog->GetDogDirection());
+        WritePair(w, "pos"sv, dog->GetDogPosition());
+        WritePair(w, "speed"sv, dog->GetDogSpeed());
+        w.EndObject();
+    }
+    w.EndObject();
+    w.EndObject();
+}
+
+template <typename Writer>
+void WriteMapsList(Writer& w, const std::vector<model::Map>& maps) {
+    w.BeginArray();
+    for (const model::Map& map : maps) {
+        w.BeginObject();
+        w.Key("id"sv);
+        w.String(*map.GetId());
+        w.Key("name"sv);
+        w.String(map.GetName());
+        w.EndObject();
+    }
+    w.EndArray();
+}
+
+// Порядок полей каждого элемента повторяет порядок в конфигурационном файле
+template <typename Writer>
+void WriteMap(Writer& w, const model::Map& map) {
+    using namespace strconsts;
+    w.BeginObject();
+    for (const std::string& key : map.GetKeys()) {
+        if (key == "id") {
+            w.Key("id"sv);
+            w.String(*map.GetId());
+        } else if (key == "name") {
+            w.Key("name"sv);
+            w.String(map.GetName());
+        } else if (key == "roads") {
+            w.Key("roads"sv);
+            w.BeginArray();
+            for (const model::Road& road : map.GetRoads()) {
+                w.BeginObject();
+                for (const std::string& str : road.GetKeys()) {
+                    if (str == x_start) {w.Key(x_start); w.Int(road.GetStart().x);}
+                    if (str == x_end) {w.Key(x_end); w.Int(road.GetEnd().x);}
+                    if (str == y_start) {w.Key(y_start); w.Int(road.GetStart().y);}
+                    if (str == y_end) {w.Key(y_end); w.Int(road.GetEnd().y);}
+                }
+                w.EndObject();
+            }
+            w.EndArray();
+        } else if (key == "buildings") {
+            w.Key("buildings"sv);
+            w.BeginArray();
+            for (const model::Building& building : map.GetBuildings()) {
+                w.BeginObject();
+                for (const std::string& str : building.GetKeys()) {
+                    if (str == x_str) {w.Key(x_str); w.Int(building.GetBounds().position.x);}
+                    if (str == y_str) {w.Key(y_str); w.Int(building.GetBounds().position.y);}
+                    if (str == w_str) {w.Key(w_str); w.Int(building.GetBounds().size.width);}
+                    if (str == h_str) {w.Key(h_str); w.Int(building.GetBounds().size.height);}
+                }
+                w.EndObject();
+            }
+            w.EndArray();
+        } else if (key == "offices") {
+            w.Key("offices"sv);
+            w.BeginArray();
+            for (const model::Office& office : map.GetOffices()) {
+                w.BeginObject();
+                for (const std::string& str : office.GetKeys()) {
+                    if (str == "id") {w.Key("id"sv); w.String(*office.GetId());}
+                    if (str == x_str) {w.Key(x_str); w.Int(office.GetPosition().x);}
+                    if (str == y_str) {w.Key(y_str); w.Int(office.GetPosition().y);}
+                    if (str == x_offset) {w.Key(x_offset); w.Int(office.GetOffset().dx);}
+                    if (str == y_offset) {w.Key(y_offset); w.Int(office.GetOffset().dy);}
+                }
+                w.EndObject();
+            }
+            w.EndArray();
+        }
+    }
+    w.EndObject();
+}
+
+}  // namespace serialization
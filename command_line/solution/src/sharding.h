@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Общие правила шардирования для game_server и game_router.
+// Номер шарда записан в первых двух hex-цифрах токена, поэтому роутер находит процесс игрока
+// без обращения к нему. Карта закрепляется за шардом рандеву-хешированием: при добавлении шарда
+// переезжают только карты, которые достались новому шарду
+namespace sharding {
+
+constexpr unsigned MAX_SHARDS = 256;
+constexpr size_t TOKEN_SHARD_DIGITS = 2;
+
+inline void StampToken(std::string& token, unsigned shard) {
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    token[0] = HEX_DIGITS[(shard >> 4) & 0xF];
+    token[1] = HEX_DIGITS[shard & 0xF];
+}
+
+inline std::optional<unsigned> TokenShard(std::string_view token) {
+    if (token.size() < TOKEN_SHARD_DIGITS) {
+        return std::nullopt;
+    }
+    unsigned shard = 0;
+    for (size_t i = 0; i < TOKEN_SHARD_DIGITS; ++i) {
+        const char c = token[i];
+        shard <<= 4;
+        if (c >= '0' && c <= '9') {
+            shard |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            shard |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            shard |= c - 'A' + 10;
+        } else {
+            return std::nullopt;
+        }
+    }
+    return shard;
+}
+
+// Хеш не зависит от реализации стандартной библиотеки: роутеры и серверы могут быть собраны по-разному
+inline uint64_t MapShardWeight(std::string_view map_id, unsigned shard) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : map_id) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    hash ^= shard + 0x9e3779b97f4a7c15ull;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+inline unsigned MapShard(std::string_view map_id, unsigned shard_count) {
+    unsigned best = 0;
+    uint64_t best_weight = 0;
+    for (unsigned shard = 0; shard < shard_count; ++shard) {
+        const uint64_t weight = MapShardWeight(map_id, shard);
+        if (shard == 0 || weight > best_weight) {
+            best = shard;
+            best_weight = weight;
+        }
+    }
+    return best;
+}
+
+}  // namespace sharding
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "model_app.h"
+#include "placement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace model {
+
+// Равномерная сетка собак над прямоугольником дорог карты. Ячейка и место в ней хранятся
+// в самой собаке, поэтому вставка, удаление и переход между ячейками - O(1)
+class SpatialGrid {
+public:
+    SpatialGrid() = default;
+
+    SpatialGrid(const RoadArea& bounds, double cell_size) :
+        origin_(bounds.left_bottom) {
+        const double width = std::max(bounds.right_top.x_ - bounds.left_bottom.x_, 1.);
+        const double height = std::max(bounds.right_top.y_ - bounds.left_bottom.y_, 1.);
+        // Слишком мелкая ячейка на большой карте раздула бы сетку: ячейка укрупняется
+        cell_size_ = std::max(cell_size, std::sqrt(width * height / MAX_CELLS));
+        cols_ = static_cast<size_t>(width / cell_size_) + 1;
+        rows_ = static_cast<size_t>(height / cell_size_) + 1;
+        cells_.resize(cols_ * rows_);
+    }
+
+    bool Enabled() const noexcept {
+        return !cells_.empty();
+    }
+
+    void Insert(Dog& dog) {
+        Place(dog, CellOf(dog.GetDogPosition()));
+    }
+
+    void Remove(Dog& dog) {
+        std::vector<Dog*>& cell = cells_[dog.grid_cell_];
+        if (dog.grid_slot_ + 1 != cell.size()) {
+            cell[dog.grid_slot_] = cell.back();
+            cell[dog.grid_slot_]->grid_slot_ = dog.grid_slot_;
+        }
+        cell.pop_back();
+    }
+
+    // Вызывается после перемещения собаки
+    void Update(Dog& dog) {
+        const size_t cell = CellOf(dog.GetDogPosition());
+        if (cell != dog.grid_cell_) {
+            Remove(dog);
+            Place(dog, cell);
+        }
+    }
+
+    size_t MemoryUsage() const {
+        size_t bytes = cells_.capacity() * sizeof(std::vector<Dog*>);
+        for (const auto& cell : cells_) {
+            bytes += cell.capacity() * sizeof(Dog*);
+        }
+        return bytes;
+    }
+
+    // fn(Dog&) для собак из ячеек, задевающих квадрат со стороной 2 * radius вокруг center
+    template <typename Fn>
+    void ForEachNear(ParamPairDouble center, double radius, Fn&& fn) const {
+        const auto [col_from, row_from] = ColRow({center.x_ - radius, center.y_ - radius});
+        const auto [col_to, row_to] = ColRow({center.x_ + radius, center.y_ + radius});
+        for (size_t row = row_from; row <= row_to; ++row) {
+            for (size_t col = col_from; col <= col_to; ++col) {
+                for (Dog* dog : cells_[row * cols_ + col]) {
+                    fn(*dog);
+                }
+            }
+        }
+    }
+
+private:
+    constexpr static double MAX_CELLS = 1 << 20;
+
+    std::pair<size_t, size_t> ColRow(ParamPairDouble pos) const {
+        // Точки за краем прямоугольника дорог относятся к крайним ячейкам
+        auto index = [this](double offset, size_t count) {
+            return static_cast<size_t>(std::clamp(offset / cell_size_, 0., static_cast<double>(count - 1)));
+        };
+        return {index(pos.x_ - origin_.x_, cols_), index(pos.y_ - origin_.y_, rows_)};
+    }
+
+    size_t CellOf(ParamPairDouble pos) const {
+        const auto [col, row] = ColRow(pos);
+        return row * cols_ + col;
+    }
+
+    void Place(Dog& dog, size_t cell) {
+        dog.grid_cell_ = cell;
+        dog.grid_slot_ = cells_[cell].size();
+        cells_[cell].push_back(&dog);
+    }
+
+    ParamPairDouble origin_{0., 0.};
+    double cell_size_ = 1.;
+    size_t cols_ = 0;
+    size_t rows_ = 0;
+    placement::HugeVector<std::vector<Dog*>> cells_;
+};
+
+}  // namespace model
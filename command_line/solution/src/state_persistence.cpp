@@ -0,0 +1,424 @@
+#include "state_persistence.h"
+#include "binary_io.h"
+#include "logger.h"
+
+#include <boost/crc.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace persistence {
+
+using namespace std::literals;
+using namespace serialization;
+
+namespace {
+
+constexpr std::string_view SNAPSHOT_SIGNATURE = "GSS1"sv;
+constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+enum class RecordType : uint8_t {
+    JOIN = 1,
+    RETIRE = 2,
+};
+
+uint32_t Crc32(std::string_view data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+[[noreturn]] void ThrowSystemError(const std::string& what, const std::filesystem::path& path) {
+    throw std::system_error(errno, std::generic_category(), what + ": "s + path.string());
+}
+
+void WriteFd(int fd, std::string_view data, const std::filesystem::path& path) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("Failed to write", path);
+        }
+        data.remove_prefix(written);
+    }
+}
+
+void PutPlayer(std::string& out, const PlayerState& player) {
+    PutString(out, player.token);
+    PutString(out, player.name);
+    PutVarint(out, player.player_id);
+    PutString(out, player.map_id);
+    PutFixed(out, player.dog.position.x_);
+    PutFixed(out, player.dog.position.y_);
+    PutFixed(out, player.dog.speed.x_);
+    PutFixed(out, player.dog.speed.y_);
+    PutString(out, player.dog.dir);
+    PutFixed(out, player.dog.score);
+    PutFixed(out, player.dog.join_time);
+    PutFixed(out, player.dog.last_active_time);
+}
+
+bool GetPlayer(std::istream& in, PlayerState& player) {
+    uint64_t player_id;
+    if (!GetString(in, player.token) || !GetString(in, player.name) || !GetVarint(in, player_id)
+        || !GetString(in, player.map_id)) {
+        return false;
+    }
+    player.player_id = static_cast<int>(player_id);
+    return GetFixed(in, player.dog.position.x_) && GetFixed(in, player.dog.position.y_)
+        && GetFixed(in, player.dog.speed.x_) && GetFixed(in, player.dog.speed.y_)
+        && GetString(in, player.dog.dir) && GetFixed(in, player.dog.score)
+        && GetFixed(in, player.dog.join_time) && GetFixed(in, player.dog.last_active_time);
+}
+
+struct Encoder {
+    std::string& out;
+
+    void operator()(const JoinRecord& record) const {
+        out.push_back(static_cast<char>(RecordType::JOIN));
+        PutPlayer(out, record.player);
+    }
+
+    void operator()(const RetireRecord& record) const {
+        out.push_back(static_cast<char>(RecordType::RETIRE));
+        PutString(out, record.token);
+    }
+};
+
+WalRecord DecodeRecord(std::istream& in) {
+    const int type = in.get();
+    switch (static_cast<RecordType>(type)) {
+        case RecordType::JOIN: {
+            JoinRecord record;
+            if (GetPlayer(in, record.player)) {
+                return record;
+            }
+            break;
+        }
+        case RecordType::RETIRE: {
+            RetireRecord record;
+            if (GetString(in, record.token)) {
+                return record;
+            }
+            break;
+        }
+    }
+    // Кадр с верной CRC не может быть недописан
+    throw std::runtime_error("Corrupted WAL record of type "s + std::to_string(type));
+}
+
+}  // namespace
+
+std::string EncodeSnapshot(const Snapshot& snapshot) {
+    std::string payload;
+    PutVarint(payload, snapshot.lsn);
+    PutVarint(payload, snapshot.sessions.size());
+    for (const SessionState& session : snapshot.sessions) {
+        PutString(payload, session.map_id);
+        PutFixed(payload, session.session_time);
+    }
+    PutVarint(payload, snapshot.players.size());
+    for (const PlayerState& player : snapshot.players) {
+        PutPlayer(payload, player);
+    }
+
+    std::string out(SNAPSHOT_SIGNATURE);
+    PutFixed(out, Crc32(payload));
+    out.append(payload);
+    return out;
+}
+
+std::optional<Snapshot> LoadSnapshot(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return std::nullopt;
+    }
+    const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    const size_t header_size = SNAPSHOT_SIGNATURE.size() + sizeof(uint32_t);
+    if (data.size() < header_size || !data.starts_with(SNAPSHOT_SIGNATURE)) {
+        throw std::runtime_error("Not a game state snapshot: "s + path.string());
+    }
+    uint32_t crc;
+    std::memcpy(&crc, data.data() + SNAPSHOT_SIGNATURE.size(), sizeof(crc));
+    std::istringstream payload(data.substr(header_size));
+    if (Crc32(payload.view()) != crc) {
+        throw std::runtime_error("Game state snapshot checksum mismatch: "s + path.string());
+    }
+
+    Snapshot snapshot;
+    uint64_t sessions, players;
+    bool ok = GetVarint(payload, snapshot.lsn) && GetVarint(payload, sessions);
+    for (uint64_t i = 0; ok && i < sessions; ++i) {
+        SessionState& session = snapshot.sessions.emplace_back();
+        ok = GetString(payload, session.map_id) && GetFixed(payload, session.session_time);
+    }
+    ok = ok && GetVarint(payload, players);
+    for (uint64_t i = 0; ok && i < players; ++i) {
+        ok = GetPlayer(payload, snapshot.players.emplace_back());
+    }
+    if (!ok) {
+        throw std::runtime_error("Truncated game state snapshot: "s + path.string());
+    }
+    return snapshot;
+}
+
+WalTail ReadWal(const std::filesystem::path& path, uint64_t after_lsn, const std::function<void(const WalRecord&)>& fn) {
+    WalTail tail{after_lsn, 0};
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return tail;
+    }
+    std::string payload;
+    while (true) {
+        uint32_t size, crc;
+        if (!GetFixed(in, size) || !GetFixed(in, crc)) {
+            break;
+        }
+        payload.resize(size);
+        // Недописанный или испорченный кадр - конец WAL: дальше него запись не продолжалась
+        if (!in.read(payload.data(), size) || Crc32(payload) != crc) {
+            break;
+        }
+        std::istringstream frame(payload);
+        uint64_t lsn;
+        if (!GetVarint(frame, lsn)) {
+            throw std::runtime_error("Corrupted WAL frame in "s + path.string());
+        }
+        WalRecord record = DecodeRecord(frame);
+        tail.valid_size += FRAME_HEADER_SIZE + size;
+        // Сбой между заменой снимка и обрезкой WAL оставляет записи, уже учтённые в снимке
+        if (lsn > after_lsn) {
+            fn(record);
+            tail.last_lsn = lsn;
+        }
+    }
+    return tail;
+}
+
+WalWriter::WalWriter(std::filesystem::path wal_path, std::filesystem::path snapshot_path, WalTail tail, std::chrono::milliseconds sync_interval,
+                     std::function<void()> on_failure) :
+    wal_path_(std::move(wal_path)),
+    snapshot_path_(std::move(snapshot_path)),
+    sync_interval_(sync_interval),
+    on_failure_(std::move(on_failure)),
+    appended_lsn_(tail.last_lsn),
+    durable_lsn_(tail.last_lsn) {
+    // O_DIRECT не используется: записи мелкие и не выровнены, пачку всё равно собирает поток WAL
+    fd_ = ::open(wal_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        ThrowSystemError("Failed to open WAL", wal_path_);
+    }
+    if (::ftruncate(fd_, tail.valid_size) != 0) {
+        const int err = errno;
+        ::close(fd_);
+        errno = err;
+        ThrowSystemError("Failed to truncate WAL", wal_path_);
+    }
+    writer_ = std::jthread([this](std::stop_token stop) {
+        try {
+            WriterLoop(stop);
+        } catch (const std::exception& ex) {
+            Fail(ex);
+        }
+    });
+}
+
+WalWriter::~WalWriter() {
+    // Поток допишет и синхронизирует всё, что уже стоит в очереди, и завершится
+    writer_.request_stop();
+    writer_.join();
+    ::close(fd_);
+}
+
+uint64_t WalWriter::Append(const WalRecord& record) {
+    uint64_t lsn;
+    {
+        std::lock_guard lock(queue_mutex_);
+        lsn = ++appended_lsn_;
+        // Размер и CRC известны только после кодирования: место под заголовок резервируется заранее
+        const size_t frame_start = pending_.size();
+        pending_.append(FRAME_HEADER_SIZE, '\0');
+        PutVarint(pending_, lsn);
+        std::visit(Encoder{pending_}, record);
+        const std::string_view payload = std::string_view(pending_).substr(frame_start + FRAME_HEADER_SIZE);
+        const uint32_t header[] = {static_cast<uint32_t>(payload.size()), Crc32(payload)};
+        std::memcpy(pending_.data() + frame_start, header, sizeof(header));
+    }
+    queue_cv_.notify_one();
+    return lsn;
+}
+
+uint64_t WalWriter::LastLsn() const {
+    std::lock_guard lock(queue_mutex_);
+    return appended_lsn_;
+}
+
+void WalWriter::Checkpoint(std::function<std::string()> encode) {
+    {
+        std::lock_guard lock(queue_mutex_);
+        // Более новый снимок покрывает и ещё не записанный предыдущий
+        checkpoint_ = PendingCheckpoint{std::move(encode), pending_.size()};
+    }
+    queue_cv_.notify_one();
+}
+
+void WalWriter::WhenDurable(std::function<void(bool durable)> fn) {
+    bool durable;
+    {
+        std::lock_guard lock(queue_mutex_);
+        durable = !failed_;
+        if (durable && durable_lsn_ < appended_lsn_) {
+            waiters_.emplace_back(appended_lsn_, std::move(fn));
+            return;
+        }
+    }
+    fn(durable);
+}
+
+void WalWriter::Flush() {
+    std::unique_lock lock(queue_mutex_);
+    const uint64_t target = ++sync_requests_;
+    queue_cv_.notify_one();
+    durable_cv_.wait(lock, [this, target] {
+        return syncs_done_ >= target || failed_;
+    });
+}
+
+bool WalWriter::Failed() const {
+    std::lock_guard lock(queue_mutex_);
+    return failed_;
+}
+
+void WalWriter::Fail(const std::exception& ex) {
+    logger::LogError(ex);
+    std::vector<std::pair<uint64_t, std::function<void(bool)>>> waiters;
+    {
+        std::lock_guard lock(queue_mutex_);
+        failed_ = true;
+        waiters.swap(waiters_);
+    }
+    durable_cv_.notify_all();
+    for (auto& [lsn, fn] : waiters) {
+        fn(false);
+    }
+    if (on_failure_) {
+        on_failure_();
+    }
+}
+
+void WalWriter::WriterLoop(std::stop_token stop) {
+    std::string batch;
+    std::vector<std::function<void(bool)>> ready;
+    auto last_sync = std::chrono::steady_clock::now();
+    // В файле есть данные без fdatasync
+    bool dirty = false;
+    while (true) {
+        std::optional<PendingCheckpoint> checkpoint;
+        uint64_t batch_lsn;
+        uint64_t batch_sync_requests;
+        {
+            std::unique_lock lock(queue_mutex_);
+            auto has_work = [this] {
+                return !pending_.empty() || checkpoint_ || sync_requests_ > syncs_done_;
+            };
+            if (dirty) {
+                queue_cv_.wait_until(lock, stop, last_sync + sync_interval_, has_work);
+            } else if (!queue_cv_.wait(lock, stop, has_work)) {
+                return;
+            }
+            // Буферы меняются местами, поэтому память под записи не перевыделяется
+            batch.swap(pending_);
+            checkpoint.swap(checkpoint_);
+            batch_lsn = appended_lsn_;
+            batch_sync_requests = sync_requests_;
+        }
+
+        std::string_view data = batch;
+        if (checkpoint) {
+            WriteSnapshot(checkpoint->encode());
+            // Снимок уже на диске, поэтому записи до него можно выбросить. При сбое до обрезки
+            // они останутся в WAL, но при чтении будут пропущены по lsn
+            if (::ftruncate(fd_, 0) != 0) {
+                ThrowSystemError("Failed to truncate WAL", wal_path_);
+            }
+            data.remove_prefix(checkpoint->covered_bytes);
+            dirty = false;
+        }
+        // После ошибки записи продолжать, обещая сохранность входов, нельзя: поток WAL завершается
+        WriteFd(fd_, data, wal_path_);
+        dirty = dirty || !data.empty();
+        batch.clear();
+
+        const auto now = std::chrono::steady_clock::now();
+        const bool sync_due = sync_interval_.count() == 0 || now - last_sync >= sync_interval_
+            || batch_sync_requests > syncs_done_ || stop.stop_requested();
+        if (dirty && !sync_due) {
+            continue;
+        }
+        if (dirty) {
+            if (::fdatasync(fd_) != 0) {
+                ThrowSystemError("Failed to sync WAL", wal_path_);
+            }
+            dirty = false;
+            last_sync = now;
+        }
+        {
+            std::lock_guard lock(queue_mutex_);
+            durable_lsn_ = batch_lsn;
+            syncs_done_ = batch_sync_requests;
+            auto it = std::partition(waiters_.begin(), waiters_.end(), [batch_lsn](const auto& waiter) {
+                return waiter.first > batch_lsn;
+            });
+            for (auto ready_it = it; ready_it != waiters_.end(); ++ready_it) {
+                ready.push_back(std::move(ready_it->second));
+            }
+            waiters_.erase(it, waiters_.end());
+        }
+        for (auto& fn : ready) {
+            fn(true);
+        }
+        ready.clear();
+        durable_cv_.notify_all();
+    }
+}
+
+void WalWriter::WriteSnapshot(const std::string& snapshot) const {
+    // Новый снимок пишется рядом и подменяет старый rename: на диске всегда целый снимок
+    std::filesystem::path tmp_path = snapshot_path_;
+    tmp_path += ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ThrowSystemError("Failed to create snapshot", tmp_path);
+    }
+    WriteFd(fd, snapshot, tmp_path);
+    if (::fsync(fd) != 0) {
+        ThrowSystemError("Failed to sync snapshot", tmp_path);
+    }
+    ::close(fd);
+    std::filesystem::rename(tmp_path, snapshot_path_);
+
+    // Сама замена попадает на диск только с fsync каталога
+    std::filesystem::path dir = snapshot_path_.parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        ThrowSystemError("Failed to open snapshot directory", dir);
+    }
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+}
+
+}  // namespace persistence
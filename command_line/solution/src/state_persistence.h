@@ -0,0 +1,132 @@
+#pragma once
+
+#include "model_game.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// Сохранение состояния игроков между перезапусками: снимок + журнал упреждающей записи (WAL).
+// При старте загружается последний снимок и поверх него применяется хвост WAL
+namespace persistence {
+
+struct PlayerState {
+    std::string token;
+    std::string name;
+    int player_id = 0;
+    std::string map_id;
+    model::DogState dog;
+};
+
+struct SessionState {
+    std::string map_id;
+    double session_time = 0.;
+};
+
+struct Snapshot {
+    // Последняя запись WAL, уже учтённая в снимке
+    uint64_t lsn = 0;
+    std::vector<SessionState> sessions;
+    // Внутри сессии игроки идут в порядке активности их собак, как в очереди простоя
+    std::vector<PlayerState> players;
+};
+
+struct JoinRecord {
+    PlayerState player;
+};
+
+struct RetireRecord {
+    std::string token;
+};
+
+using WalRecord = std::variant<JoinRecord, RetireRecord>;
+
+// Формат: сигнатура, CRC32 содержимого, содержимое
+std::string EncodeSnapshot(const Snapshot& snapshot);
+
+// nullopt, если снимка ещё нет. Повреждённый снимок - исключение: молча терять игроков нельзя
+std::optional<Snapshot> LoadSnapshot(const std::filesystem::path& path);
+
+struct WalTail {
+    uint64_t last_lsn = 0;
+    // Длина целой части файла: недописанная при сбое запись отрезается
+    uint64_t valid_size = 0;
+};
+
+// Вызывает fn для каждой записи с lsn больше after_lsn. Без файла WAL возвращает {after_lsn, 0}
+WalTail ReadWal(const std::filesystem::path& path, uint64_t after_lsn, const std::function<void(const WalRecord&)>& fn);
+
+// Запись кадрами [размер u32][CRC32 u32][lsn varint, тип, поля]. Вызывающий (strand игры) только
+// кодирует запись в буфер; поток WAL пишет накопленное одним write и делает fdatasync не чаще
+// sync_interval. Нулевой интервал - fdatasync после каждой пачки (групповая фиксация).
+// Ошибка записи останавливает поток WAL: она логируется, ожидающие сохранности получают false,
+// затем на потоке WAL вызывается on_failure. Дальнейшие записи на диск не попадают
+class WalWriter {
+public:
+    WalWriter(std::filesystem::path wal_path, std::filesystem::path snapshot_path, WalTail tail, std::chrono::milliseconds sync_interval,
+              std::function<void()> on_failure = {});
+    ~WalWriter();
+
+    WalWriter(const WalWriter&) = delete;
+    WalWriter& operator=(const WalWriter&) = delete;
+
+    uint64_t Append(const WalRecord& record);
+
+    uint64_t LastLsn() const;
+
+    // Снимок, учитывающий все записи до LastLsn(). encode вызывается на потоке WAL: вызывающий
+    // передаёт в нём копию состояния, а сборка и кодирование снимка не занимают strand игры.
+    // Затем поток WAL атомарно заменит файл снимка и обрежет WAL
+    void Checkpoint(std::function<std::string()> encode);
+
+    // fn(true) вызывается на потоке WAL, когда всё добавленное до этого момента окажется на диске,
+    // fn(false) - если записать его уже не удастся
+    void WhenDurable(std::function<void(bool durable)> fn);
+
+    // Дожидается записи и fdatasync всего добавленного, включая снимок. После сбоя возвращается сразу
+    void Flush();
+
+    bool Failed() const;
+
+private:
+    struct PendingCheckpoint {
+        std::function<std::string()> encode;
+        // Записи буфера до этого места уже учтены в снимке
+        size_t covered_bytes = 0;
+    };
+
+    void WriterLoop(std::stop_token stop);
+    void Fail(const std::exception& ex);
+    void WriteSnapshot(const std::string& snapshot) const;
+
+    const std::filesystem::path wal_path_;
+    const std::filesystem::path snapshot_path_;
+    const std::chrono::milliseconds sync_interval_;
+    const std::function<void()> on_failure_;
+    int fd_ = -1;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable_any queue_cv_;
+    std::condition_variable_any durable_cv_;
+    std::string pending_;
+    std::optional<PendingCheckpoint> checkpoint_;
+    std::vector<std::pair<uint64_t, std::function<void(bool)>>> waiters_;
+    // Flush просит fdatasync, не дожидаясь интервала
+    uint64_t sync_requests_ = 0;
+    uint64_t syncs_done_ = 0;
+    uint64_t appended_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    bool failed_ = false;
+
+    std::jthread writer_;
+};
+
+}  // namespace persistence
@@ -20,12 +20,14 @@ namespace strconsts {
 enum class RequestType {
     API,
     PLAYER,
+    ADMIN,
     FILE
 };
 
 struct RequestData {
     RequestType type;
     std::string r_target;
+    std::string query;
 };
 
 namespace util {
@@ -0,0 +1,126 @@
+#include "timing_wheel.h"
+
+#include <boost/asio/dispatch.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace http_server {
+
+void TimingWheel::Start() {
+    net::dispatch(timer_.get_executor(), [self = shared_from_this()] {
+        self->ScheduleTick();
+    });
+}
+
+void TimingWheel::Schedule(Entry& entry, std::chrono::milliseconds timeout, uint64_t tag) {
+    assert(strand_.running_in_this_thread());
+    const uint64_t ticks = std::max<uint64_t>(1, (timeout + tick_ - std::chrono::milliseconds(1)) / tick_);
+    if (entry.slot_) {
+        Unlink(entry);
+    }
+    entry.expiry_tick_ = current_tick_ + ticks;
+    entry.tag_ = tag;
+    Link(entry);
+}
+
+void TimingWheel::Cancel(Entry& entry) {
+    if (entry.slot_) {
+        Unlink(entry);
+    }
+}
+
+void TimingWheel::ScheduleTick() {
+    timer_.expires_at(start_ + tick_ * (current_tick_ + 1));
+    timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
+        self->OnTick(ec);
+    });
+}
+
+void TimingWheel::OnTick(sys::error_code ec) {
+    if (ec) {
+        return;
+    }
+    Advance((Clock::now() - start_) / tick_);
+    ScheduleTick();
+}
+
+void TimingWheel::Advance(uint64_t target_tick) {
+    std::vector<std::pair<Handler, uint64_t>> expired;
+    while (current_tick_ < target_tick) {
+        ++current_tick_;
+        // Начался новый круг младшего уровня - спускаем записи со старших уровней
+        if ((current_tick_ & SLOT_MASK) == 0) {
+            Cascade(1, (current_tick_ >> SLOT_BITS) & SLOT_MASK);
+            if (((current_tick_ >> SLOT_BITS) & SLOT_MASK) == 0) {
+                Cascade(2, (current_tick_ >> (2 * SLOT_BITS)) & SLOT_MASK);
+            }
+        }
+        Entry*& head = levels_[0][current_tick_ & SLOT_MASK];
+        while (head) {
+            Entry& entry = *head;
+            Unlink(entry);
+            expired.emplace_back(entry.handler_, entry.tag_);
+        }
+    }
+    // Обработчики вызываются после обхода слотов: они могут сразу переставить дедлайн
+    for (auto& [handler, tag] : expired) {
+        if (handler) {
+            handler(tag);
+        }
+    }
+}
+
+void TimingWheel::Link(Entry& entry) {
+    constexpr uint64_t max_delta = (uint64_t{1} << (LEVELS * SLOT_BITS)) - 1;
+    uint64_t delta = entry.expiry_tick_ - current_tick_;
+    if (delta > max_delta) {
+        delta = max_delta;
+        entry.expiry_tick_ = current_tick_ + delta;
+    }
+
+    Entry** slot;
+    if (delta < SLOTS) {
+        slot = &levels_[0][entry.expiry_tick_ & SLOT_MASK];
+    } else if (delta < SLOTS * SLOTS) {
+        slot = &levels_[1][(entry.expiry_tick_ >> SLOT_BITS) & SLOT_MASK];
+    } else {
+        slot = &levels_[2][(entry.expiry_tick_ >> (2 * SLOT_BITS)) & SLOT_MASK];
+    }
+
+    entry.slot_ = slot;
+    entry.prev_ = nullptr;
+    entry.next_ = *slot;
+    if (*slot) {
+        (*slot)->prev_ = &entry;
+    }
+    *slot = &entry;
+}
+
+void TimingWheel::Unlink(Entry& entry) {
+    if (entry.prev_) {
+        entry.prev_->next_ = entry.next_;
+    } else {
+        *entry.slot_ = entry.next_;
+    }
+    if (entry.next_) {
+        entry.next_->prev_ = entry.prev_;
+    }
+    entry.prev_ = entry.next_ = nullptr;
+    entry.slot_ = nullptr;
+}
+
+void TimingWheel::Cascade(unsigned level, uint64_t slot) {
+    Entry* head = std::exchange(levels_[level][slot], nullptr);
+    while (head) {
+        Entry& entry = *head;
+        head = entry.next_;
+        entry.prev_ = entry.next_ = nullptr;
+        entry.slot_ = nullptr;
+        Link(entry);
+    }
+}
+
+}  // namespace http_server
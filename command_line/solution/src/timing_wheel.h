@@ -0,0 +1,102 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace http_server {
+
+namespace net = boost::asio;
+namespace sys = boost::system;
+
+// Иерархическое колесо таймеров (3 уровня по 64 слота).
+// Постановка и снятие дедлайна - O(1), просроченные записи снимаются пачкой раз в тик
+// одним steady_timer на всё колесо, а не таймером на каждое соединение.
+// Колесо не защищено блокировкой: с ним работают только из его strand. Соединения ставят
+// и снимают дедлайны задачами в этом strand, обработчики срабатываний тоже вызываются в нём
+class TimingWheel : public std::enable_shared_from_this<TimingWheel> {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Handler = std::function<void(uint64_t tag)>;
+    using Strand = net::strand<net::io_context::executor_type>;
+
+    // Запись встраивается в объект-владелец (например, в сессию) и не копируется
+    class Entry {
+    public:
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        void SetHandler(Handler handler) {
+            handler_ = std::move(handler);
+        }
+
+        bool Scheduled() const noexcept {
+            return slot_ != nullptr;
+        }
+
+    private:
+        friend class TimingWheel;
+
+        Entry* prev_ = nullptr;
+        Entry* next_ = nullptr;
+        Entry** slot_ = nullptr;
+        uint64_t expiry_tick_ = 0;
+        uint64_t tag_ = 0;
+        Handler handler_;
+    };
+
+    TimingWheel(net::io_context& ioc, std::chrono::milliseconds tick) :
+        strand_(net::make_strand(ioc)),
+        timer_(strand_),
+        tick_(tick),
+        start_(Clock::now()) {
+    }
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    void Start();
+
+    const Strand& GetStrand() const noexcept {
+        return strand_;
+    }
+
+    // Ставит (или переставляет) дедлайн записи. tag будет передан обработчику при срабатывании.
+    // Вызывается только из strand колеса
+    void Schedule(Entry& entry, std::chrono::milliseconds timeout, uint64_t tag);
+    // Вызывается из strand колеса или когда потоки io_context уже остановлены
+    void Cancel(Entry& entry);
+
+private:
+    constexpr static unsigned SLOT_BITS = 6;
+    constexpr static uint64_t SLOTS = 1 << SLOT_BITS;
+    constexpr static uint64_t SLOT_MASK = SLOTS - 1;
+    constexpr static unsigned LEVELS = 3;
+
+    using Level = std::array<Entry*, SLOTS>;
+
+    void ScheduleTick();
+    void OnTick(sys::error_code ec);
+    void Advance(uint64_t target_tick);
+
+    void Link(Entry& entry);
+    void Unlink(Entry& entry);
+    void Cascade(unsigned level, uint64_t slot);
+
+    Strand strand_;
+    net::steady_timer timer_;
+    const std::chrono::milliseconds tick_;
+    const Clock::time_point start_;
+
+    uint64_t current_tick_ = 0;
+    std::array<Level, LEVELS> levels_{};
+};
+
+}  // namespace http_server
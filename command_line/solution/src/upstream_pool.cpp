@@ -0,0 +1,133 @@
+#include "upstream_pool.h"
+
+#include <boost/asio/strand.hpp>
+
+#include <optional>
+#include <stdexcept>
+
+namespace router {
+
+// Один запрос к серверу: соединение (из пула или новое), запись, чтение ответа
+class ForwardOperation : public std::enable_shared_from_this<ForwardOperation> {
+public:
+    ForwardOperation(std::shared_ptr<UpstreamPool> pool, Request&& request, UpstreamPool::Callback&& callback) :
+        pool_(std::move(pool)),
+        request_(std::move(request)),
+        callback_(std::move(callback)) {}
+
+    void Start() {
+        connection_ = pool_->TakeIdle();
+        if (connection_) {
+            reused_ = true;
+            return Write();
+        }
+        Connect();
+    }
+
+private:
+    void Connect() {
+        reused_ = false;
+        connection_ = std::make_unique<UpstreamPool::Connection>(beast::tcp_stream(net::make_strand(pool_->ioc_)));
+        connection_->stream.expires_after(pool_->timeout_);
+        connection_->stream.async_connect(pool_->endpoints_,
+            [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&) {
+                if (ec) {
+                    return self->Finish(ec);
+                }
+                self->Write();
+            });
+    }
+
+    void Write() {
+        connection_->stream.expires_after(pool_->timeout_);
+        http::async_write(connection_->stream, request_,
+            [self = shared_from_this()](beast::error_code ec, std::size_t bytes_written) {
+                if (ec) {
+                    return self->RetryOrFinish(ec, bytes_written == 0);
+                }
+                self->Read();
+            });
+    }
+
+    void Read() {
+        // Ответ на HEAD несёт Content-Length без тела: тело не ждём
+        parser_.emplace();
+        parser_->skip(request_.method() == http::verb::head);
+        http::async_read(connection_->stream, connection_->buffer, *parser_,
+            [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return self->RetryOrFinish(ec, false);
+                }
+                self->response_ = self->parser_->release();
+                self->connection_->stream.expires_never();
+                if (self->response_.keep_alive()) {
+                    self->pool_->Release(std::move(self->connection_));
+                }
+                self->Finish({});
+            });
+    }
+
+    // Закрытое сервером простаивающее соединение проявляется как EOF или сброс при первом обращении.
+    // Но сервер мог и принять запрос, а упасть уже после: повторять можно только GET и HEAD
+    // или запрос, из которого не ушло ни байта. Остальное роутер вернёт клиенту как 502
+    void RetryOrFinish(beast::error_code ec, bool nothing_written) {
+        const bool stale = ec == http::error::end_of_stream || ec == net::error::eof ||
+                           ec == net::error::connection_reset || ec == net::error::broken_pipe;
+        const bool idempotent = request_.method() == http::verb::get || request_.method() == http::verb::head;
+        if (reused_ && stale && (idempotent || nothing_written)) {
+            response_ = {};
+            return Connect();
+        }
+        Finish(ec);
+    }
+
+    void Finish(beast::error_code ec) {
+        callback_(ec, std::move(response_));
+    }
+
+    std::shared_ptr<UpstreamPool> pool_;
+    Request request_;
+    Response response_;
+    std::optional<http::response_parser<http::string_body>> parser_;
+    UpstreamPool::Callback callback_;
+    std::unique_ptr<UpstreamPool::Connection> connection_;
+    bool reused_ = false;
+};
+
+UpstreamPool::UpstreamPool(net::io_context& ioc, const std::string& address, size_t max_idle, std::chrono::milliseconds timeout) :
+    ioc_(ioc),
+    address_(address),
+    max_idle_(max_idle),
+    timeout_(timeout) {
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+        throw std::invalid_argument("Upstream address must be host:port, got "s + address);
+    }
+    tcp::resolver resolver(ioc_);
+    endpoints_ = resolver.resolve(address.substr(0, colon), address.substr(colon + 1));
+}
+
+void UpstreamPool::Forward(Request request, Callback callback) {
+    request.keep_alive(true);
+    request.prepare_payload();
+    std::make_shared<ForwardOperation>(shared_from_this(), std::move(request), std::move(callback))->Start();
+}
+
+std::unique_ptr<UpstreamPool::Connection> UpstreamPool::TakeIdle() {
+    std::lock_guard lock(idle_mutex_);
+    if (idle_.empty()) {
+        return nullptr;
+    }
+    auto connection = std::move(idle_.back());
+    idle_.pop_back();
+    return connection;
+}
+
+void UpstreamPool::Release(std::unique_ptr<Connection> connection) {
+    std::lock_guard lock(idle_mutex_);
+    if (idle_.size() < max_idle_) {
+        idle_.push_back(std::move(connection));
+    }
+}
+
+}  // namespace router
@@ -0,0 +1,69 @@
+#pragma once
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace router {
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using namespace std::literals;
+
+using Request = http::request<http::string_body>;
+using Response = http::response<http::string_body>;
+
+// Пул keep-alive соединений к одному процессу game_server.
+// Соединение берётся из пула на время одного запроса и возвращается, если сервер его не закрыл.
+// GET и HEAD, упавшие на переиспользованном соединении (сервер успел закрыть его по таймауту простоя),
+// один раз повторяются на новом соединении. Остальные запросы - только если не было записано ни байта
+class UpstreamPool : public std::enable_shared_from_this<UpstreamPool> {
+public:
+    using Callback = std::function<void(beast::error_code ec, Response&& response)>;
+
+    struct Connection {
+        explicit Connection(beast::tcp_stream&& s) :
+            stream(std::move(s)) {}
+
+        beast::tcp_stream stream;
+        beast::flat_buffer buffer;
+    };
+
+    // address - "host:port", имя разрешается один раз при создании пула
+    UpstreamPool(net::io_context& ioc, const std::string& address, size_t max_idle, std::chrono::milliseconds timeout);
+
+    void Forward(Request request, Callback callback);
+
+    const std::string& GetAddress() const noexcept {
+        return address_;
+    }
+
+private:
+    friend class ForwardOperation;
+
+    std::unique_ptr<Connection> TakeIdle();
+    void Release(std::unique_ptr<Connection> connection);
+
+    net::io_context& ioc_;
+    const std::string address_;
+    tcp::resolver::results_type endpoints_;
+    const size_t max_idle_;
+    const std::chrono::milliseconds timeout_;
+
+    std::mutex idle_mutex_;
+    std::vector<std::unique_ptr<Connection>> idle_;
+};
+
+}  // namespace router
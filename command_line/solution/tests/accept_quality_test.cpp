@@ -0,0 +1,37 @@
+// Разбор заголовка Accept: вес q берётся у самого точного диапазона, q=0 - отказ от формата
+#include "aux.h"
+
+#include "check.h"
+
+#include <iostream>
+
+using auxillary::AcceptQuality;
+
+int main() {
+    constexpr std::string_view CBOR = "application/cbor"sv;
+    constexpr std::string_view JSON = "application/json"sv;
+
+    CHECK(AcceptQuality(""sv, CBOR) == 0.);
+    CHECK(AcceptQuality("application/cbor"sv, CBOR) == 1.);
+    CHECK(AcceptQuality("Application/CBOR"sv, CBOR) == 1.);
+    CHECK(AcceptQuality("application/json, application/cbor;q=0.5"sv, CBOR) == 0.5);
+    CHECK(AcceptQuality("application/json, application/cbor;q=0.5"sv, JSON) == 1.);
+    CHECK(AcceptQuality("application/cbor ; charset=x ; Q=0.25"sv, CBOR) == 0.25);
+
+    // Явный отказ не перекрывается ни подстрокой, ни wildcard
+    CHECK(AcceptQuality("application/cbor;q=0"sv, CBOR) == 0.);
+    CHECK(AcceptQuality("*/*, application/cbor;q=0"sv, CBOR) == 0.);
+    CHECK(AcceptQuality("application/cbor-seq"sv, CBOR) == 0.);
+
+    // Wildcard: type/* точнее */*; без wildcards считается только точное упоминание
+    CHECK(AcceptQuality("*/*;q=0.1, application/*;q=0.7"sv, JSON) == 0.7);
+    CHECK(AcceptQuality("*/*;q=0.1"sv, JSON) == 0.1);
+    CHECK(AcceptQuality("*/*"sv, CBOR, false) == 0.);
+    CHECK(AcceptQuality("text/*"sv, JSON) == 0.);
+
+    // Неразборчивый q - недопустимый вариант
+    CHECK(AcceptQuality("application/cbor;q=abc"sv, CBOR) == 0.);
+    CHECK(AcceptQuality("application/cbor;q=2"sv, CBOR) == 0.);
+
+    std::cout << "accept quality: explicit q=0 refuses, most specific range wins" << std::endl;
+}
@@ -0,0 +1,172 @@
+// CborWriter пишет числа с плавающей точкой в самой короткой из half/single/double форме без потери
+// значения. Эталоны - примеры из приложения A RFC 8949
+#include "cbor_writer.h"
+
+#include "check.h"
+
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace serialization;
+
+namespace {
+
+std::string Encode(double value) {
+    std::string out;
+    CborWriter writer(out);
+    writer.Double(value);
+    return out;
+}
+
+std::string EncodeInt(int64_t value) {
+    std::string out;
+    CborWriter writer(out);
+    writer.Int(value);
+    return out;
+}
+
+std::string Hex(std::string_view bytes) {
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : bytes) {
+        hex.push_back(HEX_DIGITS[c >> 4]);
+        hex.push_back(HEX_DIGITS[c & 0xF]);
+    }
+    return hex;
+}
+
+double DecodeHalf(uint16_t half) {
+    const int exp = (half >> 10) & 0x1F;
+    const int mant = half & 0x3FF;
+    double value;
+    if (exp == 0) {
+        value = std::ldexp(mant, -24);
+    } else if (exp != 31) {
+        value = std::ldexp(mant + 1024, exp - 25);
+    } else {
+        value = mant == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+uint64_t BigEndian(std::string_view bytes) {
+    uint64_t value = 0;
+    for (unsigned char c : bytes) {
+        value = value << 8 | c;
+    }
+    return value;
+}
+
+// Обратное преобразование одного числа с плавающей точкой
+double Decode(std::string_view cbor) {
+    CHECK(!cbor.empty());
+    const uint64_t argument = BigEndian(cbor.substr(1));
+    switch (static_cast<unsigned char>(cbor[0])) {
+    case 0xF9:
+        CHECK(cbor.size() == 3);
+        return DecodeHalf(static_cast<uint16_t>(argument));
+    case 0xFA:
+        CHECK(cbor.size() == 5);
+        return std::bit_cast<float>(static_cast<uint32_t>(argument));
+    case 0xFB:
+        CHECK(cbor.size() == 9);
+        return std::bit_cast<double>(argument);
+    }
+    CHECK(false);
+    return 0.;
+}
+
+bool SameValue(double l, double r) {
+    return std::bit_cast<uint64_t>(l) == std::bit_cast<uint64_t>(r);
+}
+
+}  // namespace
+
+int main() {
+    CHECK(Hex(Encode(0.0)) == "f90000");
+    CHECK(Hex(Encode(-0.0)) == "f98000");
+    CHECK(Hex(Encode(1.0)) == "f93c00");
+    CHECK(Hex(Encode(1.1)) == "fb3ff199999999999a");
+    CHECK(Hex(Encode(1.5)) == "f93e00");
+    CHECK(Hex(Encode(65504.0)) == "f97bff");
+    CHECK(Hex(Encode(100000.0)) == "fa47c35000");
+    CHECK(Hex(Encode(3.4028234663852886e+38)) == "fa7f7fffff");
+    CHECK(Hex(Encode(1.0e+300)) == "fb7e37e43c8800759c");
+    CHECK(Hex(Encode(5.960464477539063e-8)) == "f90001");
+    CHECK(Hex(Encode(0.00006103515625)) == "f90400");
+    CHECK(Hex(Encode(-4.0)) == "f9c400");
+    CHECK(Hex(Encode(-4.1)) == "fbc010666666666666");
+    // Одиннадцатый бит мантиссы в half не помещается
+    CHECK(Hex(Encode(1.00048828125)) == "fa3f801000");
+    CHECK(Hex(Encode(std::numeric_limits<double>::infinity())) == "f97c00");
+    CHECK(Hex(Encode(-std::numeric_limits<double>::infinity())) == "f9fc00");
+    CHECK(Hex(Encode(std::numeric_limits<double>::quiet_NaN())) == "f97e00");
+
+    CHECK(Hex(EncodeInt(0)) == "00");
+    CHECK(Hex(EncodeInt(23)) == "17");
+    CHECK(Hex(EncodeInt(24)) == "1818");
+    CHECK(Hex(EncodeInt(1000)) == "1903e8");
+    CHECK(Hex(EncodeInt(1000000000000)) == "1b000000e8d4a51000");
+    CHECK(Hex(EncodeInt(-1)) == "20");
+    CHECK(Hex(EncodeInt(-1000)) == "3903e7");
+
+    // Каждое конечное half-значение пишется тремя байтами и читается обратно тем же числом
+    size_t halves = 0;
+    for (uint32_t bits = 0; bits <= 0xFFFF; ++bits) {
+        const double value = DecodeHalf(static_cast<uint16_t>(bits));
+        if (!std::isfinite(value)) {
+            continue;
+        }
+        const std::string cbor = Encode(value);
+        CHECK(cbor.size() == 3);
+        CHECK(SameValue(Decode(cbor), value));
+        ++halves;
+    }
+
+    // Значения single: не длиннее пяти байт, точный возврат. Half - только если он точен
+    size_t singles = 0;
+    auto check_single = [&singles](uint32_t bits) {
+        const float value = std::bit_cast<float>(bits);
+        if (!std::isfinite(value)) {
+            return;
+        }
+        const std::string cbor = Encode(value);
+        CHECK(cbor.size() <= 5);
+        CHECK(SameValue(Decode(cbor), value));
+        ++singles;
+    };
+    for (uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += 0x10001) {
+        check_single(static_cast<uint32_t>(bits));
+    }
+    // Все младшие биты мантиссы чисел от 1
+    for (uint32_t bits = 0x3F800000; bits < 0x3F820000; ++bits) {
+        check_single(bits);
+    }
+
+    // Координаты собак: double без точного single пишется полностью
+    size_t doubles = 0;
+    for (double value = -1000.; value < 1000.; value += 0.37) {
+        const std::string cbor = Encode(value);
+        CHECK(SameValue(Decode(cbor), value));
+        CHECK(cbor.size() == 9 || static_cast<double>(static_cast<float>(value)) == value);
+        ++doubles;
+    }
+
+    std::string out;
+    CborWriter writer(out);
+    writer.BeginObject();
+    writer.Key("pos");
+    writer.BeginArray();
+    writer.Double(2.5);
+    writer.Int(-3);
+    writer.EndArray();
+    writer.Key(int64_t{7});
+    writer.String("a");
+    writer.EndObject();
+    CHECK(Hex(out) == "bf63706f739ff9410022ff076161ff");
+
+    std::cout << "cbor writer: " << halves << " halves, " << singles << " singles, " << doubles
+              << " doubles round-trip" << std::endl;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Проверка для тестов без фреймворка. В отличие от assert работает и в Release-сборке
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            std::exit(EXIT_FAILURE);                                                          \
+        }                                                                                     \
+    } while (false)
+
+#define CHECK_THROWS(expression)                                                                \
+    do {                                                                                        \
+        bool thrown = false;                                                                    \
+        try {                                                                                   \
+            expression;                                                                         \
+        } catch (...) {                                                                         \
+            thrown = true;                                                                      \
+        }                                                                                       \
+        if (!thrown) {                                                                          \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": " #expression " did not throw\n";   \
+            std::exit(EXIT_FAILURE);                                                            \
+        }                                                                                       \
+    } while (false)
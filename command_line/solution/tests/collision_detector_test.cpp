@@ -0,0 +1,107 @@
+// Сетка FindGatherEvents находит ровно те же события, что и полный перебор пар
+#include "collision_detector.h"
+
+#include "check.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <tuple>
+
+using namespace collision_detector;
+
+namespace {
+
+struct VectorProvider : ItemGathererProvider {
+    size_t ItemsCount() const override {
+        return items.size();
+    }
+    Item GetItem(size_t idx) const override {
+        return items[idx];
+    }
+    size_t GatherersCount() const override {
+        return gatherers.size();
+    }
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers[idx];
+    }
+
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+};
+
+std::vector<GatheringEvent> BruteForce(const VectorProvider& provider) {
+    std::vector<GatheringEvent> events;
+    for (size_t g = 0; g < provider.gatherers.size(); ++g) {
+        const Gatherer& gatherer = provider.gatherers[g];
+        if (gatherer.start_pos.x_ == gatherer.end_pos.x_ && gatherer.start_pos.y_ == gatherer.end_pos.y_) {
+            continue;
+        }
+        for (size_t i = 0; i < provider.items.size(); ++i) {
+            const Item& item = provider.items[i];
+            CollectionResult result = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+            if (result.IsCollected(gatherer.width + item.width)) {
+                events.push_back({i, g, result.sq_distance, result.proj_ratio});
+            }
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const GatheringEvent& l, const GatheringEvent& r) {
+        return std::tie(l.time, l.gatherer_id, l.item_id) < std::tie(r.time, r.gatherer_id, r.item_id);
+    });
+    return events;
+}
+
+// Собаки ходят по дорогам, поэтому большинство отрезков вдоль осей. Часть отрезков косые,
+// нулевые или длиннее всей карты (огромный /tick), чтобы задеть все ветки широкой фазы
+VectorProvider RandomInput(std::mt19937& random, size_t items, size_t gatherers, double size) {
+    std::uniform_real_distribution<double> coord(-size / 2, size);
+    std::uniform_real_distribution<double> width(0., 1.);
+    std::uniform_real_distribution<double> step(-5., 5.);
+    std::uniform_int_distribution<int> kind(0, 9);
+
+    VectorProvider provider;
+    for (size_t i = 0; i < items; ++i) {
+        provider.items.push_back({{coord(random), coord(random)}, kind(random) == 0 ? 0. : width(random) / 2});
+    }
+    for (size_t g = 0; g < gatherers; ++g) {
+        const model::ParamPairDouble start{coord(random), coord(random)};
+        model::ParamPairDouble end = start;
+        switch (kind(random)) {
+            case 0: break;
+            case 1: end = {start.x_ + step(random), start.y_ + step(random)}; break;
+            case 2: end = {start.x_ + step(random) * size, start.y_}; break;
+            case 3: case 4: case 5: end.x_ += step(random); break;
+            default: end.y_ += step(random); break;
+        }
+        provider.gatherers.push_back({start, end, width(random)});
+    }
+    return provider;
+}
+
+bool SameEvents(const std::vector<GatheringEvent>& l, const std::vector<GatheringEvent>& r) {
+    return std::equal(l.begin(), l.end(), r.begin(), r.end(), [](const GatheringEvent& a, const GatheringEvent& b) {
+        return a.item_id == b.item_id && a.gatherer_id == b.gatherer_id && a.sq_distance == b.sq_distance && a.time == b.time;
+    });
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random(31);
+    size_t total = 0;
+    for (int round = 0; round < 50; ++round) {
+        const VectorProvider provider = RandomInput(random, 2000, 300, round % 2 ? 50. : 500.);
+        const std::vector<GatheringEvent> expected = BruteForce(provider);
+        CHECK(SameEvents(FindGatherEvents(provider), expected));
+        total += expected.size();
+    }
+    CHECK(total > 0);
+
+    // Пустые входы
+    VectorProvider empty;
+    CHECK(FindGatherEvents(empty).empty());
+    empty.gatherers.push_back({{0., 0.}, {10., 0.}, 0.6});
+    CHECK(FindGatherEvents(empty).empty());
+
+    std::cout << "collision detector: " << total << " events match brute force" << std::endl;
+}
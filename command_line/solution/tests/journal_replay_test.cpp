@@ -0,0 +1,100 @@
+// Игра, записанная в журнал, и её воспроизведение приходят к одному отпечатку состояния.
+// На карте есть боты: они не журналируются и не должны влиять на отпечаток
+#include "game_server.h"
+#include "replay.h"
+
+#include "check.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+namespace {
+
+void WriteConfig(const fs::path& path) {
+    std::ofstream out(path);
+    out << R"({
+  "defaultDogSpeed": 3.0,
+  "dogRetirementTime": 2.0,
+  "maps": [{
+    "id": "map1",
+    "name": "Map 1",
+    "roads": [
+      {"x0": 0, "y0": 0, "x1": 40}, {"x0": 0, "y0": 20, "x1": 40}, {"x0": 0, "y0": 40, "x1": 40},
+      {"x0": 0, "y0": 0, "y1": 40}, {"x0": 20, "y0": 0, "y1": 40}, {"x0": 40, "y0": 0, "y1": 40}
+    ],
+    "buildings": [],
+    "offices": [{"id": "o0", "x": 40, "y": 40, "offsetX": 5, "offsetY": 0}],
+    "bots": {"count": 20, "behavior": "randomWalk"}
+  }]
+})";
+}
+
+constexpr int TICKS = 600;
+constexpr int JOIN_EVERY = 10;
+
+}  // namespace
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("journal_replay_test_"s + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    const fs::path config = dir / "config.json";
+    const fs::path journal_file = dir / "game.journal";
+    WriteConfig(config);
+
+    net::io_context ioc;
+    uint64_t live_hash = 0;
+    {
+        GameServer live(ioc, config, dir);
+        live.SetSpawnDogRandomPoint();
+        live.EnableJournal(journal_file);
+        live.StartBots(1);
+        // Игроки из снимка не попали бы в журнал
+        CHECK_THROWS(live.EnableStatePersistence(dir / "state", std::chrono::milliseconds(0), std::chrono::milliseconds(0)));
+
+        auxillary::FastRandom random(42);
+        const std::string dirs[] = {"U", "R", "D", "L", ""};
+        std::vector<std::shared_ptr<model::Player>> players;
+        for (int tick = 0; tick < TICKS; ++tick) {
+            if (tick % JOIN_EVERY == 0) {
+                players.push_back(live.JoinGame(model::Map::Id{"map1"}, "player"s + std::to_string(tick)));
+            }
+            // Действия и ушедшим на покой игрокам: сессия их отбрасывает, в журнал они не попадают
+            for (const auto& player : players) {
+                if (random.NextIndex(8) == 0) {
+                    live.SetPlayerDirection(*player, dirs[random.NextIndex(5)]);
+                }
+            }
+            live.Tick(std::chrono::milliseconds(50 + random.NextIndex(100)));
+        }
+        live.FlushJournal();
+        live_hash = live.StateHash();
+        CHECK(live.GetBotCount() == 20);
+    }
+
+    GameServer replayed(ioc, config, dir);
+    const journal::ReplayStats stats = journal::Replay(replayed, journal_file);
+    CHECK(stats.joins == TICKS / JOIN_EVERY);
+    CHECK(stats.ticks == TICKS);
+    CHECK(stats.actions > 0);
+    CHECK(stats.state_hash == live_hash);
+
+    // Seed точек появления задаёт сервер: одинаковый --random-seed даёт одинаковые входы
+    {
+        GameServer first(ioc, config, dir);
+        GameServer second(ioc, config, dir);
+        for (GameServer* gs : {&first, &second}) {
+            gs->SetSpawnDogRandomPoint();
+            gs->SetRandomSeed(7);
+        }
+        for (int i = 0; i < 10; ++i) {
+            const model::ParamPairDouble a = first.JoinGame(model::Map::Id{"map1"}, "a"s)->GetDog()->GetDogPosition();
+            const model::ParamPairDouble b = second.JoinGame(model::Map::Id{"map1"}, "b"s)->GetDog()->GetDogPosition();
+            CHECK(a.x_ == b.x_ && a.y_ == b.y_);
+        }
+    }
+
+    fs::remove_all(dir);
+    std::cout << "journal replay: " << stats.joins << " joins, " << stats.actions << " actions, "
+              << stats.ticks << " ticks, hash matches" << std::endl;
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env bash
+# Два шарда game_server и game_router на 127.0.0.1. Вход, /state, пачка действий, тик и рекорды
+# идут через роутер; каждый токен должен оказаться у шарда, которому принадлежит карта.
+#
+#   tests/router_loopback_test.sh <game_server> <game_router>
+#
+# BASE_PORT - порт роутера, шарды слушают BASE_PORT+1 и BASE_PORT+2. Нужен curl.
+set -euo pipefail
+
+if [[ $# -ne 2 ]]; then
+    sed -n '2,7p' "$0" | sed 's/^# \{0,1\}//'
+    exit 2
+fi
+
+SERVER=$1
+ROUTER=$2
+BASE_PORT=${BASE_PORT:-$((20000 + $$ % 20000))}
+ROUTER_URL=http://127.0.0.1:$BASE_PORT
+SHARD_URLS=(http://127.0.0.1:$((BASE_PORT + 1)) http://127.0.0.1:$((BASE_PORT + 2)))
+MAPS=(map0 map1 map2 map3 map4 map5 map6 map7)
+
+WORK_DIR=$(mktemp -d)
+PIDS=()
+cleanup() {
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null || true
+        wait "$pid" 2>/dev/null || true
+    done
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    for log in "$WORK_DIR"/*.log; do
+        echo "--- $log" >&2
+        tail -n 20 "$log" >&2
+    done
+    exit 1
+}
+
+# request <метод> <url> [тело] [токен]: тело ответа в $WORK_DIR/body, код - в stdout
+request() {
+    local args=(-s -o "$WORK_DIR/body" -w '%{http_code}' -X "$1")
+    if [[ -n ${3:-} ]]; then
+        args+=(-H 'Content-Type: application/json' -d "$3")
+    fi
+    if [[ -n ${4:-} ]]; then
+        args+=(-H "Authorization: Bearer $4")
+    fi
+    curl "${args[@]}" "$2"
+}
+
+wait_ready() {
+    for _ in $(seq 100); do
+        if curl -sf -o /dev/null "$1/api/v1/maps"; then
+            return
+        fi
+        sleep 0.1
+    done
+    fail "$1 did not start"
+}
+
+maps=
+for map in "${MAPS[@]}"; do
+    maps+="{\"id\": \"$map\", \"name\": \"$map\", \"roads\": [{\"x0\": 0, \"y0\": 0, \"x1\": 40}], \"buildings\": [], \"offices\": []}, "
+done
+echo "{\"defaultDogSpeed\": 1.0, \"dogRetirementTime\": 60.0, \"maps\": [${maps%, }]}" >"$WORK_DIR/config.json"
+
+for shard in 0 1; do
+    "$SERVER" --config-file "$WORK_DIR/config.json" --www-root "$WORK_DIR" --port $((BASE_PORT + 1 + shard)) \
+        --shard-id "$shard" --shard-count 2 >"$WORK_DIR/shard$shard.log" 2>&1 &
+    PIDS+=($!)
+done
+"$ROUTER" --port "$BASE_PORT" --upstream "127.0.0.1:$((BASE_PORT + 1))" --upstream "127.0.0.1:$((BASE_PORT + 2))" \
+    >"$WORK_DIR/router.log" 2>&1 &
+PIDS+=($!)
+for url in "${SHARD_URLS[@]}" "$ROUTER_URL"; do
+    wait_ready "$url"
+done
+
+tokens=()
+owners=()
+owned=(0 0)
+for map in "${MAPS[@]}"; do
+    # Владельца карты называют сами шарды: чужую карту шард отвергает с 421
+    owner=
+    for shard in 0 1; do
+        code=$(request POST "${SHARD_URLS[$shard]}/api/v1/game/join" "{\"userName\": \"probe\", \"mapId\": \"$map\"}")
+        case $code in
+            200) [[ -z $owner ]] || fail "$map is served by both shards"; owner=$shard ;;
+            421) ;;
+            *) fail "join $map on shard $shard: $code $(cat "$WORK_DIR/body")" ;;
+        esac
+    done
+    [[ -n $owner ]] || fail "$map is served by no shard"
+    owned[$owner]=$((owned[owner] + 1))
+
+    code=$(request POST "$ROUTER_URL/api/v1/game/join" "{\"userName\": \"player\", \"mapId\": \"$map\"}")
+    [[ $code == 200 ]] || fail "join $map through router: $code $(cat "$WORK_DIR/body")"
+    token=$(sed -n 's/.*"authToken" *: *"\([0-9a-f]*\)".*/\1/p' "$WORK_DIR/body")
+    [[ ${token:0:2} == $(printf '%02x' "$owner") ]] || fail "token $token for $map does not carry shard $owner"
+    tokens+=("$token")
+    owners+=("$owner")
+done
+[[ ${owned[0]} -gt 0 && ${owned[1]} -gt 0 ]] || fail "maps are not split between shards: ${owned[*]}"
+
+for i in "${!tokens[@]}"; do
+    owner=${owners[$i]}
+    code=$(request GET "$ROUTER_URL/api/v1/game/state" "" "${tokens[$i]}")
+    [[ $code == 200 ]] || fail "state through router for ${MAPS[$i]}: $code"
+    code=$(request GET "${SHARD_URLS[$owner]}/api/v1/game/state" "" "${tokens[$i]}")
+    [[ $code == 200 ]] || fail "state on owner shard $owner for ${MAPS[$i]}: $code"
+    code=$(request GET "${SHARD_URLS[$((1 - owner))]}/api/v1/game/state" "" "${tokens[$i]}")
+    [[ $code == 401 ]] || fail "token of ${MAPS[$i]} is known to shard $((1 - owner)): $code"
+done
+
+# Неизвестный токен последним: его номер в rejected - номер исходной пачки
+batch=
+for token in "${tokens[@]}"; do
+    batch+="{\"token\": \"$token\", \"move\": \"R\"}, "
+done
+batch+="{\"token\": \"00000000000000000000000000000000\", \"move\": \"R\"}"
+code=$(request POST "$ROUTER_URL/api/v1/game/actions" "[$batch]")
+[[ $code == 200 ]] || fail "actions batch: $code $(cat "$WORK_DIR/body")"
+tr -d ' ' <"$WORK_DIR/body" | grep -q "\"accepted\":${#tokens[@]}" || fail "actions batch accepted: $(cat "$WORK_DIR/body")"
+tr -d ' ' <"$WORK_DIR/body" | grep -q "\"rejected\":\[${#tokens[@]}\]" || fail "actions batch rejected: $(cat "$WORK_DIR/body")"
+
+code=$(request POST "$ROUTER_URL/api/v1/game/tick" '{"timeDelta": 1000}')
+[[ $code == 200 ]] || fail "tick through router: $code $(cat "$WORK_DIR/body")"
+# Действие применено на шарде-владельце: собака поехала вправо
+for i in "${!tokens[@]}"; do
+    code=$(request GET "$ROUTER_URL/api/v1/game/state" "" "${tokens[$i]}")
+    [[ $code == 200 ]] || fail "state after tick for ${MAPS[$i]}: $code"
+    tr -d ' ' <"$WORK_DIR/body" | grep -q '"dir":"R"' || fail "move of ${MAPS[$i]} was not applied: $(cat "$WORK_DIR/body")"
+done
+
+code=$(request GET "$ROUTER_URL/api/v1/game/records?start=0&maxItems=10")
+[[ $code == 200 ]] || fail "records through router: $code $(cat "$WORK_DIR/body")"
+[[ $(head -c 1 "$WORK_DIR/body") == "[" ]] || fail "records body: $(cat "$WORK_DIR/body")"
+# HEAD: та же длина без тела, роутер не ждёт тела от шардов
+length=$(wc -c <"$WORK_DIR/body")
+headers=$(curl -s -I --max-time 5 "$ROUTER_URL/api/v1/game/records?start=0&maxItems=10") || fail "HEAD records through router timed out"
+grep -qi "^content-length: *$length$" <<<"${headers//$'\r'/}" || fail "HEAD records length: $headers"
+
+echo "router loopback: ${#MAPS[@]} maps split ${owned[0]}/${owned[1]}, every token routed to its shard"
@@ -0,0 +1,75 @@
+// Таблица псевдонимов выбирает участок дороги с вероятностью, пропорциональной его длине
+#include "model.h"
+
+#include "check.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+constexpr size_t SAMPLES = 400000;
+
+// Доля выборок каждого участка не дальше 5 сигм от его доли длины
+void CheckProportional(const Map& map, uint64_t seed) {
+    const auto& segments = map.GetRoadSegments();
+    double total = 0.;
+    for (const RoadSegment& segment : segments) {
+        total += segment.to - segment.from;
+    }
+    std::vector<size_t> hits(segments.size());
+    auxillary::FastRandom random(seed);
+    for (size_t i = 0; i < SAMPLES; ++i) {
+        const size_t segment = map.FindSegment(map.GetRandomDogPosition(random));
+        CHECK(segment != Map::NO_SEGMENT);
+        ++hits[segment];
+    }
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const double p = total == 0. ? 1. / segments.size() : (segments[i].to - segments[i].from) / total;
+        const double expected = SAMPLES * p;
+        const double sigma = std::sqrt(SAMPLES * p * (1. - p));
+        CHECK(std::abs(hits[i] - expected) <= 5. * sigma);
+    }
+}
+
+}  // namespace
+
+int main() {
+    // Участки не пересекаются, поэтому FindSegment однозначен. Длины 100, 10, 1, 30 и 0
+    Map map(Map::Id{"map1"}, "Map 1");
+    map.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 100));
+    map.AddRoad(Road(Road::HORIZONTAL, {0, 10}, 10));
+    map.AddRoad(Road(Road::HORIZONTAL, {0, 20}, 1));
+    map.AddRoad(Road(Road::VERTICAL, {200, 100}, 130));
+    map.AddRoad(Road(Road::HORIZONTAL, {50, 40}, 50));
+    map.BuildRoadGraph();
+    CHECK(map.GetRoadSegments().size() == 5);
+    CheckProportional(map, 1);
+    CheckProportional(map, 2);
+
+    // Точка появления определяется генератором: журнал повторяет её при воспроизведении
+    auxillary::FastRandom first(7);
+    auxillary::FastRandom second(7);
+    for (int i = 0; i < 100; ++i) {
+        const ParamPairDouble a = map.GetRandomDogPosition(first);
+        const ParamPairDouble b = map.GetRandomDogPosition(second);
+        CHECK(a.x_ == b.x_ && a.y_ == b.y_);
+    }
+
+    // Одни точечные дороги равновероятны
+    Map points(Map::Id{"map2"}, "Map 2");
+    points.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 0));
+    points.AddRoad(Road(Road::VERTICAL, {10, 10}, 10));
+    points.AddRoad(Road(Road::HORIZONTAL, {20, 20}, 20));
+    points.BuildRoadGraph();
+    CheckProportional(points, 3);
+
+    Map empty(Map::Id{"map3"}, "Map 3");
+    empty.BuildRoadGraph();
+    CHECK_THROWS(empty.GetRandomDogPosition());
+
+    std::cout << "spawn table: " << SAMPLES << " samples per run match road lengths" << std::endl;
+}
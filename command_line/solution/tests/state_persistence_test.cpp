@@ -0,0 +1,176 @@
+// Восстановление по WAL: недописанный при сбое кадр отрезается, записи, уже учтённые в снимке,
+// пропускаются по lsn
+#include "state_persistence.h"
+
+#include "check.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+using namespace persistence;
+using namespace std::literals;
+
+namespace {
+
+JoinRecord MakeJoin(const std::string& token, int player_id) {
+    JoinRecord record;
+    record.player.token = token;
+    record.player.name = "player"s + std::to_string(player_id);
+    record.player.player_id = player_id;
+    record.player.map_id = "map1";
+    record.player.dog.dir = "U";
+    record.player.dog.score = player_id * 10;
+    return record;
+}
+
+void FlipByte(const fs::path& path, std::streamoff offset) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(offset);
+    const char byte = static_cast<char>(file.get());
+    file.seekp(offset);
+    file.put(static_cast<char>(byte ^ 0xff));
+}
+
+// Токены записей WAL с lsn больше after_lsn, в порядке записи
+std::vector<std::string> ReadTokens(const fs::path& wal, uint64_t after_lsn, WalTail* tail = nullptr) {
+    std::vector<std::string> tokens;
+    WalTail read = ReadWal(wal, after_lsn, [&tokens](const WalRecord& record) {
+        if (const auto* join = std::get_if<JoinRecord>(&record)) {
+            CHECK(join->player.name == "player"s + std::to_string(join->player.player_id));
+            CHECK(join->player.dog.score == join->player.player_id * 10);
+            tokens.push_back(join->player.token);
+        } else {
+            tokens.push_back("retire:"s + std::get<RetireRecord>(record).token);
+        }
+    });
+    if (tail) {
+        *tail = read;
+    }
+    return tokens;
+}
+
+}  // namespace
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("state_persistence_test_"s + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    const fs::path wal = dir / "state.wal";
+    const fs::path snapshot_file = dir / "state";
+
+    // Без файлов восстанавливать нечего
+    CHECK(!LoadSnapshot(snapshot_file));
+    WalTail tail = ReadWal(wal, 0, [](const WalRecord&) {
+        CHECK(false);
+    });
+    CHECK(tail.last_lsn == 0 && tail.valid_size == 0);
+
+    {
+        WalWriter writer(wal, snapshot_file, tail, std::chrono::milliseconds(0));
+        CHECK(writer.Append(MakeJoin("a", 1)) == 1);
+        CHECK(writer.Append(MakeJoin("b", 2)) == 2);
+        CHECK(writer.Append(RetireRecord{"a"}) == 3);
+        writer.Flush();
+    }
+    CHECK((ReadTokens(wal, 0, &tail) == std::vector<std::string>{"a", "b", "retire:a"}));
+    CHECK(tail.last_lsn == 3);
+    CHECK(tail.valid_size == fs::file_size(wal));
+
+    // Сбой посреди записи последнего кадра: он отрезается, остальные записи целы
+    const uint64_t full_size = fs::file_size(wal);
+    WalTail before_last;
+    {
+        WalWriter writer(wal, snapshot_file, tail, std::chrono::milliseconds(0));
+        CHECK(writer.Append(MakeJoin("c", 3)) == 4);
+        writer.Flush();
+    }
+    ReadTokens(wal, 0, &before_last);
+    CHECK(before_last.last_lsn == 4);
+    fs::resize_file(wal, fs::file_size(wal) - 3);
+    CHECK((ReadTokens(wal, 0, &tail) == std::vector<std::string>{"a", "b", "retire:a"}));
+    CHECK(tail.last_lsn == 3);
+    CHECK(tail.valid_size == full_size);
+
+    // Писатель продолжает с целой части: хвост обрезан, нумерация не сбита
+    {
+        WalWriter writer(wal, snapshot_file, tail, std::chrono::milliseconds(0));
+        CHECK(writer.Append(MakeJoin("d", 4)) == 4);
+        writer.Flush();
+    }
+    CHECK((ReadTokens(wal, 0, &tail) == std::vector<std::string>{"a", "b", "retire:a", "d"}));
+    CHECK(tail.last_lsn == 4);
+    CHECK(tail.valid_size == fs::file_size(wal));
+
+    // Кадр с неверной CRC - тоже конец WAL
+    const fs::path corrupted = dir / "corrupted.wal";
+    fs::copy_file(wal, corrupted);
+    FlipByte(corrupted, static_cast<std::streamoff>(full_size) + 10);
+    WalTail corrupted_tail;
+    CHECK(ReadTokens(corrupted, 0, &corrupted_tail).size() == 3);
+    CHECK(corrupted_tail.last_lsn == 3 && corrupted_tail.valid_size == full_size);
+
+    // Записи до lsn снимка пропускаются, даже если WAL не успели обрезать
+    CHECK((ReadTokens(wal, 2, &tail) == std::vector<std::string>{"retire:a", "d"}));
+    CHECK(tail.last_lsn == 4);
+    CHECK(ReadTokens(wal, 4, &tail).empty());
+    CHECK(tail.last_lsn == 4);
+
+    // Снимок обрезает WAL. Записи после него читаются поверх снимка
+    {
+        WalWriter writer(wal, snapshot_file, tail, std::chrono::milliseconds(0));
+        Snapshot snapshot;
+        snapshot.lsn = writer.LastLsn();
+        snapshot.sessions.push_back({"map1", 12.5});
+        snapshot.players.push_back(MakeJoin("b", 2).player);
+        snapshot.players.push_back(MakeJoin("d", 4).player);
+        writer.Checkpoint([snapshot] {
+            return EncodeSnapshot(snapshot);
+        });
+        CHECK(writer.Append(MakeJoin("e", 5)) == 5);
+        writer.Flush();
+    }
+    const std::optional<Snapshot> restored = LoadSnapshot(snapshot_file);
+    CHECK(restored);
+    CHECK(restored->lsn == 4);
+    CHECK(restored->sessions.size() == 1 && restored->sessions[0].session_time == 12.5);
+    CHECK(restored->players.size() == 2 && restored->players[1].token == "d");
+    CHECK((ReadTokens(wal, restored->lsn, &tail) == std::vector<std::string>{"e"}));
+    CHECK(tail.last_lsn == 5);
+    CHECK((ReadTokens(wal, 0) == std::vector<std::string>{"e"}));
+
+    // Испорченный снимок - ошибка, а не пустая игра
+    FlipByte(snapshot_file, static_cast<std::streamoff>(fs::file_size(snapshot_file)) - 1);
+    CHECK_THROWS(LoadSnapshot(snapshot_file));
+
+    // Снимок некуда записать: поток WAL останавливается, ожидающие узнают, что запись не сохранена
+    {
+        std::atomic<int> failures = 0;
+        WalWriter writer(dir / "state.broken.wal", dir / "missing" / "state", WalTail{}, std::chrono::milliseconds(0), [&failures] {
+            ++failures;
+        });
+        writer.Checkpoint([] {
+            return "snapshot"s;
+        });
+        writer.Append(MakeJoin("f", 6));
+        std::atomic<int> durable = -1;
+        writer.WhenDurable([&durable](bool ok) {
+            durable = ok;
+        });
+        writer.Flush();
+        CHECK(writer.Failed());
+        CHECK(durable == 0);
+        CHECK(failures == 1);
+        writer.Append(MakeJoin("g", 7));
+        writer.WhenDurable([&durable](bool ok) {
+            durable = ok ? 1 : 2;
+        });
+        CHECK(durable == 2);
+        writer.Flush();
+    }
+
+    fs::remove_all(dir);
+    std::cout << "state persistence: torn tail truncated, checkpoint lsn skipped, write failure reported" << std::endl;
+}
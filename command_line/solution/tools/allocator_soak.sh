@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Долгий прогон сборок game_server с разными аллокаторами (-DGAME_SERVER_ALLOCATOR=system|jemalloc|mimalloc).
+# Для каждой сборки по очереди:
+#   1. --simulate с ботами: us_per_tick, rss и heap_in_use из лога "simulation finished";
+#   2. сервер с ботами под нагрузкой wrk (tools/soak_mix.lua) в течение SOAK_DURATION,
+#      RSS процесса снимается каждые SAMPLE_PERIOD секунд в $OUT_DIR/<номер>-<аллокатор>.csv.
+#
+#   tools/allocator_soak.sh <game_server> [<game_server> ...]
+#
+# Параметры через переменные окружения (значения по умолчанию в скобках):
+#   SOAK_DURATION (1h), SAMPLE_PERIOD (60), SIMULATE_SECONDS (3600), BOTS (10000), BEHAVIOR (randomWalk),
+#   CONNECTIONS (256), WRK_THREADS (4), PLAYERS (1000), PORT (8080), OUT_DIR (soak-results)
+# Нужны wrk и curl.
+set -euo pipefail
+
+if [[ $# -lt 1 ]]; then
+    sed -n '2,13p' "$0" | sed 's/^# \{0,1\}//'
+    exit 2
+fi
+
+source "$(dirname "$0")/lib.sh"
+DURATION=${SOAK_DURATION:-1h}
+SAMPLE_PERIOD=${SAMPLE_PERIOD:-60}
+SIMULATE_SECONDS=${SIMULATE_SECONDS:-3600}
+BOTS=${BOTS:-10000}
+BEHAVIOR=${BEHAVIOR:-randomWalk}
+CONNECTIONS=${CONNECTIONS:-256}
+WRK_THREADS=${WRK_THREADS:-4}
+PLAYERS=${PLAYERS:-1000}
+OUT_DIR=${OUT_DIR:-soak-results}
+
+mkdir -p "$OUT_DIR"
+write_bots_config "$WORK_DIR/config.json" "$BOTS" "$BEHAVIOR"
+
+rss_kib() {
+    awk '/^VmRSS:/ { print $2 }' "/proc/$SERVER_PID/status"
+}
+
+printf '%-10s %12s %12s %14s %12s %10s %12s %12s %12s\n' \
+    allocator us_per_tick 'sim rss' 'sim heap' 'req/s' p99 'rss start' 'rss max' 'rss end'
+run=0
+for binary in "$@"; do
+    run=$((run + 1))
+    "$binary" --config-file "$WORK_DIR/config.json" --simulate "$SIMULATE_SECONDS" --tick-period 50 >"$WORK_DIR/server.log" 2>&1
+    allocator=$(log_field allocator "simulation finished")
+    us_per_tick=$(log_field us_per_tick "simulation finished")
+    sim_rss=$(log_field rss "simulation finished")
+    sim_heap=$(log_field heap_in_use "simulation finished")
+
+    start_server "$binary" --config-file "$WORK_DIR/config.json" --www-root "$SOLUTION_DIR/static" --tick-period 50
+    join_players "$PLAYERS" map1
+    csv="$OUT_DIR/$run-$allocator.csv"
+    echo "seconds,rss_kib" >"$csv"
+    run_wrk -s "$SOLUTION_DIR/tools/soak_mix.lua" "$URL" -- "$WORK_DIR/tokens" >"$WORK_DIR/wrk.out" &
+    wrk_pid=$!
+    started=$SECONDS
+    while kill -0 "$wrk_pid" 2>/dev/null; do
+        echo "$((SECONDS - started)),$(rss_kib)" >>"$csv"
+        sleep "$SAMPLE_PERIOD"
+    done
+    wait "$wrk_pid"
+    echo "$((SECONDS - started)),$(rss_kib)" >>"$csv"
+    stop_server
+
+    read -r rps _ p99 _ <"$WORK_DIR/wrk.out"
+    read -r rss_start rss_max rss_end < <(awk -F, 'NR == 2 { first = $2 } NR > 1 { if ($2 > max) max = $2; last = $2 }
+                                                   END { print first, max, last }' "$csv")
+    printf '%-10s %12s %12s %14s %12s %10s %12s %12s %12s\n' \
+        "$allocator" "$us_per_tick" "$sim_rss" "$sim_heap" "$rps" "$p99" "${rss_start}K" "${rss_max}K" "${rss_end}K"
+done
+echo "RSS over time: $OUT_DIR/*.csv"
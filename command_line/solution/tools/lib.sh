@@ -0,0 +1,89 @@
+# Общие функции скриптов нагрузки и замеров. Подключается через source, задаёт SOLUTION_DIR, WORK_DIR и URL
+SOLUTION_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)
+PORT=${PORT:-8080}
+URL=http://127.0.0.1:$PORT
+
+WORK_DIR=$(mktemp -d)
+SERVER_PID=
+cleanup() {
+    if [[ -n $SERVER_PID ]]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+# start_server <game_server> [флаги...]: запускает сервер на PORT и ждёт, пока он ответит
+start_server() {
+    local binary=$1
+    shift
+    "$binary" --port "$PORT" "$@" >"$WORK_DIR/server.log" 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 100); do
+        if curl -sf -o /dev/null "$URL/api/v1/maps"; then
+            return
+        fi
+        sleep 0.1
+    done
+    echo "$binary did not start, log:" >&2
+    cat "$WORK_DIR/server.log" >&2
+    exit 1
+}
+
+stop_server() {
+    kill "$SERVER_PID"
+    wait "$SERVER_PID" || true
+    SERVER_PID=
+}
+
+# join_players <сколько> <карта>: токены игроков по одному на строку в $WORK_DIR/tokens
+join_players() {
+    local token
+    : >"$WORK_DIR/tokens"
+    for i in $(seq "$1"); do
+        token=$(curl -sf -X POST -H 'Content-Type: application/json' \
+            -d "{\"userName\": \"load$i\", \"mapId\": \"$2\"}" "$URL/api/v1/game/join" |
+            sed -n 's/.*"authToken" *: *"\([0-9a-f]*\)".*/\1/p')
+        if [[ -z $token ]]; then
+            echo "player $i failed to join $2" >&2
+            exit 1
+        fi
+        echo "$token" >>"$WORK_DIR/tokens"
+    done
+}
+
+# run_wrk <аргументы wrk>: печатает "запросов/с p50 p99 не-2xx" из вывода wrk --latency.
+# WRK_THREADS, CONNECTIONS и DURATION задаёт вызывающий скрипт
+run_wrk() {
+    wrk -t"$WRK_THREADS" -c"$CONNECTIONS" -d"$DURATION" --latency "$@" |
+        awk '/^Requests\/sec/ { rps = $2 } $1 == "50%" { p50 = $2 } $1 == "99%" { p99 = $2 }
+             /Non-2xx/ { errors = $NF } END { printf "%s %s %s %s\n", rps, p50, p99, errors ? errors : 0 }'
+}
+
+# write_bots_config <файл> <ботов> <поведение>: карта map1 - сетка дорог 100x100 с шагом 10 и ботами
+write_bots_config() {
+    local roads=
+    for i in $(seq 0 10 1000); do
+        roads+="{\"x0\": 0, \"y0\": $i, \"x1\": 1000}, {\"x0\": $i, \"y0\": 0, \"y1\": 1000}, "
+    done
+    cat >"$1" <<JSON
+{
+  "defaultDogSpeed": 3.0,
+  "dogRetirementTime": 60.0,
+  "maps": [{
+    "id": "map1",
+    "name": "Map 1",
+    "roads": [${roads%, }],
+    "buildings": [],
+    "offices": [{"id": "o0", "x": 500, "y": 500, "offsetX": 5, "offsetY": 0}],
+    "bots": {"count": $2, "behavior": "$3"}
+  }]
+}
+JSON
+}
+
+# log_field <поле> <сообщение>: значение числового поля из последней строки лога сервера с этим сообщением
+log_field() {
+    grep "\"$2\"" "$WORK_DIR/server.log" | tail -n 1 | grep -o "\"$1\":[^,}]*" | cut -d: -f2 | tr -d '" '
+}
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# Влияние --huge-pages и --numa-node на стоимость тика: прогоны --simulate с ботами и сеткой видимости
+# (--state-radius) для каждого варианта размещения. Печатает медиану us_per_tick из REPEATS прогонов и RSS.
+#
+#   tools/placement_bench.sh <game_server>
+#
+# Параметры через переменные окружения (значения по умолчанию в скобках):
+#   BOTS (300000), BEHAVIOR (randomWalk), SIMULATE_SECONDS (30), STATE_RADIUS (1), REPEATS (5),
+#   BOT_THREADS (0 - по числу ядер), NUMA_NODES (узлы из /sys/devices/system/node, если их больше одного)
+set -euo pipefail
+
+if [[ $# -ne 1 ]]; then
+    sed -n '2,9p' "$0" | sed 's/^# \{0,1\}//'
+    exit 2
+fi
+
+source "$(dirname "$0")/lib.sh"
+BOTS=${BOTS:-300000}
+BEHAVIOR=${BEHAVIOR:-randomWalk}
+SIMULATE_SECONDS=${SIMULATE_SECONDS:-30}
+STATE_RADIUS=${STATE_RADIUS:-1}
+REPEATS=${REPEATS:-5}
+BOT_THREADS=${BOT_THREADS:-0}
+if [[ -z ${NUMA_NODES+x} ]]; then
+    NUMA_NODES=
+    nodes=(/sys/devices/system/node/node[0-9]*)
+    if [[ ${#nodes[@]} -gt 1 ]]; then
+        NUMA_NODES=$(printf '%s\n' "${nodes[@]##*node}" | sort -n | tr '\n' ' ')
+    fi
+fi
+
+write_bots_config "$WORK_DIR/config.json" "$BOTS" "$BEHAVIOR"
+
+variants=("--huge-pages off" "--huge-pages transparent" "--huge-pages explicit")
+for node in $NUMA_NODES; do
+    variants+=("--numa-node $node --huge-pages off" "--numa-node $node --huge-pages transparent")
+done
+
+printf '%-42s %14s %14s %14s\n' variant 'us/tick p50' 'us/tick min' 'rss'
+for variant in "${variants[@]}"; do
+    results=()
+    for _ in $(seq "$REPEATS"); do
+        # shellcheck disable=SC2086
+        "$1" --config-file "$WORK_DIR/config.json" --simulate "$SIMULATE_SECONDS" --tick-period 50 \
+            --state-radius "$STATE_RADIUS" --bot-threads "$BOT_THREADS" $variant >"$WORK_DIR/server.log" 2>&1
+        results+=("$(log_field us_per_tick "simulation finished") $(log_field rss "simulation finished")")
+    done
+    read -r median fastest rss < <(printf '%s\n' "${results[@]}" | sort -g |
+        awk '{ us[NR] = $1; rss[NR] = $2 } END { m = int((NR + 1) / 2); print us[m], us[1], rss[m] }')
+    printf '%-42s %14s %14s %14s\n' "$variant" "$median" "$fastest" "$rss"
+done
@@ -0,0 +1,24 @@
+-- wrk: смесь запросов игроков для долгого прогона. Три из четырёх запросов - /state,
+-- четвёртый - /action со случайным направлением, чтобы собаки не уходили на покой.
+-- Аргумент после "--" - файл с токенами, по одному на строку
+local tokens = {}
+local index = 0
+local moves = {"U", "R", "D", "L", ""}
+
+function init(args)
+    for line in io.lines(args[1]) do
+        tokens[#tokens + 1] = line
+    end
+    index = math.random(#tokens)
+end
+
+function request()
+    index = index % #tokens + 1
+    local auth = "Bearer " .. tokens[index]
+    if index % 4 == 0 then
+        local body = '{"move": "' .. moves[math.random(#moves)] .. '"}'
+        return wrk.format("POST", "/api/v1/game/player/action",
+            {["Authorization"] = auth, ["Content-Type"] = "application/json"}, body)
+    end
+    return wrk.format("GET", "/api/v1/game/state", {["Authorization"] = auth})
+end